@@ -76,8 +76,9 @@ void Bot::HandleRequest(const Request &req)
     else if (ev == "AccessGranted")
     {
         mCtx.DecodeAccessGranted(json);
-        // As soon as we have entered into the lobby, join the assigned table
-        mCtx.BuildJoinTable(Protocol::TABLES_UID, mNetReplies);
+        // As soon as we have entered into the lobby, join the assigned table (the first one by default)
+        std::uint32_t table = (mCtx.mTableToJoin != Protocol::INVALID_UID) ? mCtx.mTableToJoin : Protocol::TABLES_UID;
+        mCtx.BuildJoinTable(table, mNetReplies);
     }
     else if (ev == "ReplyJoinTable")
     {
@@ -197,7 +198,7 @@ void Bot::HandleRequest(const Request &req)
         mCtx.DecodeChatMessage(json);
         // l'affichage s'occupe de tout, on ne fait rien après le décodage
     }
-    else if (ev == "LobbyEvent")
+    else if ((ev == "LobbyEvent") || (ev == "LobbyEvents"))
     {
         // nada
     }
@@ -68,6 +68,32 @@ bool BotManager::JoinTable(uint32_t botId, uint32_t tableId)
     return ret;
 }
 /*****************************************************************************/
+std::uint32_t BotManager::GetUuid(std::uint32_t botId)
+{
+    std::uint32_t uuid = Protocol::INVALID_UID;
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mBots.count(botId) > 0)
+    {
+        uuid = mBots[botId]->mBot.GetUuid();
+    }
+    return uuid;
+}
+/*****************************************************************************/
+Session::Stats BotManager::GetSessionStats()
+{
+    Session::Stats total = { 0U, 0U, 0U };
+    const std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &b : mBots)
+    {
+        Session::Stats s = b.second->mSession.GetStats();
+        total.events += s.events;
+        total.frames += s.frames;
+        total.writes += s.writes;
+    }
+    return total;
+}
+/*****************************************************************************/
 /**
  * @brief Table::AddBot
  *
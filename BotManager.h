@@ -21,6 +21,8 @@ public:
     void Close();
     void KillBots();
     bool JoinTable(std::uint32_t botId, std::uint32_t tableId);
+    std::uint32_t GetUuid(std::uint32_t botId); ///< INVALID_UID until the bot is logged in
+    Session::Stats GetSessionStats(); ///< Sum of the outgoing statistics of all the bots
 
 private:
     class NetBot : private INetClient, private INetClientEvent
@@ -65,6 +65,9 @@ const std::uint8_t Contract::GUARD_AGAINST = 5;
 
 std::vector<std::string> Contract::mStrings = Contract::Initialize();
 /*****************************************************************************/
+const std::uint8_t Tarot::Game::cQuickDeal;
+const std::uint8_t Tarot::Game::cSimpleTournament;
+const std::uint8_t Tarot::Game::cCustom;
 const std::string Tarot::Game::cQuickDealTxt          = "QuickDeal";
 const std::string Tarot::Game::cSimpleTournamentTxt   = "SimpleTournament";
 const std::string Tarot::Game::cCustomTxt             = "Custom";
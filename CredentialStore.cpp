@@ -0,0 +1,162 @@
+/**
+ * MIT License
+ * Copyright (c) 2019 Anthony Rabine
+ */
+
+#include <algorithm>
+#include <functional>
+#include "CredentialStore.h"
+#include "JsonReader.h"
+#include "Log.h"
+
+/*****************************************************************************/
+CredentialStore::CredentialStore()
+    : mSize(0U)
+{
+    for (auto &bucket : mBuckets)
+    {
+        bucket = std::make_shared<const Bucket>();
+    }
+}
+/*****************************************************************************/
+std::uint32_t CredentialStore::BucketOf(std::string_view webId)
+{
+    return static_cast<std::uint32_t>(std::hash<std::string_view>()(webId) % cBuckets);
+}
+/*****************************************************************************/
+CredentialStore::CredentialPtr CredentialStore::Find(const std::string &webId) const
+{
+    BucketPtr bucket = std::atomic_load(&mBuckets[BucketOf(webId)]);
+    auto it = bucket->find(webId);
+    return (it != bucket->end()) ? it->second : CredentialPtr();
+}
+/*****************************************************************************/
+std::uint32_t CredentialStore::Size() const
+{
+    return mSize.load(std::memory_order_relaxed);
+}
+/*****************************************************************************/
+void CredentialStore::Add(const Credential &credential)
+{
+    Publish(std::vector<Credential>(1U, credential), false);
+}
+/*****************************************************************************/
+void CredentialStore::Add(const std::vector<Credential> &credentials)
+{
+    Publish(credentials, false);
+}
+/*****************************************************************************/
+void CredentialStore::Replace(const std::vector<Credential> &credentials)
+{
+    Publish(credentials, true);
+}
+/*****************************************************************************/
+bool CredentialStore::Remove(const std::string &webId)
+{
+    std::scoped_lock<std::mutex> lock(mWriteMutex);
+    std::uint32_t index = BucketOf(webId);
+    BucketPtr current = std::atomic_load(&mBuckets[index]);
+
+    if (current->count(webId) == 0U)
+    {
+        return false;
+    }
+
+    auto bucket = std::make_shared<Bucket>(*current);
+    bucket->erase(webId);
+    std::atomic_store(&mBuckets[index], BucketPtr(std::move(bucket)));
+    mSize--;
+    return true;
+}
+/*****************************************************************************/
+/**
+ * @brief CredentialStore::Publish
+ *
+ * The credentials are sorted by bucket, then each bucket concerned is copied
+ * (or created empty for a refresh), completed and published in one store.
+ * A reader sees either the old or the new bucket, never a partial one.
+ */
+void CredentialStore::Publish(const std::vector<Credential> &credentials, bool replace)
+{
+    // Built out of the lock
+    std::vector<std::pair<std::uint32_t, CredentialPtr>> sorted;
+    sorted.reserve(credentials.size());
+    for (const auto &c : credentials)
+    {
+        sorted.emplace_back(BucketOf(c.webId), std::make_shared<const Credential>(c));
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::scoped_lock<std::mutex> lock(mWriteMutex);
+    std::int64_t delta = 0;
+    auto next = sorted.begin();
+
+    for (std::uint32_t i = 0U; i < cBuckets; i++)
+    {
+        if (!replace)
+        {
+            // Only the buckets concerned are visited
+            if (next == sorted.end())
+            {
+                break;
+            }
+            i = next->first;
+        }
+
+        bool changed = (next != sorted.end()) && (next->first == i);
+        BucketPtr current = std::atomic_load(&mBuckets[i]);
+        if (!changed && current->empty())
+        {
+            continue;
+        }
+
+        auto bucket = replace ? std::make_shared<Bucket>() : std::make_shared<Bucket>(*current);
+        for (; (next != sorted.end()) && (next->first == i); ++next)
+        {
+            std::string_view key(next->second->webId);
+            // The key must point to the new credential
+            bucket->erase(key);
+            bucket->emplace(key, std::move(next->second));
+        }
+        delta += static_cast<std::int64_t>(bucket->size()) - static_cast<std::int64_t>(current->size());
+        std::atomic_store(&mBuckets[i], BucketPtr(std::move(bucket)));
+    }
+    mSize = static_cast<std::uint32_t>(static_cast<std::int64_t>(mSize.load()) + delta);
+}
+/*****************************************************************************/
+bool CredentialStore::LoadFile(const std::string &fileName, bool replace)
+{
+    JsonValue json;
+
+    if (!JsonReader::ParseFile(json, fileName))
+    {
+        TLogError("[CREDENTIALS] Cannot read file " + fileName);
+        return false;
+    }
+
+    std::vector<Credential> credentials;
+    JsonValue clients = json.FindValue("clients");
+    credentials.reserve(clients.GetArray().Size());
+    for (JsonArray::iterator iter = clients.GetArray().begin(); iter != clients.GetArray().end(); ++iter)
+    {
+        if (iter->IsObject())
+        {
+            Credential c;
+            c.webId = iter->GetObj().GetValue("web_id").GetString();
+            c.gek = iter->GetObj().GetValue("gek").GetString();
+            c.passPhrase = iter->GetObj().GetValue("pass_phrase").GetString();
+            if (!c.webId.empty())
+            {
+                credentials.push_back(std::move(c));
+            }
+        }
+    }
+
+    Publish(credentials, replace);
+    TLogInfo("[CREDENTIALS] " + std::to_string(credentials.size()) + " clients loaded from " + fileName);
+    return true;
+}
+
+//=============================================================================
+// End of file CredentialStore.cpp
+//=============================================================================
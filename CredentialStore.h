@@ -0,0 +1,76 @@
+/**
+ * MIT License
+ * Copyright (c) 2019 Anthony Rabine
+ */
+
+#ifndef CREDENTIAL_STORE_H
+#define CREDENTIAL_STORE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*****************************************************************************/
+/**
+ * @brief The CredentialStore class
+ *
+ * Credentials of the clients allowed to connect, read at each handshake and
+ * rarely written.
+ *
+ * The entries are spread in cBuckets hash maps. Each bucket is an immutable
+ * snapshot: a reader takes the current one and looks it up without any lock,
+ * a writer builds a new copy of the buckets it changes and publishes them.
+ * Readers never wait for a writer (writers only wait for each other), and a
+ * credential found stays valid as long as the caller keeps the pointer.
+ */
+class CredentialStore
+{
+public:
+    struct Credential
+    {
+        std::string webId;
+        std::string gek;
+        std::string passPhrase;
+    };
+
+    typedef std::shared_ptr<const Credential> CredentialPtr;
+
+    static const std::uint32_t cBuckets = 256U;
+
+    CredentialStore();
+
+    CredentialPtr Find(const std::string &webId) const; // Null if unknown
+    std::uint32_t Size() const;
+
+    void Add(const Credential &credential);                         // Replaces the one with the same webId
+    void Add(const std::vector<Credential> &credentials);           // Bulk load: each bucket is copied once
+    void Replace(const std::vector<Credential> &credentials);       // Bulk refresh: the previous entries are dropped
+    bool Remove(const std::string &webId);
+
+    // JSON file: { "clients": [ { "web_id": "", "gek": "", "pass_phrase": "" }, ... ] }
+    bool LoadFile(const std::string &fileName, bool replace);
+
+private:
+    // The key points to the webId of the credential it maps to
+    typedef std::unordered_map<std::string_view, CredentialPtr> Bucket;
+    typedef std::shared_ptr<const Bucket> BucketPtr;
+
+    std::array<BucketPtr, cBuckets> mBuckets;   ///< Read and written with std::atomic_load/store only
+    std::atomic<std::uint32_t> mSize;
+    std::mutex mWriteMutex;
+
+    static std::uint32_t BucketOf(std::string_view webId);
+    void Publish(const std::vector<Credential> &credentials, bool replace);
+};
+
+#endif // CREDENTIAL_STORE_H
+
+//=============================================================================
+// End of file CredentialStore.h
+//=============================================================================
@@ -67,6 +67,25 @@ void Engine::Initialize()
     mSequence = STOPPED;
 }
 /*****************************************************************************/
+/**
+ * @brief Engine::Reset
+ * Used to recycle the engine of a destroyed table
+ */
+void Engine::Reset()
+{
+    for (std::uint8_t i = 0U; i < 5U; i++)
+    {
+        mPlayers[i].Clear();
+        mHandleAsked[i] = false;
+    }
+    currentTrick.Clear();
+    mCurrentPoints.Clear();
+    mSequence = STOPPED;
+    mPosition = 0U;
+    mTrickCounter = 0U;
+    mCtx.Initialize();
+}
+/*****************************************************************************/
 void Engine::CreateTable(std::uint8_t nbPlayers)
 {
     // Save parameters
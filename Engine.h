@@ -73,6 +73,7 @@ public:
 
     // Helpers
     void Initialize();
+    void Reset(); // Back to the state of a new engine, the decks keep their memory
     void Stop();
     void CreateTable(std::uint8_t nbPlayers);
     void NewGame();
@@ -0,0 +1,106 @@
+/*=============================================================================
+ * TarotClub - FrameParser.cpp
+ *=============================================================================
+ * Stream reassembly of protocol frames received on a socket
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cstring>
+#include "FrameParser.h"
+
+/*****************************************************************************/
+FrameParser::FrameParser()
+    : mBuffer(cInitialSize)
+    , mReadIndex(0U)
+    , mWriteIndex(0U)
+{
+
+}
+/*****************************************************************************/
+/**
+ * @brief FrameParser::Prepare
+ *
+ * Returns a pointer where at least size bytes can be written
+ */
+char *FrameParser::Prepare(std::uint32_t size)
+{
+    if ((mBuffer.size() - mWriteIndex) < size)
+    {
+        // Reclaim the consumed bytes first
+        if (mReadIndex > 0U)
+        {
+            std::memmove(&mBuffer[0], &mBuffer[mReadIndex], Size());
+            mWriteIndex -= mReadIndex;
+            mReadIndex = 0U;
+        }
+
+        if ((mBuffer.size() - mWriteIndex) < size)
+        {
+            mBuffer.resize(mWriteIndex + size);
+        }
+    }
+    return &mBuffer[mWriteIndex];
+}
+/*****************************************************************************/
+void FrameParser::Commit(std::uint32_t size)
+{
+    mWriteIndex += size;
+}
+/*****************************************************************************/
+FrameParser::Status FrameParser::Next(const Protocol &proto, Protocol::Header &h) const
+{
+    Status status = FRAME_INCOMPLETE;
+
+    if (Size() >= PROTO_HEADER_SIZE)
+    {
+        if (!proto.ParseHeader(h, Frame()))
+        {
+            status = FRAME_ERROR;
+        }
+        else if (Size() >= (PROTO_HEADER_SIZE + h.BodyLength()))
+        {
+            status = FRAME_READY;
+        }
+    }
+    return status;
+}
+/*****************************************************************************/
+void FrameParser::Consume(const Protocol::Header &h)
+{
+    mReadIndex += PROTO_HEADER_SIZE + h.BodyLength();
+
+    if (mReadIndex >= mWriteIndex)
+    {
+        // Nothing left, restart at the beginning without any copy
+        mReadIndex = 0U;
+        mWriteIndex = 0U;
+    }
+}
+/*****************************************************************************/
+void FrameParser::Clear()
+{
+    mReadIndex = 0U;
+    mWriteIndex = 0U;
+}
+
+//=============================================================================
+// End of file FrameParser.cpp
+//=============================================================================
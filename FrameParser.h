@@ -0,0 +1,87 @@
+/*=============================================================================
+ * TarotClub - FrameParser.h
+ *=============================================================================
+ * Stream reassembly of protocol frames received on a socket
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#include <cstdint>
+#include <vector>
+#include "Protocol.h"
+
+/*****************************************************************************/
+/**
+ * @brief The FrameParser class
+ *
+ * Growable receive buffer: the socket reads any amount of bytes into it,
+ * then all the complete frames available are extracted one by one.
+ * A frame may be split across several reads, and one read may contain
+ * several frames.
+ *
+ * Consumed bytes are reclaimed by moving the remaining (partial) data to the
+ * beginning of the buffer, so a frame is always contiguous in memory.
+ * The buffer never grows beyond one maximum frame plus one read chunk since
+ * oversized frames are rejected as soon as their header is received.
+ *
+ * Usage:
+ *   socket.async_read_some(buffer(parser.Prepare(n), n)) then parser.Commit(length)
+ *   while (parser.Next(proto, h) == FRAME_READY) { use parser.Frame(); parser.Consume(h); }
+ */
+class FrameParser
+{
+public:
+    enum Status
+    {
+        FRAME_INCOMPLETE,   ///< Wait for more bytes
+        FRAME_READY,        ///< A full frame is available at Frame()
+        FRAME_ERROR         ///< Malformed or oversized header, close the connection
+    };
+
+    static const std::uint32_t cInitialSize = 4096U;
+
+    FrameParser();
+
+    // Receive side
+    char *Prepare(std::uint32_t size);
+    void Commit(std::uint32_t size);
+
+    // Frame extraction
+    Status Next(const Protocol &proto, Protocol::Header &h) const;
+    const char *Frame() const { return &mBuffer[mReadIndex]; } ///< Valid until next Prepare() or Consume()
+    void Consume(const Protocol::Header &h);
+
+    std::uint32_t Size() const { return mWriteIndex - mReadIndex; }
+    std::uint32_t Capacity() const { return static_cast<std::uint32_t>(mBuffer.size()); }
+    void Clear();
+
+private:
+    std::vector<char> mBuffer;
+    std::uint32_t mReadIndex;
+    std::uint32_t mWriteIndex;
+};
+
+#endif // FRAME_PARSER_H
+
+//=============================================================================
+// End of file FrameParser.h
+//=============================================================================
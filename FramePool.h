@@ -0,0 +1,162 @@
+/**
+ * MIT License
+ * Copyright (c) 2019 Anthony Rabine
+ */
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*****************************************************************************/
+/**
+ * @brief The FramePool class
+ *
+ * Recycles the buffers of the network frames so that, once the pool is warm,
+ * building, sending and receiving a frame does not touch the heap anymore.
+ *
+ * Buffers are plain std::string, so they can be moved through the existing
+ * code (write queues, requests) without any conversion. A buffer is sorted by
+ * its capacity in a size class; each class keeps a bounded number of bytes,
+ * extra buffers are simply freed.
+ *
+ * Thread safe: frames are usually built in a worker thread and released by
+ * the io thread once written.
+ *
+ * Usage:
+ *   std::string frame = FramePool::Instance().Acquire(size); // empty, capacity >= size
+ *   ...
+ *   FramePool::Instance().Release(std::move(frame));
+ */
+class FramePool
+{
+public:
+    struct Stats
+    {
+        std::uint64_t acquired;     ///< Number of buffers given
+        std::uint64_t allocated;    ///< Among them, number of buffers that were not in the pool
+        std::uint64_t released;     ///< Number of buffers given back and kept
+        std::uint64_t discarded;    ///< Number of buffers given back and freed (too small, too big or class full)
+        std::uint64_t cachedBytes;  ///< Capacity currently kept in the pool
+    };
+
+    static const std::uint32_t cNbClasses = 5U;
+    static const std::uint32_t cMinClassSize = 256U;           ///< 256, 1K, 4K, 16K, 64K
+    static const std::uint32_t cMaxBytesPerClass = 1024U * 1024U;
+
+    static FramePool &Instance()
+    {
+        static FramePool pool;
+        return pool;
+    }
+
+    std::string Acquire(std::size_t size)
+    {
+        std::string buffer;
+        std::uint32_t c = ClassOf(size);
+
+        mAcquired++;
+        if (c < cNbClasses)
+        {
+            Class &cl = mClasses[c];
+            std::lock_guard<std::mutex> lock(cl.mutex);
+            if (!cl.free.empty())
+            {
+                buffer.swap(cl.free.back());
+                cl.free.pop_back();
+                mCachedBytes -= buffer.capacity();
+                return buffer;
+            }
+            size = ClassSize(c);
+        }
+        mAllocated++;
+        buffer.reserve(size);
+        return buffer;
+    }
+
+    void Release(std::string &&buffer)
+    {
+        // A buffer serves the largest class it can hold
+        std::size_t capacity = buffer.capacity();
+        std::uint32_t c = cNbClasses;
+        for (std::uint32_t i = 0U; (i < cNbClasses) && (capacity >= ClassSize(i)); i++)
+        {
+            c = i;
+        }
+
+        if ((c < cNbClasses) && (capacity <= (ClassSize(cNbClasses - 1U) * 2U)))
+        {
+            Class &cl = mClasses[c];
+            std::lock_guard<std::mutex> lock(cl.mutex);
+            if (cl.free.size() < (cMaxBytesPerClass / ClassSize(c)))
+            {
+                if (cl.free.capacity() == 0U)
+                {
+                    cl.free.reserve(cMaxBytesPerClass / ClassSize(c));
+                }
+                buffer.clear();
+                mCachedBytes += capacity;
+                cl.free.push_back(std::move(buffer));
+                mReleased++;
+                return;
+            }
+        }
+        mDiscarded++;
+        std::string().swap(buffer);
+    }
+
+    Stats GetStats() const
+    {
+        Stats s;
+        s.acquired = mAcquired;
+        s.allocated = mAllocated;
+        s.released = mReleased;
+        s.discarded = mDiscarded;
+        s.cachedBytes = mCachedBytes;
+        return s;
+    }
+
+private:
+    struct Class
+    {
+        std::mutex mutex;
+        std::vector<std::string> free;
+    };
+
+    Class mClasses[cNbClasses];
+    std::atomic<std::uint64_t> mAcquired{0U};
+    std::atomic<std::uint64_t> mAllocated{0U};
+    std::atomic<std::uint64_t> mReleased{0U};
+    std::atomic<std::uint64_t> mDiscarded{0U};
+    std::atomic<std::uint64_t> mCachedBytes{0U};
+
+    FramePool() = default;
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    static std::size_t ClassSize(std::uint32_t c)
+    {
+        return static_cast<std::size_t>(cMinClassSize) << (2U * c);
+    }
+
+    // Smallest class able to hold size bytes, cNbClasses if none
+    static std::uint32_t ClassOf(std::size_t size)
+    {
+        std::uint32_t c = 0U;
+        while ((c < cNbClasses) && (size > ClassSize(c)))
+        {
+            c++;
+        }
+        return c;
+    }
+};
+
+#endif // FRAME_POOL_H
+
+//=============================================================================
+// End of file FramePool.h
+//=============================================================================
@@ -0,0 +1,101 @@
+/*=============================================================================
+ * TarotClub - ILobbyGateway.h
+ *=============================================================================
+ * What the network sessions need from the game side of the server
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef I_LOBBY_GATEWAY_H
+#define I_LOBBY_GATEWAY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Network.h"
+#include "CredentialStore.h"
+
+/*****************************************************************************/
+class Peer
+{
+public:
+  static const std::uint32_t cCritical = 0U; ///< Message key of the messages that must be delivered
+
+  // Outgoing queue statistics of one peer
+  struct Stats
+  {
+      std::uint32_t uuid;
+      std::uint32_t queuedMessages;   ///< Waiting to be sent
+      std::uint64_t queuedBytes;
+      std::uint64_t maxQueuedBytes;   ///< High water mark
+      std::uint64_t delivered;        ///< Messages handed to the transport
+      std::uint64_t dropped;          ///< Lobby events dropped because the peer is too slow
+      std::uint64_t coalesced;        ///< Lobby events replaced by a newer one
+      bool overflow;                  ///< Disconnected because the peer is too slow
+  };
+
+  virtual ~Peer() {}
+  // key: cCritical, or a lobby event that a newer message with the same key can replace
+  virtual void Deliver(const std::string &data, std::uint32_t key = cCritical) = 0;
+  virtual Stats GetStats() const = 0;
+  // Called from any thread: closes the connection, nothing to do if the peer has none of its own
+  virtual void Disconnect() {}
+};
+
+typedef std::shared_ptr<Peer> PeerPtr;
+
+/*****************************************************************************/
+/**
+ * @brief The ILobbyGateway class
+ *
+ * A connected peer registers itself, then hands its deciphered requests over.
+ * Implemented by the Lobby (everything in this process) and by the ShardRouter
+ * (the lobby is split among several processes).
+ *
+ * The credentials are kept apart from the lobby state: the handshakes read
+ * them without taking any lobby lock.
+ */
+class ILobbyGateway
+{
+public:
+    virtual ~ILobbyGateway() { /* Nothing to do */ }
+
+    virtual std::uint32_t AddUser(PeerPtr peer) = 0; // Returns the UUID of the peer, INVALID_UID if full
+    virtual void RemoveUser(std::uint32_t uuid) = 0;
+    virtual bool Deliver(const Request &req) = 0; // False if the request is refused: the connection must be closed
+    virtual CredentialStore &GetCredentials() = 0;
+
+    void AddAllowedClient(const std::string &webId, const std::string &gek, const std::string &passPhrase)
+    {
+        GetCredentials().Add({ webId, gek, passPhrase });
+    }
+
+    // Null if the player is not allowed on this server
+    CredentialStore::CredentialPtr GetSecurity(const std::string &playerId)
+    {
+        return GetCredentials().Find(playerId);
+    }
+};
+
+#endif // I_LOBBY_GATEWAY_H
+
+//=============================================================================
+// End of file ILobbyGateway.h
+//=============================================================================
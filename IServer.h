@@ -2,7 +2,9 @@
 #define I_SERVER_H
 
 #include <string>
+#include <vector>
 #include "ServerConfig.h"
+#include "CredentialStore.h"
 
 class IServer
 {
@@ -11,6 +13,14 @@ public:
     virtual ~IServer() { /* Nothing to do */ }
 
     virtual void AddClient(const std::string &webId, const std::string &gek, const std::string &passPhrase) = 0;
+    // Bulk version, one credential store update
+    virtual void AddClients(const std::vector<CredentialStore::Credential> &clients)
+    {
+        for (const auto &c : clients)
+        {
+            AddClient(c.webId, c.gek, c.passPhrase);
+        }
+    }
     virtual ServerOptions &GetOptions() = 0;
 };
 
@@ -78,7 +78,7 @@ public:
         return *this;
     }
 
-    std::string GenderToString()
+    std::string GenderToString() const
     {
         std::string txt = cStrInvalid;
         switch(gender)
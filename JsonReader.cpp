@@ -3,13 +3,22 @@
  * Copyright (c) 2019 Anthony Rabine
  */
 
-#include <cctype>
-#include <map>
-#include <iostream>
-#include <string.h>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 #include "JsonReader.h"
 
+// Vectorized string scanning: SSE2 is always there on x86-64
+#if defined(__x86_64__) || defined(_M_X64)
+#define JSON_READER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 // Uncomment this line to enable JSON parsing traces
 //#define JSON_READER_D
 
@@ -30,64 +39,306 @@ bool JsonReader::ParseFile(JsonValue &json, const std::string &fileName)
     f.open(fileName, std::ios_base::in | std::ios_base::binary);
     if (f.is_open())
     {
-        std::ostringstream contents;
-        contents << f.rdbuf();
+        // Read at once in a buffer of the file size
+        std::string contents;
+        f.seekg(0, std::ios_base::end);
+        std::streamoff size = f.tellg();
+        if (size > 0)
+        {
+            contents.resize(static_cast<std::size_t>(size));
+            f.seekg(0, std::ios_base::beg);
+            f.read(&contents[0], size);
+            contents.resize(static_cast<std::size_t>(f.gcount()));
+        }
         f.close();
-        valid = ParseString(json, contents.str());
+        valid = ParseString(json, contents);
     }
 
     return valid;
 }
 /*****************************************************************************/
-bool JsonReader::ParseString(JsonValue &json, const std::string &data)
+bool JsonReader::ParseString(JsonValue &json, std::string_view data)
 {
-    char *endptr;
-    bool valid = false;
+    return Parse(data, json) == JSON_PARSE_OK;
+}
+/*****************************************************************************/
+namespace {
+
+// One open array or object
+struct Level
+{
+    JsonValue node;
+    std::string key;    ///< Inside an object: key waiting for its value, empty if none
+    bool isObject;
+};
+
+/*****************************************************************************/
+// Characters ending a run of plain characters in a string
+inline bool IsSpecial(unsigned char c)
+{
+    return (c == '"') || (c == '\\') || (c < 0x20U) || (c == 0x7FU);
+}
+/*****************************************************************************/
+/**
+ * @brief FindSpecial
+ *
+ * @return the first quote, backslash or control character, or end
+ */
+inline const char *FindSpecial(const char *s, const char *end)
+{
+#ifdef JSON_READER_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
 
-#ifdef USE_WINDOWS_OS
-    char *source = _strdup(data.c_str());
+    while ((end - s) >= 16)
+    {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+        // c <= 0x1F (unsigned) <=> max(c, 0x1F) == 0x1F
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, backslash)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(c, control), control), _mm_cmpeq_epi8(c, del)));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, static_cast<unsigned long>(mask));
+            return s + index;
 #else
-    char *source = strdup(data.c_str());
+            return s + __builtin_ctz(static_cast<unsigned int>(mask));
 #endif
+        }
+        s += 16;
+    }
+#endif
+    while ((s < end) && !IsSpecial(static_cast<unsigned char>(*s)))
+    {
+        s++;
+    }
+    return s;
+}
 
-    JsonReader::ParseStatus status = Parse(source, &endptr, json);
-    if (status == JSON_PARSE_OK)
+} // namespace
+/*****************************************************************************/
+/**
+ * @brief JsonReader::ParseText
+ *
+ * Parses the string after its opening quote; s is moved after the closing one.
+ * UTF-8 bytes are copied as is, \u escapes are encoded in UTF-8.
+ */
+JsonReader::ParseStatus JsonReader::ParseText(const char *&s, const char *end, std::string &text)
+{
+    for (;;)
     {
-        valid = true;
+        const char *run = FindSpecial(s, end);
+        text.append(s, static_cast<std::size_t>(run - s));
+        s = run;
+
+        if ((s == end) || (*s == '\0'))
+        {
+            // Missing closing quote
+            return JSON_PARSE_BAD_STRING;
+        }
+
+        char c = *s++;
+        if (c == '"')
+        {
+            return JSON_PARSE_OK;
+        }
+        if (c != '\\')
+        {
+            // Control character
+            return JSON_PARSE_BAD_STRING;
+        }
+
+        c = (s < end) ? *s : '\0';
+        switch (c)
+        {
+            case '\\':
+            case '"':
+            case '/':
+                text.push_back(c);
+                break;
+            case 'b':
+                text.push_back('\b');
+                break;
+            case 'f':
+                text.push_back('\f');
+                break;
+            case 'n':
+                text.push_back('\n');
+                break;
+            case 'r':
+                text.push_back('\r');
+                break;
+            case 't':
+                text.push_back('\t');
+                break;
+            case 'u':
+            {
+                // Manage unicode encoding
+                int u = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    if ((++s == end) || !isxdigit(static_cast<unsigned char>(*s)))
+                    {
+                        return JSON_PARSE_BAD_STRING;
+                    }
+                    u = u * 16 + CharToInt(*s);
+                }
+                if (u < 0x80)
+                {
+                    text.push_back(static_cast<char>(u));
+                }
+                else if (u < 0x800)
+                {
+                    text.push_back(static_cast<char>(0xC0 | (u >> 6)));
+                    text.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+                }
+                else
+                {
+                    text.push_back(static_cast<char>(0xE0 | (u >> 12)));
+                    text.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+                    text.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+                }
+                break;
+            }
+            default:
+                return JSON_PARSE_BAD_STRING;
+        }
+        s++;
     }
-    free(source);
-    return valid;
 }
 /*****************************************************************************/
-JsonReader::ParseStatus JsonReader::Parse(char *s, char **endptr, JsonValue &json)
+/**
+ * @brief JsonReader::ParseNumber
+ *
+ * [-] digits [. digits] [e|E [+|-] digits]: an integer if there is neither a
+ * fraction nor an exponent, a double otherwise. An exponent without digits
+ * is ignored, a missing integer part is zero.
+ */
+bool JsonReader::ParseNumber(const char *&s, const char *end, JsonValue &value)
 {
-    int pos = -1;
-    int prev = -1;
-    std::map<int, JsonValue::Tag> tags; // keep a trace of tags (open tag/close tag)
-    std::map<int, std::string> keys; // keep a trace of keys inside an object (multiple keys are forbidden)
-    std::map<int, JsonValue> nodes; // keep a link of previous nodes
+    const char *start = s;
+    bool negative = (*s == '-');
+    bool isDouble = false;
+    bool digits = false;
+
+    if (negative)
+    {
+        s++;
+    }
+    while ((s < end) && IsDigit(*s))
+    {
+        s++;
+        digits = true;
+    }
+    if ((s < end) && (*s == '.'))
+    {
+        isDouble = true;
+        s++;
+        while ((s < end) && IsDigit(*s))
+        {
+            s++;
+            digits = true;
+        }
+    }
+    const char *mantissaEnd = s;
+    const char *last = s;
+    if ((s < end) && ((*s == 'e') || (*s == 'E')))
+    {
+        isDouble = true;
+        s++;
+        if ((s < end) && ((*s == '+') || (*s == '-')))
+        {
+            s++;
+        }
+        const char *exponent = s;
+        while ((s < end) && IsDigit(*s))
+        {
+            s++;
+        }
+        // Without digits, the exponent is left out
+        last = (s > exponent) ? s : mantissaEnd;
+    }
+
+    if (!digits)
+    {
+        // "-." alone
+        value = JsonValue(negative ? -0.0 : 0.0);
+        return true;
+    }
+
+    if (!isDouble)
+    {
+        std::int64_t integer;
+        auto res = std::from_chars(start, last, integer);
+        if (res.ec == std::errc())
+        {
+            value = JsonValue(integer);
+            return true;
+        }
+    }
+
+    double number = 0.0;
+    auto res = std::from_chars(start, last, number);
+    if (res.ec == std::errc::result_out_of_range)
+    {
+        // Infinity or zero, as strtod() gives
+        std::string token(start, last);
+        number = std::strtod(token.c_str(), nullptr);
+    }
+    else if (res.ec != std::errc())
+    {
+        return false;
+    }
 
+    if (isDouble)
+    {
+        value = JsonValue(number);
+    }
+    else
+    {
+        // Integer too large for 64 bits
+        value = JsonValue(static_cast<std::int64_t>(number));
+    }
+    return true;
+}
+/*****************************************************************************/
+/**
+ * @brief JsonReader::Parse
+ *
+ * The document must be an array or an object, what follows its end is
+ * ignored. As before, the separators are not required between two values and
+ * a trailing comma is accepted.
+ */
+JsonReader::ParseStatus JsonReader::Parse(std::string_view data, JsonValue &json)
+{
+    const char *s = data.data();
+    const char *end = s + data.size();
+    std::vector<Level> stack; // open tags (arrays and objects), the last one is the current one
     bool separator = true;
-    *endptr = s;
 
-    while (*s)
+    stack.reserve(16U);
+    while ((s < end) && (*s != '\0'))
     {
-        JsonValue o;
-        while (*s && isspace(*s))
+        while ((s < end) && IsSpace(*s))
         {
             ++s;
         }
+        if ((s == end) || (*s == '\0'))
+        {
+            break;
+        }
 
-        *endptr = s++;
-        switch (**endptr)
+        JsonValue o;
+        char c = *s++;
+        switch (c)
         {
-            case '\0':
-                continue;
-                break;
             case '-':
-                if (!isdigit(*s) && *s != '.')
+                if ((s == end) || (!IsDigit(*s) && (*s != '.')))
                 {
-                    *endptr = s;
                     return JSON_PARSE_BAD_NUMBER;
                 }
                 /* fallthrough */
@@ -101,290 +352,119 @@ JsonReader::ParseStatus JsonReader::Parse(char *s, char **endptr, JsonValue &jso
             case '7':
             case '8':
             case '9':
-                o = JsonValue(StringToNumber(*endptr, &s));
-                if (!IsDelim(*s))
+                --s;
+                if (!ParseNumber(s, end, o) || !IsDelim(s, end))
                 {
-                    *endptr = s;
                     return JSON_PARSE_BAD_NUMBER;
                 }
                 break;
             case '"':
             {
-                std::string temp;
 #ifdef JSON_READER_D
                 std::cout << "JSON_TAG_STRING" << std::endl;
 #endif
-                while (*s)
-                {
-                    //int c = *it = *s;
-                    int c = *s;
-                    if (c == '\\')
-                    {
-                        c = *++s;
-                        switch (c)
-                        {
-                            case '\\':
-                            case '"':
-                            case '/':
-                                temp.push_back(c);
-                                break;
-                            case 'b':
-                                temp.push_back('\b');
-                                break;
-                            case 'f':
-                                temp.push_back('\f');
-                                break;
-                            case 'n':
-                                temp.push_back('\n');
-                                break;
-                            case 'r':
-                                temp.push_back('\r');
-                                break;
-                            case 't':
-                                temp.push_back('\t');
-                                break;
-                            case 'u':
-                                // Manage unicode encoding
-                                c = 0;
-                                for (int i = 0; i < 4; ++i)
-                                {
-                                    if (!isxdigit(*++s))
-                                    {
-                                        *endptr = s;
-                                        return JSON_PARSE_BAD_STRING;
-                                    }
-                                    c = c * 16 + CharToInt(*s);
-                                }
-                                if (c < 0x80)
-                                {
-                                    //*it = c;
-                                    temp.push_back(c);
-                                }
-                                else if (c < 0x800)
-                                {
-                                    temp.push_back(0xC0 | (c >> 6));
-                                    temp.push_back(0x80 | (c & 0x3F));
-                                }
-                                else
-                                {
-                                    temp.push_back(0xE0 | (c >> 12));
-                                    temp.push_back(0x80 | ((c >> 6) & 0x3F));
-                                    temp.push_back(0x80 | (c & 0x3F));
-                                }
-                                break;
-                            default:
-                                *endptr = s;
-                                return JSON_PARSE_BAD_STRING;
-                        }
-                    }
-                    else if (iscntrl(c))
-                    {
-                        *endptr = s;
-                        return JSON_PARSE_BAD_STRING;
-                    }
-                    else if (c == '"')
-                    {
-                        ++s;
-                        break;
-                    }
-                    else
-                    {
-                        temp.push_back(c);
-                    }
-                    s++;
-                }
-
-                // Save the string into the JsonValue
-                o = JsonValue(temp);
-
-#ifdef JSON_READER_D
-                std::cout << "Found string: "  << temp << std::endl;
-#endif
+                // A key is parsed directly in its place
+                bool isKey = !stack.empty() && stack.back().isObject && stack.back().key.empty();
+                std::string temp;
+                std::string &text = isKey ? stack.back().key : temp;
 
-                // There must be a ':' after the key or a coma "," after a value
-                if (!IsDelim(*s))
+                if (ParseText(s, end, text) != JSON_PARSE_OK)
                 {
-                    *endptr = s;
                     return JSON_PARSE_BAD_STRING;
                 }
-                break;
-            }
-            case 't':
-                for (const char *it = "rue"; *it; ++it, ++s)
+                // There must be a ':' after the key or a coma "," after a value
+                if (!IsDelim(s, end))
                 {
-                    if (*it != *s)
-                    {
-                        return JSON_PARSE_BAD_IDENTIFIER;
-                    }
+                    return JSON_PARSE_BAD_STRING;
                 }
-                if (!IsDelim(*s))
+                separator = false;
+                if (isKey)
                 {
-                    return JSON_PARSE_BAD_IDENTIFIER;
+                    continue; // Let's continue to find the value ...
                 }
-
-                o = JsonValue(true);
-#ifdef JSON_READER_D
-                std::cout << "JSON_TAG_BOOL" << std::endl;
-#endif
+                o = JsonValue(std::move(temp));
                 break;
+            }
+            case 't':
             case 'f':
-                for (const char *it = "alse"; *it; ++it, ++s)
-                {
-                    if (*it != *s)
-                    {
-                        return JSON_PARSE_BAD_IDENTIFIER;
-                    }
-                }
-                if (!IsDelim(*s))
-                {
-                    return JSON_PARSE_BAD_IDENTIFIER;
-                }
-                o = JsonValue(false);
-#ifdef JSON_READER_D
-                std::cout << "JSON_TAG_BOOL" << std::endl;
-#endif
-
-                break;
             case 'n':
-                for (const char *it = "ull"; *it; ++it, ++s)
-                {
-                    if (*it != *s)
-                    {
-                        return JSON_PARSE_BAD_IDENTIFIER;
-                    }
-                }
-                if (!IsDelim(*s))
+            {
+                std::string_view word = (c == 't') ? "rue" : ((c == 'f') ? "alse" : "ull");
+                if ((static_cast<std::size_t>(end - s) < word.size()) || (std::memcmp(s, word.data(), word.size()) != 0))
                 {
                     return JSON_PARSE_BAD_IDENTIFIER;
                 }
-                o.SetNull();
-#ifdef JSON_READER_D
-                std::cout << "JSON_TAG_BOOL" << std::endl;
-#endif
-
-                break;
-            case ']':
-                if (pos == -1)
+                s += word.size();
+                if (!IsDelim(s, end))
                 {
-                    return JSON_PARSE_STACK_UNDERFLOW;
+                    return JSON_PARSE_BAD_IDENTIFIER;
                 }
-                if (tags[pos] != JsonValue::ARRAY)
+                if (c == 'n')
                 {
-                    return JSON_PARSE_MISMATCH_BRACKET;
-                }
-
-                if (pos > 0)
-                {
-                    // We have finished with this object, add it to the previous node and delete it
-                    prev = pos - 1;
-                    if (tags[prev] == JsonValue::OBJECT)
-                    {
-                        // if previous node was an object, then we create a new object
-                        nodes[prev].GetObj().AddValue(keys[prev], nodes[pos]);
-                    }
-                    else
-                    {
-                        // Object in an array? ==> no tag
-                        nodes[prev].GetArray().AddValue(nodes[pos]);
-                    }
-
-                    nodes.erase(pos);
-                    pos--;
-                    keys[pos] = ""; // key has been used to create the array
-                    separator = false;
+                    o.SetNull();
                 }
                 else
                 {
-                    // End of document
-                    json = nodes[0];
-                    *endptr = s;
-                    return JSON_PARSE_OK;
+                    o = JsonValue(c == 't');
                 }
-                continue;
-
-#ifdef JSON_READER_D
-                std::cout << "TAG_ARRAY_END" << std::endl;
-#endif
-
                 break;
+            }
+            case ']':
             case '}':
-                if (pos == -1)
+            {
+                if (stack.empty())
                 {
                     return JSON_PARSE_STACK_UNDERFLOW;
                 }
-                if (tags[pos] != JsonValue::OBJECT)
+                if (stack.back().isObject != (c == '}'))
                 {
                     return JSON_PARSE_MISMATCH_BRACKET;
                 }
-                if (keys[pos] != "")
+                if (!stack.back().key.empty())
                 {
                     return JSON_PARSE_UNEXPECTED_CHARACTER;
                 }
 
-                if (pos > 0)
+                JsonValue node = std::move(stack.back().node);
+                stack.pop_back();
+                if (stack.empty())
                 {
-                    // We have finished with this object, add it to the previous node and delete it
-                    prev = pos - 1;
-                    if (tags[prev] == JsonValue::OBJECT)
-                    {
-                        // if previous node was an object, then we create a new object
-                        nodes[prev].GetObj().AddValue(keys[prev], nodes[pos]);
-                    }
-                    else
-                    {
-                        // Object in an array? ==> no tag
-                        nodes[prev].GetArray().AddValue(nodes[pos]);
-                    }
+                    // End of document
+                    json = std::move(node);
+                    return JSON_PARSE_OK;
+                }
 
-                    nodes.erase(pos);
-                    pos--;
-                    keys[pos] = ""; // key has been used to create the object
-                    separator = false;
+                // We have finished with this node, add it to the previous one
+                Level &parent = stack.back();
+                if (parent.isObject)
+                {
+                    parent.node.GetObj().AddValue(parent.key, std::move(node));
                 }
                 else
                 {
-                    // End of document
-                    json = nodes[0];
-                    *endptr = s;
-                    return JSON_PARSE_OK;
+                    parent.node.GetArray().AddValue(std::move(node));
                 }
+                parent.key.clear(); // key has been used
+                separator = false;
                 continue;
-
-#ifdef JSON_READER_D
-                std::cout << "TAG_OBJECT_END" << std::endl;
-#endif
-                break;
+            }
             case '[':
-
-#ifdef JSON_READER_D
-                std::cout << "TAG_ARRAY_BEGIN" << std::endl;
-#endif
-                ++pos;
-                nodes[pos] = JsonValue(JsonArray());
-                tags[pos] = JsonValue::ARRAY;
-                keys[pos] = "";
+                stack.push_back({ JsonValue(JsonArray()), std::string(), false });
                 separator = true;
                 continue;
             case '{':
-
-#ifdef JSON_READER_D
-                std::cout << "TAG_OBJECT_BEGIN" << std::endl;
-#endif
-                ++pos;
-                nodes[pos] = JsonValue(JsonObject());
-                tags[pos] = JsonValue::OBJECT;
-                keys[pos] = "";
+                stack.push_back({ JsonValue(JsonObject()), std::string(), true });
                 separator = true;
                 continue;
             case ':':
-                if (separator || keys[pos] == "")
+                if (separator || stack.empty() || stack.back().key.empty())
                 {
                     return JSON_PARSE_UNEXPECTED_CHARACTER;
                 }
                 separator = true;
                 continue;
             case ',':
-                if (separator || keys[pos] != "")
+                if (separator || stack.empty() || !stack.back().key.empty())
                 {
                     return JSON_PARSE_UNEXPECTED_CHARACTER;
                 }
@@ -395,129 +475,29 @@ JsonReader::ParseStatus JsonReader::Parse(char *s, char **endptr, JsonValue &jso
         }
         separator = false;
 
-        // We are here because we are in an object
-        if (tags[pos] == JsonValue::OBJECT)
+        if (stack.empty())
         {
-            if (keys[pos] == "")
-            {
-                // Key found!
-                if (o.GetTag() != JsonValue::STRING)
-                {
-                    return JSON_PARSE_UNQUOTED_KEY;
-                }
-                keys[pos] = o.GetString();
-                continue; // Let's continue to find the value ...
-            }
+            // A value outside of any array or object
+            return JSON_PARSE_ALLOC_ERROR;
+        }
 
-            // Use our own type management, event if the RTTI thing would also work...
-            if (nodes[pos].IsObject())
-            {
-                nodes[pos].GetObj().AddValue(keys[pos], o);
-                keys[pos] = "";
-            }
-            else
+        Level &current = stack.back();
+        if (current.isObject)
+        {
+            if (current.key.empty())
             {
-                return JSON_PARSE_ALLOC_ERROR;
+                return JSON_PARSE_UNQUOTED_KEY;
             }
+            current.node.GetObj().AddValue(current.key, std::move(o));
+            current.key.clear();
         }
         else
         {
-            // We are in an Array
-            // Use our own type management, event if the RTTI thing would also work...
-            if (nodes[pos].IsArray())
-            {
-                nodes[pos].GetArray().AddValue(o);
-                keys[pos] = "";
-            }
-            else
-            {
-                return JSON_PARSE_ALLOC_ERROR;
-            }
+            current.node.GetArray().AddValue(std::move(o));
         }
     }
     return JSON_PARSE_BREAKING_BAD;
 }
-/*****************************************************************************/
-JsonValue JsonReader::StringToNumber(char *s, char **endptr)
-{
-    char ch = *s;
-    if (ch == '+' || ch == '-')
-    {
-        ++s;
-    }
-
-    double result = 0;
-    bool doubleValue = false;
-    JsonValue retVal;
-
-    while (isdigit(*s))
-    {
-        result = (result * 10) + (*s++ - '0');
-    }
-
-    if (*s == '.')
-    {
-        ++s;
-        doubleValue = true;
-
-        double fraction = 1;
-        while (isdigit(*s))
-        {
-            fraction *= 0.1;
-            result += (*s++ - '0') * fraction;
-        }
-    }
-
-    if (*s == 'e' || *s == 'E')
-    {
-        ++s;
-        doubleValue = true;
-
-        double base = 10;
-        if (*s == '+')
-        {
-            ++s;
-        }
-        else if (*s == '-')
-        {
-            ++s;
-            base = 0.1;
-        }
-
-        int exponent = 0;
-        while (isdigit(*s))
-        {
-            exponent = (exponent * 10) + (*s++ - '0');
-        }
-
-        double power = 1;
-        for (; exponent; exponent >>= 1, base *= base)
-        {
-            if (exponent & 1)
-            {
-                power *= base;
-            }
-        }
-
-        result *= power;
-    }
-
-    *endptr = s;
-
-    result = (ch == '-') ? -result : result;
-
-    if (doubleValue)
-    {
-        retVal = result;
-    }
-    else
-    {
-        retVal = static_cast<std::int64_t>(result);
-    }
-
-    return retVal;
-}
-
 
 //=============================================================================
 // End of file JsonReader.cpp
@@ -7,6 +7,7 @@
 #define JSON_READER_H
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -30,6 +31,9 @@
  *
  * To get the value of the key "name", the node path will be: "test2:name"
  *
+ * The text is parsed in one pass, where it is (no copy of the input): the
+ * open arrays and objects are kept on a vector used as a stack, the runs of
+ * plain characters are copied at once into the strings.
  */
 class JsonReader
 {
@@ -52,16 +56,28 @@ public:
 
     // Helpers
     static bool ParseFile(JsonValue &json, const std::string &fileName);
-    static bool ParseString(JsonValue &json, const std::string &data);
+    static bool ParseString(JsonValue &json, std::string_view data);
 
 private:
-    static JsonReader::ParseStatus Parse(char *s, char **endptr, JsonValue &json);
-    static JsonValue StringToNumber(char *s, char **endptr);
+    static JsonReader::ParseStatus Parse(std::string_view data, JsonValue &json);
+    static JsonReader::ParseStatus ParseText(const char *&s, const char *end, std::string &text);
+    static bool ParseNumber(const char *&s, const char *end, JsonValue &value);
 
     /*****************************************************************************/
-    static inline bool IsDelim(char c)
+    static inline bool IsSpace(char c)
     {
-        return isspace(c) || c == ',' || c == ':' || c == ']' || c == '}' || c == '\0';
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+    /*****************************************************************************/
+    static inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+    /*****************************************************************************/
+    // The end of the data counts as a delimiter, as the terminating zero
+    static inline bool IsDelim(const char *s, const char *end)
+    {
+        return (s == end) || IsSpace(*s) || *s == ',' || *s == ':' || *s == ']' || *s == '}' || *s == '\0';
     }
     /*****************************************************************************/
     static inline int CharToInt(char c)
@@ -60,6 +60,11 @@ void JsonArray::AddValue(const JsonValue &value)
     mArray.push_back(value);
 }
 /*****************************************************************************/
+void JsonArray::AddValue(JsonValue &&value)
+{
+    mArray.push_back(std::move(value));
+}
+/*****************************************************************************/
 bool JsonArray::ReplaceValue(const std::string &keyPath, const JsonValue &value)
 {
     bool ret = false;
@@ -125,6 +130,12 @@ void JsonObject::Clear()
 JsonObject::JsonObject(const JsonObject &obj)
 {
     *this = obj;
+}
+/*****************************************************************************/
+JsonObject::JsonObject(JsonObject &&obj) noexcept
+    : mObject(std::move(obj.mObject))
+{
+
 }
 /*****************************************************************************/
 JsonObject &JsonObject::operator = (JsonObject const &rhs)
@@ -133,6 +144,12 @@ JsonObject &JsonObject::operator = (JsonObject const &rhs)
     return *this;
 }
 /*****************************************************************************/
+JsonObject &JsonObject::operator = (JsonObject &&rhs) noexcept
+{
+    mObject = std::move(rhs.mObject);
+    return *this;
+}
+/*****************************************************************************/
 std::string JsonObject::ToString(int32_t level) const
 {
     std::string crlf;
@@ -173,6 +190,11 @@ void JsonObject::AddValue(const std::string &name, const JsonValue &value)
     mObject[name] = value;
 }
 /*****************************************************************************/
+void JsonObject::AddValue(const std::string &name, JsonValue &&value)
+{
+    mObject[name] = std::move(value);
+}
+/*****************************************************************************/
 bool JsonObject::ReplaceValue(const std::string &keyPath, const JsonValue &value)
 {
     bool ret = false;
@@ -384,6 +406,16 @@ JsonValue::JsonValue(const std::string &value)
     , mBoolValue(false)
 {
 
+}
+/*****************************************************************************/
+JsonValue::JsonValue(std::string &&value)
+    : mTag(STRING)
+    , mIntegerValue(0)
+    , mDoubleValue(0.0)
+    , mStringValue(std::move(value))
+    , mBoolValue(false)
+{
+
 }
 /*****************************************************************************/
 JsonValue::JsonValue(bool value)
@@ -398,6 +430,18 @@ JsonValue::JsonValue(bool value)
 JsonValue::JsonValue(const JsonValue &value)
 {
     *this = value;
+}
+/*****************************************************************************/
+JsonValue::JsonValue(JsonValue &&value) noexcept
+    : mTag(value.mTag)
+    , mObject(std::move(value.mObject))
+    , mArray(std::move(value.mArray))
+    , mIntegerValue(value.mIntegerValue)
+    , mDoubleValue(value.mDoubleValue)
+    , mStringValue(std::move(value.mStringValue))
+    , mBoolValue(value.mBoolValue)
+{
+
 }
 /*****************************************************************************/
 JsonValue::JsonValue(const JsonObject &obj)
@@ -407,6 +451,16 @@ JsonValue::JsonValue(const JsonObject &obj)
     , mBoolValue(false)
 {
     mObject = obj;
+}
+/*****************************************************************************/
+JsonValue::JsonValue(JsonObject &&obj)
+    : mTag(OBJECT)
+    , mObject(std::move(obj))
+    , mIntegerValue(0)
+    , mDoubleValue(0.0)
+    , mBoolValue(false)
+{
+
 }
 /*****************************************************************************/
 JsonValue::JsonValue(const JsonArray &array)
@@ -439,6 +493,18 @@ JsonValue &JsonValue::operator =(const JsonValue &rhs)
     return *this;
 }
 /*****************************************************************************/
+JsonValue &JsonValue::operator =(JsonValue &&rhs) noexcept
+{
+    mTag = rhs.mTag;
+    mObject = std::move(rhs.mObject);
+    mArray = std::move(rhs.mArray);
+    mIntegerValue = rhs.mIntegerValue;
+    mDoubleValue = rhs.mDoubleValue;
+    mStringValue = std::move(rhs.mStringValue);
+    mBoolValue = rhs.mBoolValue;
+    return *this;
+}
+/*****************************************************************************/
 void JsonValue::Clear()
 {
     mTag = INVALID;
@@ -37,6 +37,7 @@ class JsonObject
 public:
     JsonObject() {}
     JsonObject(const JsonObject &obj);
+    JsonObject(JsonObject &&obj) noexcept;
 
     std::string ToString(std::int32_t level = -1) const;
     std::string ToCBor() const;
@@ -44,11 +45,13 @@ public:
     JsonValue GetValue(const std::string &keyPath) const;
     void Clear();
     void AddValue(const std::string &name, const JsonValue &value);
+    void AddValue(const std::string &name, JsonValue &&value);
     bool ReplaceValue(const std::string &keyPath, const JsonValue &value);
     std::uint32_t GetSize() { return static_cast<std::uint32_t>(mObject.size()); }
     std::vector<std::string> GetKeys() const;
 
     JsonObject &operator = (JsonObject const &rhs);
+    JsonObject &operator = (JsonObject &&rhs) noexcept;
 
 private:
     std::map<std::string, JsonValue> mObject;
@@ -64,6 +67,7 @@ public:
     JsonValue GetEntry(std::uint32_t index) const;
     std::uint32_t Size() const;
     void AddValue(const JsonValue &value);
+    void AddValue(JsonValue &&value);
     bool ReplaceValue(const std::string &keyPath, const JsonValue &value);
     bool DeleteEntry(std::uint32_t index);
 
@@ -99,10 +103,13 @@ public:
     JsonValue(double value);
     JsonValue(const char *value);
     JsonValue(const std::string &value);
+    JsonValue(std::string &&value);
     JsonValue(bool value);
     JsonValue(const JsonValue &value);
+    JsonValue(JsonValue &&value) noexcept;
     JsonValue(); // default constructor creates an invalid value!
     JsonValue(const JsonObject &obj);
+    JsonValue(JsonObject &&obj);
     JsonValue(const JsonArray &array);
 
     // Implemented virtual methods from IJsonNode
@@ -115,6 +122,7 @@ public:
     void Clear();
 
     JsonValue &operator = (JsonValue const &rhs);
+    JsonValue &operator = (JsonValue &&rhs) noexcept;
 
     bool IsValid() const      { return mTag != INVALID; }
     bool IsArray() const      { return mTag == ARRAY; }
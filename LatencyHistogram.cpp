@@ -0,0 +1,103 @@
+/*=============================================================================
+ * TarotClub - LatencyHistogram.cpp
+ *=============================================================================
+ * Histogram of durations, for the percentiles of the latencies
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <algorithm>
+#include "LatencyHistogram.h"
+
+/*****************************************************************************/
+LatencyHistogram::LatencyHistogram()
+    : mBuckets(cNbBuckets, 0U)
+    , mCount(0U)
+    , mMax(0U)
+{
+
+}
+/*****************************************************************************/
+void LatencyHistogram::Add(std::uint64_t us)
+{
+    mBuckets[Index(us)]++;
+    mCount++;
+    mMax = std::max(mMax, us);
+}
+/*****************************************************************************/
+void LatencyHistogram::Merge(const LatencyHistogram &other)
+{
+    for (std::uint32_t i = 0U; i < cNbBuckets; i++)
+    {
+        mBuckets[i] += other.mBuckets[i];
+    }
+    mCount += other.mCount;
+    mMax = std::max(mMax, other.mMax);
+}
+/*****************************************************************************/
+std::uint64_t LatencyHistogram::Percentile(double p) const
+{
+    std::uint64_t target = static_cast<std::uint64_t>((p * mCount) / 100.0 + 0.5);
+    std::uint64_t sum = 0U;
+
+    target = std::max<std::uint64_t>(target, 1U);
+    for (std::uint32_t i = 0U; i < cNbBuckets; i++)
+    {
+        sum += mBuckets[i];
+        if (sum >= target)
+        {
+            return std::min(Value(i), mMax);
+        }
+    }
+    return mMax;
+}
+/*****************************************************************************/
+// Exact below 64 us, then 32 buckets between two powers of two
+std::uint32_t LatencyHistogram::Index(std::uint64_t us)
+{
+    if (us < (2U << cSubBits))
+    {
+        return static_cast<std::uint32_t>(us);
+    }
+
+    std::uint32_t msb = cSubBits + 1U;
+    while ((msb < 63U) && ((us >> (msb + 1U)) != 0U))
+    {
+        msb++;
+    }
+    std::uint32_t e = msb - cSubBits;
+    std::uint64_t index = (static_cast<std::uint64_t>(e) << cSubBits) + (us >> e);
+    return static_cast<std::uint32_t>(std::min<std::uint64_t>(index, cNbBuckets - 1U));
+}
+/*****************************************************************************/
+// Lowest value of a bucket
+std::uint64_t LatencyHistogram::Value(std::uint32_t index)
+{
+    if (index < (2U << cSubBits))
+    {
+        return index;
+    }
+    std::uint32_t e = (index >> cSubBits) - 1U;
+    return static_cast<std::uint64_t>(index - (e << cSubBits)) << e;
+}
+
+//=============================================================================
+// End of file LatencyHistogram.cpp
+//=============================================================================
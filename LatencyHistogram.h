@@ -0,0 +1,67 @@
+/*=============================================================================
+ * TarotClub - LatencyHistogram.h
+ *=============================================================================
+ * Histogram of durations, for the percentiles of the latencies
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+/*****************************************************************************/
+/**
+ * @brief The LatencyHistogram class
+ *
+ * Log-linear histogram of durations in microseconds: 32 buckets per power of
+ * two, so a percentile is known within 3%, in a fixed 8 KB whatever the
+ * number of samples.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Add(std::uint64_t us);
+    void Merge(const LatencyHistogram &other);
+    std::uint64_t Percentile(double p) const; ///< p in [0, 100]
+    std::uint64_t Count() const { return mCount; }
+    std::uint64_t Max() const { return mMax; }
+
+private:
+    static const std::uint32_t cSubBits = 5U;
+    static const std::uint32_t cNbBuckets = 1024U;
+
+    std::vector<std::uint64_t> mBuckets;
+    std::uint64_t mCount;
+    std::uint64_t mMax;
+
+    static std::uint32_t Index(std::uint64_t us);
+    static std::uint64_t Value(std::uint32_t index);
+};
+
+#endif // LATENCY_HISTOGRAM_H
+
+//=============================================================================
+// End of file LatencyHistogram.h
+//=============================================================================
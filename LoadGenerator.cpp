@@ -0,0 +1,654 @@
+/*=============================================================================
+ * TarotClub - LoadGenerator.cpp
+ *=============================================================================
+ * Swarm of automatic clients to load-test the game server
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include "LoadGenerator.h"
+#include "Bot.h"
+#include "FrameParser.h"
+#include "FramePool.h"
+#include "WriteQueue.h"
+#include "Log.h"
+#include "Util.h"
+
+using namespace boost;
+
+namespace {
+
+// Credentials of the generated clients: the default random generator of Util is seeded with time()
+std::string RandomString(std::uint32_t size)
+{
+    static const char cChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    static std::mutex mutex;
+    static std::mt19937 generator(std::random_device{}());
+    std::uniform_int_distribution<std::uint32_t> distribution(0U, sizeof(cChars) - 2U);
+
+    std::scoped_lock<std::mutex> lock(mutex);
+    std::string str;
+    for (std::uint32_t i = 0U; i < size; i++)
+    {
+        str.push_back(cChars[distribution(generator)]);
+    }
+    return str;
+}
+
+} // namespace
+
+/*****************************************************************************/
+/**
+ * @brief The LoadGenerator::Client class
+ *
+ * One connection of the swarm, played by a Bot. All the methods run in the
+ * thread of its io_context.
+ */
+class LoadGenerator::Client : public INetClient, public std::enable_shared_from_this<LoadGenerator::Client>
+{
+public:
+    static const std::uint32_t cReadChunkSize = 4096U;
+
+    Client(LoadGenerator &generator, asio::io_context &ioc, Shard &shard, std::uint32_t id, std::uint32_t table)
+        : mGen(generator)
+        , mShard(shard)
+        , mSocket(ioc)
+        , mThinkTimer(ioc)
+        , mBot(*this)
+        , mId(id)
+        , mWebId("swarm" + std::to_string(id))
+        , mKey(RandomString(16U))
+        , mPassPhrase(RandomString(16U))
+        , mConnected(false)
+        , mSeated(false)
+        , mWaiting(false)
+        , mThinking(false)
+    {
+        mBot.SetIdentity(Identity(mWebId, "", Identity::cGenderRobot));
+        mBot.SetTableToJoin(table);
+        mProto.SetSecurity(mKey);
+    }
+
+    const std::string &GetWebId() const { return mWebId; }
+    const std::string &GetKey() const { return mKey; }
+    const std::string &GetPassPhrase() const { return mPassPhrase; }
+
+    void Start(const asio::ip::tcp::endpoint &endpoint)
+    {
+        auto self = shared_from_this();
+        asio::post(mSocket.get_executor(), [self, endpoint]()
+        {
+            self->mSocket.async_connect(endpoint, [self](const boost::system::error_code &ec)
+            {
+                if (ec)
+                {
+                    self->mGen.mConnectErrors++;
+                    return;
+                }
+
+                boost::system::error_code ignored;
+                self->mSocket.set_option(asio::ip::tcp::no_delay(true), ignored);
+                self->mConnected = true;
+                self->mGen.mConnected++;
+
+                // Same handshake as the Session: the pass phrase ciphered with our key, our web ID in clear
+                self->Push(self->mProto.Build(0U, Protocol::LOBBY_UID, self->mPassPhrase, self->mWebId));
+                self->DoRead();
+            });
+        });
+    }
+
+    void Close()
+    {
+        auto self = shared_from_this();
+        asio::post(mSocket.get_executor(), [self]() { self->Closed(false); });
+    }
+
+    // From INetClient, called by the Bot
+    void Send(uint32_t my_uid, const std::vector<Reply> &replies) override
+    {
+        for (const auto &r : replies)
+        {
+            std::string data = r.data.ToString();
+            for (auto dest : r.dest)
+            {
+                std::string frame = mProto.Build(my_uid, dest, data);
+                if (!frame.empty())
+                {
+                    mDelayed.push_back(std::move(frame));
+                }
+            }
+
+            mWaitKey = r.data.GetValue("cmd").GetString();
+            if (mWaitKey == "Ack")
+            {
+                mWaitKey += ":" + r.data.GetValue("step").GetString();
+            }
+        }
+
+        if (mDelayed.empty() || mThinking)
+        {
+            return;
+        }
+
+        if (mGen.mOptions.thinkTime > 0U)
+        {
+            // Answers are held while the player "thinks", this sets the pace of the games
+            auto self = shared_from_this();
+            mThinking = true;
+            mThinkTimer.expires_after(std::chrono::milliseconds(mGen.mOptions.thinkTime));
+            mThinkTimer.async_wait([self](const boost::system::error_code &ec)
+            {
+                self->mThinking = false;
+                if (!ec)
+                {
+                    self->Flush();
+                }
+            });
+        }
+        else
+        {
+            Flush();
+        }
+    }
+
+    void ConnectToHost(const std::string &host, uint16_t tcp_port) override
+    {
+        // The generator owns the connections
+        (void) host;
+        (void) tcp_port;
+    }
+
+    void Disconnect() override
+    {
+        Closed(false);
+    }
+
+    void Initialize(const std::string &webId, const std::string &key, const std::string &passPhrase) override
+    {
+        (void) webId;
+        (void) key;
+        (void) passPhrase;
+    }
+
+private:
+    LoadGenerator &mGen;
+    Shard &mShard;
+    asio::ip::tcp::socket mSocket;
+    asio::steady_timer mThinkTimer;
+    Protocol mProto;
+    FrameParser mRxParser;
+    WriteQueue mWriteQueue;
+    Bot mBot;
+    std::uint32_t mId;
+    std::string mWebId;
+    std::string mKey;
+    std::string mPassPhrase;
+    bool mConnected;
+    bool mSeated;
+    std::vector<std::string> mDelayed;     ///< Frames built, waiting for the end of the think time
+
+    // Latency of the last request sent
+    bool mWaiting;
+    bool mThinking;
+    std::string mWaitKey;
+    std::chrono::steady_clock::time_point mWaitStart;
+
+    void Flush()
+    {
+        if (mDelayed.empty())
+        {
+            return;
+        }
+
+        mWaiting = true;
+        mWaitStart = std::chrono::steady_clock::now();
+        for (auto &f : mDelayed)
+        {
+            Push(std::move(f));
+        }
+        mDelayed.clear();
+    }
+
+    void Push(std::string &&frame)
+    {
+        if (!mConnected)
+        {
+            FramePool::Instance().Release(std::move(frame));
+            return;
+        }
+
+        mGen.mFramesSent++;
+        mGen.mBytesSent += frame.size();
+        if (mWriteQueue.Push(std::move(frame)))
+        {
+            StartWrite();
+        }
+    }
+
+    void StartWrite()
+    {
+        auto self = shared_from_this();
+        asio::async_write(mSocket, mWriteQueue.Prepare(), [self](const boost::system::error_code &ec, std::size_t /*length*/)
+        {
+            if (!ec)
+            {
+                if (self->mWriteQueue.Complete())
+                {
+                    self->StartWrite();
+                }
+            }
+            else
+            {
+                self->mWriteQueue.Clear();
+                self->Closed(true);
+            }
+        });
+    }
+
+    void DoRead()
+    {
+        auto self = shared_from_this();
+        mSocket.async_read_some(asio::buffer(mRxParser.Prepare(cReadChunkSize), cReadChunkSize),
+                                [self](const boost::system::error_code &ec, std::size_t length)
+        {
+            if (ec)
+            {
+                self->Closed(true);
+                return;
+            }
+
+            self->mRxParser.Commit(static_cast<std::uint32_t>(length));
+            if (self->ParseFrames())
+            {
+                self->DoRead();
+            }
+            else
+            {
+                self->mGen.mProtocolErrors++;
+                self->Closed(true);
+            }
+        });
+    }
+
+    bool ParseFrames()
+    {
+        bool ret = true;
+        Protocol::Header h;
+        FrameParser::Status status;
+
+        while (ret && ((status = mRxParser.Next(mProto, h)) != FrameParser::FRAME_INCOMPLETE))
+        {
+            if (status == FrameParser::FRAME_READY)
+            {
+                ret = HandleFrame(h, mRxParser.Frame());
+                mRxParser.Consume(h);
+            }
+            else
+            {
+                ret = false;
+            }
+        }
+        return ret;
+    }
+
+    bool HandleFrame(const Protocol::Header &h, const char *frame)
+    {
+        Request req;
+        req.arg = FramePool::Instance().Acquire(h.payload_size / 2U);
+        bool ret = mProto.DecryptPayload(req.arg, h, frame);
+        if (ret)
+        {
+            mGen.mFramesReceived++;
+            mGen.mBytesReceived += PROTO_HEADER_SIZE + h.BodyLength();
+
+            if (mWaiting)
+            {
+                mWaiting = false;
+                std::uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - mWaitStart).count();
+                std::scoped_lock<std::mutex> lock(mShard.mutex);
+                mShard.latencies[mWaitKey].Add(us);
+            }
+
+            std::string type = Protocol::MessageType(req.arg.data(), req.arg.size());
+            if (type == "Error")
+            {
+                mGen.mProtocolErrors++;
+            }
+            else if ((type == "ReplyJoinTable") && !mSeated)
+            {
+                mSeated = true;
+                mGen.mJoined++;
+            }
+            else if ((mId % 4U) == 0U)
+            {
+                // Counted once per table
+                if (type == "EndOfDeal")
+                {
+                    mGen.mDeals++;
+                }
+                else if (type == "EndOfGame")
+                {
+                    mGen.mGames++;
+                }
+            }
+
+            req.src_uuid = h.src_uid;
+            req.dest_uuid = h.dst_uid;
+            mBot.Deliver(req);
+        }
+        FramePool::Instance().Release(std::move(req.arg));
+        return ret;
+    }
+
+    void Closed(bool byPeer)
+    {
+        if (mConnected)
+        {
+            mConnected = false;
+            mGen.mConnected--;
+            if (mSeated)
+            {
+                mSeated = false;
+                mGen.mJoined--;
+            }
+            if (byPeer && mGen.mRunning)
+            {
+                mGen.mDisconnections++;
+            }
+        }
+
+        boost::system::error_code ignored;
+        mThinkTimer.cancel();
+        mSocket.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+        mSocket.close(ignored);
+    }
+};
+
+/*****************************************************************************/
+LoadGenerator::LoadGenerator()
+    : mNextClient(0U)
+    , mRunning(false)
+    , mConnected(0U)
+    , mJoined(0U)
+    , mFramesSent(0U)
+    , mFramesReceived(0U)
+    , mBytesSent(0U)
+    , mBytesReceived(0U)
+    , mDeals(0U)
+    , mGames(0U)
+    , mConnectErrors(0U)
+    , mDisconnections(0U)
+    , mProtocolErrors(0U)
+    , mMemoryStart(0)
+    , mMemoryPeak(0)
+{
+
+}
+/*****************************************************************************/
+LoadGenerator::~LoadGenerator()
+{
+    Stop();
+}
+/*****************************************************************************/
+std::string LoadGenerator::GetName()
+{
+    return "LoadGenerator";
+}
+/*****************************************************************************/
+void LoadGenerator::Initialize(std::shared_ptr<IServer> server, std::shared_ptr<Lobby> lobby)
+{
+    mServer = server;
+    mLobby = lobby;
+}
+/*****************************************************************************/
+/**
+ * @brief LoadGenerator::Start
+ *
+ * Creates the tables (or uses the given ones), registers the credentials then
+ * starts the connections (all at once or at the configured rate).
+ *
+ * @return false if not attached to a server or already running
+ */
+bool LoadGenerator::Start(const Options &options)
+{
+    if (!mServer || (!mLobby && options.tables.empty()) || mRunning)
+    {
+        return false;
+    }
+
+    mOptions = options;
+    mOptions.threads = std::max(mOptions.threads, 1U);
+
+    for (std::uint32_t i = 0U; i < mOptions.threads; i++)
+    {
+        mIoContexts.push_back(std::make_unique<asio::io_context>(1));
+        mWork.push_back(asio::make_work_guard(*mIoContexts.back()));
+        mShards.push_back(std::make_unique<Shard>());
+    }
+
+    // Four clients per table, the last incomplete table is not filled
+    std::uint32_t nbTables = mOptions.clients / 4U;
+    std::vector<CredentialStore::Credential> credentials;
+    if (!mOptions.tables.empty())
+    {
+        nbTables = std::min(nbTables, static_cast<std::uint32_t>(mOptions.tables.size()));
+    }
+    for (std::uint32_t t = 0U; t < nbTables; t++)
+    {
+        std::uint32_t table;
+        if (!mOptions.tables.empty())
+        {
+            table = mOptions.tables[t];
+        }
+        else
+        {
+            table = mLobby->CreateTable("Swarm " + std::to_string(t + 1U));
+            if (table == Protocol::INVALID_UID)
+            {
+                TLogError("[SWARM] Cannot create all the tables, " + std::to_string(t) + " created");
+                break;
+            }
+            mTables.push_back(table);
+        }
+
+        for (std::uint32_t p = 0U; p < 4U; p++)
+        {
+            std::uint32_t id = t * 4U + p;
+            std::uint32_t thread = id % mOptions.threads;
+            auto client = std::make_shared<Client>(*this, *mIoContexts[thread], *mShards[thread], id, table);
+            credentials.push_back({ client->GetWebId(), client->GetKey(), client->GetPassPhrase() });
+            mClients.push_back(client);
+        }
+    }
+    // One bulk load instead of one store update per client
+    mServer->AddClients(credentials);
+
+    mMemoryStart = Util::GetCurrentMemoryUsage();
+    mMemoryPeak = mMemoryStart;
+    mStart = std::chrono::steady_clock::now();
+    mNextClient = 0U;
+    mRunning = true;
+
+    mTimer = std::make_unique<asio::steady_timer>(*mIoContexts[0]);
+    asio::post(*mIoContexts[0], [this]() { Tick(); });
+
+    for (auto &ioc : mIoContexts)
+    {
+        mThreads.emplace_back([ctx = ioc.get()]() { ctx->run(); });
+    }
+
+    TLogInfo("[SWARM] Started " + std::to_string(mClients.size()) + " clients on " + std::to_string(mClients.size() / 4U) + " tables");
+    return true;
+}
+/*****************************************************************************/
+void LoadGenerator::Stop()
+{
+    if (!mRunning)
+    {
+        return;
+    }
+
+    mRunning = false;
+    asio::post(*mIoContexts[0], [this]() { mTimer->cancel(); });
+    for (auto &c : mClients)
+    {
+        c->Close();
+    }
+
+    // The threads leave when the last pending operation is cancelled
+    mWork.clear();
+    for (auto &t : mThreads)
+    {
+        t.join();
+    }
+    mThreads.clear();
+    mClients.clear();
+    mTimer.reset();
+    mIoContexts.clear();
+
+    // Only the tables created here
+    for (auto id : mTables)
+    {
+        mLobby->DestroyTable(id);
+    }
+    mTables.clear();
+}
+/*****************************************************************************/
+void LoadGenerator::Tick()
+{
+    if (!mRunning)
+    {
+        return;
+    }
+
+    // Connection ramp
+    asio::ip::tcp::endpoint endpoint(asio::ip::make_address(mOptions.host), mOptions.port);
+    std::uint32_t target = static_cast<std::uint32_t>(mClients.size());
+    if (mOptions.connectRate > 0U)
+    {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+        target = std::min(target, static_cast<std::uint32_t>(elapsed * mOptions.connectRate) + 1U);
+    }
+
+    while (mNextClient < target)
+    {
+        mClients[mNextClient++]->Start(endpoint);
+    }
+
+    SampleMemory();
+
+    mTimer->expires_after(std::chrono::milliseconds(100));
+    mTimer->async_wait([this](const boost::system::error_code &ec)
+    {
+        if (!ec)
+        {
+            Tick();
+        }
+    });
+}
+/*****************************************************************************/
+void LoadGenerator::SampleMemory()
+{
+    std::int32_t mem = Util::GetCurrentMemoryUsage();
+    std::int32_t peak = mMemoryPeak;
+    while ((mem > peak) && !mMemoryPeak.compare_exchange_weak(peak, mem))
+    {
+    }
+}
+/*****************************************************************************/
+LoadGenerator::Report LoadGenerator::GetReport()
+{
+    Report r;
+
+    SampleMemory();
+    r.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+    r.connected = mConnected;
+    r.joined = mJoined;
+    r.framesSent = mFramesSent;
+    r.framesReceived = mFramesReceived;
+    r.bytesSent = mBytesSent;
+    r.bytesReceived = mBytesReceived;
+    r.deals = mDeals;
+    r.games = mGames;
+    r.connectErrors = mConnectErrors;
+    r.disconnections = mDisconnections;
+    r.protocolErrors = mProtocolErrors;
+    r.memoryStart = mMemoryStart;
+    r.memoryPeak = mMemoryPeak;
+    r.memoryNow = Util::GetCurrentMemoryUsage();
+    r.lobbyEvents = mLobby ? mLobby->GetEventStats() : LobbyEventBus::Stats();
+
+    std::map<std::string, LatencyHistogram> merged;
+    for (auto &s : mShards)
+    {
+        std::scoped_lock<std::mutex> lock(s->mutex);
+        for (auto &l : s->latencies)
+        {
+            merged[l.first].Merge(l.second);
+        }
+    }
+
+    for (auto &m : merged)
+    {
+        TypeReport t;
+        t.type = m.first;
+        t.count = m.second.Count();
+        t.p50 = m.second.Percentile(50.0);
+        t.p99 = m.second.Percentile(99.0);
+        t.p999 = m.second.Percentile(99.9);
+        t.max = m.second.Max();
+        r.latencies.push_back(t);
+    }
+    return r;
+}
+/*****************************************************************************/
+std::string LoadGenerator::Report::ToString() const
+{
+    std::stringstream ss;
+    double seconds = std::max(elapsed, 0.001);
+
+    ss << std::fixed << std::setprecision(1)
+       << "Elapsed: " << elapsed << " s, connected: " << connected << ", seated: " << joined << "\n"
+       << "Sent: " << framesSent << " frames (" << framesSent / seconds << "/s, " << bytesSent / seconds / 1024.0 << " KB/s)\n"
+       << "Received: " << framesReceived << " frames (" << framesReceived / seconds << "/s, " << bytesReceived / seconds / 1024.0 << " KB/s)\n"
+       << "Deals: " << deals << " (" << deals / seconds << "/s), games: " << games << "\n"
+       << "Errors: connect " << connectErrors << ", disconnections " << disconnections << ", protocol " << protocolErrors << "\n"
+       << "Memory: start " << memoryStart / 1024 << " KB, peak " << memoryPeak / 1024 << " KB, now " << memoryNow / 1024 << " KB\n"
+       << "Lobby events: produced " << lobbyEvents.produced << ", merged " << lobbyEvents.merged << ", sent " << lobbyEvents.sent
+       << " in " << lobbyEvents.messages << " messages, " << lobbyEvents.bytesSent / 1024 << " KB (saved " << lobbyEvents.BytesSaved() / 1024 << " KB)\n";
+
+    ss << std::left << std::setw(28) << "Request" << std::right << std::setw(10) << "count"
+       << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "p999 us" << std::setw(10) << "max us" << "\n";
+    for (const auto &t : latencies)
+    {
+        ss << std::left << std::setw(28) << t.type << std::right << std::setw(10) << t.count
+           << std::setw(10) << t.p50 << std::setw(10) << t.p99 << std::setw(10) << t.p999 << std::setw(10) << t.max << "\n";
+    }
+    return ss.str();
+}
+
+//=============================================================================
+// End of file LoadGenerator.cpp
+//=============================================================================
@@ -0,0 +1,181 @@
+/*=============================================================================
+ * TarotClub - LoadGenerator.h
+ *=============================================================================
+ * Swarm of automatic clients to load-test the game server
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "IService.h"
+#include "LobbyEvents.h"
+#include "LatencyHistogram.h"
+
+/*****************************************************************************/
+/**
+ * @brief The LoadGenerator class
+ *
+ * Opens many connections to the local server from a few threads, each one
+ * played by a Bot (built-in algorithm, no script). The credentials are
+ * generated and registered with IServer::AddClients(), the tables are created
+ * in the lobby and filled four by four, then the bots play games in a loop.
+ *
+ * The latency of a request is the time between its sending and the next
+ * message received by the same client; for the Ack requests it includes the
+ * wait for the other players of the table.
+ *
+ * The generator runs in the server process: the memory reported is the one
+ * of the whole process (server and clients).
+ *
+ * Usage:
+ *   auto swarm = std::make_shared<LoadGenerator>();
+ *   server->AddService(swarm);
+ *   swarm->Start(options);
+ *   ... swarm->GetReport().ToString() ...
+ *   swarm->Stop();
+ */
+class LoadGenerator : public IService
+{
+public:
+    struct Options
+    {
+        std::string host;
+        std::uint16_t port;
+        std::uint32_t clients;          ///< Number of connections, rounded down to full tables
+        std::uint32_t threads;          ///< Threads serving all the connections
+        std::uint32_t connectRate;      ///< New connections per second, 0 for all at once
+        std::uint32_t thinkTime;        ///< Delay in milliseconds before each answer of a client, sets the game rate
+        std::vector<std::uint32_t> tables; ///< Existing tables to fill (e.g. in lobby shards), none to create them here
+
+        Options()
+            : host("127.0.0.1")
+            , port(4269U)
+            , clients(40U)
+            , threads(2U)
+            , connectRate(0U)
+            , thinkTime(0U)
+        {
+
+        }
+    };
+
+    struct TypeReport
+    {
+        std::string type;
+        std::uint64_t count;
+        std::uint64_t p50;
+        std::uint64_t p99;
+        std::uint64_t p999;
+        std::uint64_t max;
+    };
+
+    struct Report
+    {
+        double elapsed;                 ///< Seconds since Start()
+        std::uint32_t connected;        ///< Clients currently connected
+        std::uint32_t joined;           ///< Clients seated at their table
+        std::uint64_t framesSent;
+        std::uint64_t framesReceived;
+        std::uint64_t bytesSent;
+        std::uint64_t bytesReceived;
+        std::uint64_t deals;            ///< Deals played to the end, all tables
+        std::uint64_t games;            ///< Games played to the end, all tables
+        std::uint64_t connectErrors;
+        std::uint64_t disconnections;   ///< Connections closed by the server or by a network error
+        std::uint64_t protocolErrors;   ///< Bad frames and "Error" messages from the server
+        std::int32_t memoryStart;       ///< Resident memory of the process at Start(), in bytes
+        std::int32_t memoryPeak;
+        std::int32_t memoryNow;
+        std::vector<TypeReport> latencies; ///< Per request type, in microseconds
+        LobbyEventBus::Stats lobbyEvents;  ///< Whole server, since its start
+
+        std::string ToString() const;
+    };
+
+    LoadGenerator();
+    ~LoadGenerator();
+
+    // From IService
+    std::string GetName();
+    void Initialize(std::shared_ptr<IServer> server, std::shared_ptr<Lobby> lobby);
+    void Stop();
+
+    bool Start(const Options &options);
+    Report GetReport();
+
+private:
+    class Client;
+    friend class Client;
+
+    // Per thread statistics, merged in the report
+    struct Shard
+    {
+        std::mutex mutex;
+        std::map<std::string, LatencyHistogram> latencies;
+    };
+
+    std::shared_ptr<IServer> mServer;
+    std::shared_ptr<Lobby> mLobby;
+    Options mOptions;
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> mIoContexts;
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> mWork;
+    std::vector<std::unique_ptr<Shard>> mShards;
+    std::vector<std::thread> mThreads;
+    std::vector<std::shared_ptr<Client>> mClients;
+    std::vector<std::uint32_t> mTables;
+    std::unique_ptr<boost::asio::steady_timer> mTimer; ///< Connection ramp and memory sampling
+    std::uint32_t mNextClient;
+    std::chrono::steady_clock::time_point mStart;
+    std::atomic<bool> mRunning;
+
+    std::atomic<std::uint32_t> mConnected;
+    std::atomic<std::uint32_t> mJoined;
+    std::atomic<std::uint64_t> mFramesSent;
+    std::atomic<std::uint64_t> mFramesReceived;
+    std::atomic<std::uint64_t> mBytesSent;
+    std::atomic<std::uint64_t> mBytesReceived;
+    std::atomic<std::uint64_t> mDeals;
+    std::atomic<std::uint64_t> mGames;
+    std::atomic<std::uint64_t> mConnectErrors;
+    std::atomic<std::uint64_t> mDisconnections;
+    std::atomic<std::uint64_t> mProtocolErrors;
+    std::int32_t mMemoryStart;
+    std::atomic<std::int32_t> mMemoryPeak;
+
+    void Tick();
+    void SampleMemory();
+};
+
+#endif // LOAD_GENERATOR_H
+
+//=============================================================================
+// End of file LoadGenerator.h
+//=============================================================================
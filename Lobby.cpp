@@ -24,6 +24,8 @@
  */
 
 // C++ files
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <memory>
 
@@ -37,26 +39,147 @@
 #include "JsonReader.h"
 #include "JsonWriter.h"
 
+const std::uint32_t Lobby::cPageSize;
+const std::uint32_t Lobby::cMaxPageSize;
+const std::uint32_t Lobby::cTablePageSize;
+const std::uint32_t Lobby::cMaxTablePageSize;
 
 /*****************************************************************************/
 Lobby::Lobby(bool adminMode)
     : mInitialized(false)
+    , mNbTables(0U)
+    , mTableListValid(false)
+    , mTablePool(std::make_shared<TablePool>())
     , mTableIds(Protocol::TABLES_UID, Protocol::TABLES_UID + Protocol::MAXIMUM_TABLES)
     , mUserIds(Protocol::USERS_UID, Protocol::MAXIMUM_USERS)
     , mAdminMode(adminMode)
     , mEvCounter(0U)
+    , mEventWindow(0U)
+    , mResumeTimeout(PlayingTable::cDefaultResumeTimeout)
+    , mFlushPending(false)
 {
+    SetCapacity(Protocol::MAXIMUM_USERS, Protocol::MAXIMUM_TABLES);
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::GetIdSpaces
+ *
+ * The UUIDs are 16 bits: the tables take a block from TABLES_UID, the users
+ * take the IDs from USERS_UID, skipping the tables block. The numbers are
+ * reduced if the UUID space is too small.
+ */
+void Lobby::GetIdSpaces(std::uint32_t &maxUsers, std::uint32_t &maxTables, UniqueId &tableIds, UniqueId &userIds)
+{
+    maxTables = std::min(std::max(maxTables, 1U), Protocol::MAXIMUM_UID - Protocol::TABLES_UID);
+    std::uint32_t lastTable = Protocol::TABLES_UID + maxTables - 1U;
+
+    std::uint32_t below = Protocol::TABLES_UID - Protocol::USERS_UID;
+    std::uint32_t above = Protocol::MAXIMUM_UID - lastTable;
+    maxUsers = std::min(std::max(maxUsers, 1U), below + above);
+    std::uint32_t lastUser = (maxUsers <= below) ? (Protocol::USERS_UID + maxUsers - 1U) : (lastTable + maxUsers - below);
+
+    tableIds = UniqueId(Protocol::TABLES_UID, lastTable);
+    userIds = UniqueId(Protocol::USERS_UID, lastUser);
+    for (std::uint32_t id = Protocol::TABLES_UID; (id <= lastTable) && (id <= lastUser); id++)
+    {
+        userIds.AddId(id);
+    }
+}
+/*****************************************************************************/
+void Lobby::SetCapacity(std::uint32_t maxUsers, std::uint32_t maxTables)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    GetIdSpaces(maxUsers, maxTables, mTableIds, mUserIds);
+    mTables.assign(maxTables, TableActorPtr());
+    mNbTables = 0U;
+    mTableListValid = false;
 
+    std::stringstream ss;
+    ss << "Lobby capacity: " << maxUsers << " users, " << maxTables << " tables";
+    TLogInfo(ss.str());
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::GetShardTables
+ *
+ * The block of table IDs is divided in 'count' equal parts, one per shard.
+ *
+ * @return false if there are less tables than shards
+ */
+bool Lobby::GetShardTables(std::uint32_t maxTables, std::uint32_t index, std::uint32_t count, std::uint32_t &first, std::uint32_t &last)
+{
+    maxTables = std::min(std::max(maxTables, 1U), Protocol::MAXIMUM_UID - Protocol::TABLES_UID);
+    std::uint32_t perShard = maxTables / std::max(count, 1U);
+
+    first = Protocol::TABLES_UID + index * perShard;
+    last = first + perShard - 1U;
+    return (perShard > 0U) && (index < count);
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SetShard
+ *
+ * The lobby is one shard among 'count': its tables take their IDs from its
+ * own part of the table block, so that the IDs are unique among the shards.
+ * The users are still identified in the whole user space (their UUID is
+ * given by the front-end, see AddUser()).
+ */
+void Lobby::SetShard(std::uint32_t index, std::uint32_t count)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    std::uint32_t first;
+    std::uint32_t last;
+
+    if (GetShardTables(static_cast<std::uint32_t>(mTables.size()), index, count, first, last))
+    {
+        mTableIds = UniqueId(first, last);
+        TLogInfo("Lobby shard " + std::to_string(index + 1U) + "/" + std::to_string(count) +
+                 ": tables " + std::to_string(first) + " to " + std::to_string(last));
+    }
+    else
+    {
+        TLogError("Lobby shard: not enough tables for " + std::to_string(count) + " shards");
+    }
+}
+/*****************************************************************************/
+void Lobby::GetTableRange(std::uint32_t &first, std::uint32_t &last)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    first = mTableIds.GetMin();
+    last = mTableIds.GetMax();
+}
+/*****************************************************************************/
+void Lobby::SetEventWindow(std::uint32_t delayMs, const Timer &timer)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    mEventWindow = delayMs;
+    mTimer = timer;
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SetTablePool
+ *
+ * A destroyed table is reset and kept for the next CreateTable(), which then
+ * does not allocate anything. Creating the tables now prepares a burst of
+ * creations (matchmaking).
+ */
+void Lobby::SetTablePool(std::uint32_t size)
+{
+    mTablePool->Reserve(size, size);
 }
 /*****************************************************************************/
 Lobby::~Lobby()
 {
+    mNotifier.Stop();
     DeleteTables();
 }
 /*****************************************************************************/
 void Lobby::DeleteTables()
 {
-    mTables.clear();
+    std::fill(mTables.begin(), mTables.end(), TableActorPtr());
+    mNbTables = 0U;
+    mTableListValid = false;
+    mTableIds.Clear();
 }
 /*****************************************************************************/
 void Lobby::Initialize(const std::string &name, const std::vector<std::string> &tables)
@@ -70,24 +193,141 @@ void Lobby::Initialize(const std::string &name, const std::vector<std::string> &
     }
 }
 /*****************************************************************************/
-void Lobby::RegisterListener(Observer<JsonValue> &obs)
+/**
+ * @brief Lobby::RegisterListener
+ *
+ * The observer sees all the messages received and sent by the lobby. It is
+ * called from its own thread, never under the lobby lock.
+ */
+void Lobby::RegisterListener(Observer<JsonValue> &obs, LobbyNotifier::Policy policy)
+{
+    Subscribe("Observer", [&obs](const LobbyNotification &n) { obs.Update(n.data); }, policy);
+}
+/*****************************************************************************/
+void Lobby::Subscribe(const std::string &name, const LobbyNotifier::Handler &handler, LobbyNotifier::Policy policy, std::uint32_t capacity)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    mNotifier.Subscribe(name, handler, policy, capacity);
+}
+/*****************************************************************************/
+std::vector<LobbyNotifier::Stats> Lobby::GetListenerStats()
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    return mNotifier.GetStats();
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::Publish
+ *
+ * Gives the replies to the listeners; call it after Send(), the replies are moved
+ */
+void Lobby::Publish(std::vector<Reply> &out)
+{
+    if (mNotifier.HasSubscribers())
+    {
+        for (auto &reply : out)
+        {
+            mNotifier.Publish(std::make_shared<const LobbyNotification>(LobbyNotification::OUTBOUND, Protocol::INVALID_UID,
+                                                                        std::move(reply.dest), std::move(reply.data)));
+        }
+    }
+}
+/*****************************************************************************/
+Lobby::TimedLock::TimedLock(Lobby &lobby)
+    : mLobby(lobby)
+    , mLock(lobby.mNetMutex)
+    , mStart(std::chrono::steady_clock::now())
+{
+
+}
+/*****************************************************************************/
+Lobby::TimedLock::~TimedLock()
 {
-    mSubject.Attach(obs);
+    mLobby.AddLockTime(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - mStart).count());
+}
+/*****************************************************************************/
+void Lobby::AddLockTime(std::uint64_t us)
+{
+    mLockCount++;
+    mLockTotalUs += us;
+
+    std::uint64_t max = mLockMaxUs.load();
+    while ((us > max) && !mLockMaxUs.compare_exchange_weak(max, us))
+    {
+        // max is reloaded by compare_exchange_weak
+    }
+}
+/*****************************************************************************/
+Lobby::LockStats Lobby::GetLockStats() const
+{
+    LockStats stats;
+
+    stats.count = mLockCount.load();
+    stats.totalUs = mLockTotalUs.load();
+    stats.maxUs = mLockMaxUs.load();
+    return stats;
+}
+/*****************************************************************************/
+LobbyEventBus::Stats Lobby::GetEventStats()
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    return mEvents.GetStats();
+}
+/*****************************************************************************/
+std::vector<Peer::Stats> Lobby::GetPeerStats()
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    std::vector<Peer::Stats> stats;
+
+    for (const auto &p : mPeers)
+    {
+        stats.push_back(p.second->GetStats());
+    }
+    return stats;
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::MessageKey
+ *
+ * A status change of a player (nickname, table...) carries its full status:
+ * for a slow peer, only the last one of each player is needed. The arrival
+ * and departure of the players must always be delivered.
+ */
+std::uint32_t Lobby::MessageKey(const JsonObject &data)
+{
+    std::uint32_t key = Peer::cCritical;
+
+    if (data.GetValue("cmd").GetString() == "LobbyEvent")
+    {
+        std::string type = data.GetValue("type").GetString();
+        if ((type != "New") && (type != "Quit"))
+        {
+            key = static_cast<std::uint32_t>(data.GetValue("player:uuid").GetInteger());
+        }
+    }
+    return key;
 }
 /*****************************************************************************/
+/**
+ * @brief Lobby::Send
+ *
+ * Each reply is serialized once; peers only queue the data, the
+ * ciphering is done outside of the network lock
+ */
 void Lobby::Send(const std::vector<Reply> &out)
 {
     // Send all data
     for (std::uint32_t i = 0U; i < out.size(); i++)
     {
-        std::string data = out[i].data.ToString();
+        std::string data = out[i].text.empty() ? out[i].data.ToString() : out[i].text;
+        std::uint32_t key = MessageKey(out[i].data);
         // To all indicated peers
         for (std::uint32_t j = 0U; j < out[i].dest.size(); j++)
         {
             std::uint32_t uuid = out[i].dest[j];
             if (mPeers.count(uuid) > 0)
             {
-                mPeers[uuid]->Deliver(data);
+                mPeers[uuid]->Deliver(data, key);
             }
             else if (uuid == Protocol::LOBBY_UID)
             {
@@ -95,7 +335,7 @@ void Lobby::Send(const std::vector<Reply> &out)
 
                 for (auto & p : mPeers)
                 {
-                    p.second->Deliver(data);
+                    p.second->Deliver(data, key);
                 }
             }
             else
@@ -106,13 +346,20 @@ void Lobby::Send(const std::vector<Reply> &out)
     }
 }
 /*****************************************************************************/
+/**
+ * @brief Lobby::Deliver
+ *
+ * The lobby only routes: table requests are posted to the table actor and
+ * executed outside of the network lock, tables progress in parallel.
+ *
+ * @return false if the request is not a JSON message
+ */
 bool Lobby::Deliver(const Request &req)
 {
-    std::scoped_lock<std::mutex> lock(mNetMutex);
-    std::vector<Reply> out;
-    bool ret = true;
     JsonReader reader;
-    JsonValue json;
+    // Parsed once, shared by the table task and the listeners
+    auto inbound = std::make_shared<LobbyNotification>();
+    JsonValue &json = inbound->data;
 
     if (!reader.ParseString(json, req.arg))
     {
@@ -120,199 +367,427 @@ bool Lobby::Deliver(const Request &req)
         return false;
     }
 
-    // Warn every observer of that event
-    mSubject.Notify(json);
-
-    // Filter using the destination uuid (table or lobby?)
-    if (mTableIds.IsTaken(req.dest_uuid))
+    TableActorPtr actor;
+    TableActor::Message task;
     {
-        // gets the table of the sender
-        std::uint32_t tableId = mUsers.GetPlayerTable(req.src_uuid);
-        if (tableId == req.dest_uuid)
+        TimedLock lock(*this);
+        std::vector<Reply> out;
+
+        // Filter using the destination uuid (table or lobby?)
+        if (mTableIds.IsTaken(req.dest_uuid))
         {
-            // forward it to the suitable table PlayingTable
-            for (auto &t : mTables)
+            // gets the table of the sender
+            std::uint32_t tableId = mUsers.GetPlayerTable(req.src_uuid);
+            if (tableId == req.dest_uuid)
             {
-                if (t->GetId() == tableId)
-                {
-                    t->ExecuteRequest(req.src_uuid, req.dest_uuid, json, out);
-                }
+                // forward it to the suitable table PlayingTable
+                actor = FindTable(tableId);
+                task = [this, req, inbound](PlayingTable &t) {
+                    std::vector<Reply> tableOut;
+                    t.ExecuteRequest(req.src_uuid, req.dest_uuid, inbound->data, tableOut);
+                    SendTableReplies(tableOut);
+                };
+            }
+            else
+            {
+                // Not fatal: the player may have just left the table
+                TLogNetwork("Packet received for an invalid table, or player is not connected to the table");
             }
         }
-        else
+        else if (req.dest_uuid == Protocol::LOBBY_UID)
         {
-            ret = false;
-            TLogNetwork("Packet received for an invalid table, or player is not connected to the table");
-        }
-    }
-    else if (req.dest_uuid == Protocol::LOBBY_UID)
-    {
-        std::string cmd = json.FindValue("cmd").GetString();
+            std::string cmd = json.FindValue("cmd").GetString();
 
-        if (cmd == "ChatMessage")
-        {
-            // cmd, source, target, message
-            std::uint32_t target = json.FindValue("target").GetInteger();
-            out.push_back(Reply(target, json.GetObj()));
-        }
-        else if (cmd == "ReplyLogin")
-        {
-            Users::Entry entry;
+            if (cmd == "ChatMessage")
+            {
+                // cmd, source, target, message
+                std::uint32_t target = json.FindValue("target").GetInteger();
+                out.push_back(Reply(target, json.GetObj()));
+            }
+            else if (cmd == "ReplyLogin")
+            {
+                Users::Entry entry;
 
-            FromJson(entry.identity, json.GetObj());
+                FromJson(entry.identity, json.GetObj());
 
-            if (mUserIds.IsTaken(req.src_uuid))
-            {
-                // Ok, move the user into the main list
-                // User belong to the lobby
-                entry.player.uuid = req.src_uuid;
-                entry.player.tableId = Protocol::LOBBY_UID;
-                if (mUsers.AddEntry(entry))
+                if (mUserIds.IsTaken(req.src_uuid))
                 {
-                    // Create a list of tables available on the server
-                    JsonObject reply;
-                    JsonArray tables;
-
-                    for (const auto & t : mTables)
+                    // Ok, move the user into the main list
+                    // User belong to the lobby
+                    entry.player.uuid = req.src_uuid;
+                    entry.player.tableId = Protocol::LOBBY_UID;
+                    if (mUsers.AddEntry(entry))
                     {
-                        JsonObject table;
-                        table.AddValue("name", t->GetName());
-                        table.AddValue("uuid", t->GetId());
-                        tables.AddValue(table);
-                    }
-
-                    reply.AddValue("cmd", "AccessGranted");
-                    reply.AddValue("tables", tables);
+                        // Final step of the login process: the first page of tables and the first page of players,
+                        // the others are given by RequestTableList and RequestPlayerList.
+                        // Both lists are inserted already serialized
+                        Reply reply(req.src_uuid, JsonObject());
+                        std::string tables;
 
-                    // Add the list of players
-                    std::vector<Users::Entry> users = mUsers.Get(Protocol::LOBBY_UID);
-                    JsonArray array;
+                        reply.data.AddValue("cmd", "AccessGranted");
+                        reply.data.AddValue("tables_total", TablePage(0U, cTablePageSize, tables));
+                        reply.data.AddValue("tables_page_size", cTablePageSize);
+                        PlayerPage(std::string(), Protocol::INVALID_UID, 0U, cPageSize, reply);
+                        reply.text.insert(reply.text.size() - 1U, ",\"tables\":" + tables);
+                        out.push_back(reply);
 
-                    for (uint32_t i = 0U; i < users.size(); i++)
+                        // Send the information for all other users
+                        SendPlayerEvent(req.src_uuid, "New", Protocol::LOBBY_UID, out);
+                    }
+                    else
                     {
-                        array.AddValue(PlayerStatus(users[i].player.uuid));
+                        // Add failed, probably because of the nickname
+                        // FIXME: manage the case: Lobby full
+                        Error(cErrorNickNameUsed, req.src_uuid, out);
                     }
-                    reply.AddValue("players", array);
-
-                    // Send to the player the final step of the login process
-                    out.push_back(Reply(req.src_uuid, reply));
-
-                    // Send the information for all other users
-                    SendPlayerEvent(req.src_uuid, "New", out);
                 }
                 else
                 {
-                    // Add failed, probably because of the nickname
-                    // FIXME: manage the case: Lobby full
-                    Error(cErrorNickNameUsed, req.src_uuid, out);
+                    TLogNetwork("Unknown uuid");
                 }
             }
-            else
+            else if (cmd == "RequestJoinTable")
             {
-                TLogNetwork("Unknown uuid");
-            }
-        }
-        else if (cmd == "RequestJoinTable")
-        {
-            std::uint32_t tableId = json.FindValue("table_id").GetInteger();
+                std::uint32_t tableId = json.FindValue("table_id").GetInteger();
 
-            // A user can join a table if he is _NOT_ already around a table
-            if (mUsers.GetPlayerTable(req.src_uuid) == Protocol::LOBBY_UID)
-            {
-                Place assignedPlace;
-                std::uint8_t nbPlayers = 0U;
-                bool foundTable = false;
-
-                // Forward it to the table PlayingTable
-                JsonObject tableContext;
-                Deck playerDeck;
-                for (auto &t : mTables)
+                // A user can join a table if he is _NOT_ already around a table
+                if (mUsers.GetPlayerTable(req.src_uuid) == Protocol::LOBBY_UID)
                 {
-                    if (t->GetId() == tableId)
+                    actor = FindTable(tableId);
+                    // Tables reserved by a service only accept the reconnections: its players are seated by the service
+                    bool resumeOnly = false;
+                    if (actor && (mReservedTables.count(tableId) > 0U))
+                    {
+                        if (json.HasValue("resume_token"))
+                        {
+                            // A token that resumes no seat must not give a free one
+                            resumeOnly = true;
+                        }
+                        else
+                        {
+                            actor.reset();
+                            Error(cErrorFull, req.src_uuid, out);
+                        }
+                    }
+                    else if (!actor)
                     {
-                        foundTable = true;
-                        assignedPlace = t->AddPlayer(req.src_uuid, nbPlayers);
-                        tableContext = t->GetContext();
-                        playerDeck = t->GetPlayerDeck(assignedPlace);
-                        break;
+                        Error(cErrorTableIdUnknown, req.src_uuid, out);
                     }
+
+                    if (actor)
+                    {
+                        // Reserve the table now, so that a second join request is refused;
+                        // the place is assigned by the table actor
+                        mUsers.SetPlayingTable(req.src_uuid, tableId, Place(Place::NOWHERE));
+                        mStatusText.erase(req.src_uuid);
+                        for (const auto &handler : mUserJoined)
+                        {
+                            handler.second(req.src_uuid, out);
+                        }
+                        std::uint32_t uuid = req.src_uuid;
+                        // Optional resume of a seat lost by a disconnection
+                        std::string token;
+                        std::uint32_t lastSeq = 0U;
+                        if (json.HasValue("resume_token"))
+                        {
+                            token = json.FindValue("resume_token").GetString();
+                            lastSeq = json.FindValue("last_seq").GetInteger();
+                        }
+                        task = [this, uuid, token, lastSeq, resumeOnly](PlayingTable &t) { JoinTable(t, uuid, token, lastSeq, resumeOnly); };
+                    }
+                }
+            }
+            else if (cmd == "RequestQuitTable")
+            {
+                std::uint32_t tableId = json.FindValue("table_id").GetInteger();
+
+                if (mUsers.GetPlayerTable(req.src_uuid) == tableId)
+                {
+                    RemovePlayerFromTable(req.src_uuid, tableId, false, out);
+                }
+            }
+            else if (cmd == "RequestPlayerList")
+            {
+                // Optional filters: nickname prefix, table (LOBBY_UID: players not at a table)
+                std::string prefix;
+                std::uint32_t tableId = Protocol::INVALID_UID;
+                std::uint32_t page = 0U;
+                std::uint32_t pageSize = cPageSize;
+
+                if (json.HasValue("prefix"))
+                {
+                    prefix = json.FindValue("prefix").GetString();
+                }
+                if (json.HasValue("table_id"))
+                {
+                    tableId = json.FindValue("table_id").GetInteger();
+                }
+                if (json.HasValue("page"))
+                {
+                    page = json.FindValue("page").GetInteger();
+                }
+                if (json.HasValue("page_size"))
+                {
+                    pageSize = std::min(std::max(static_cast<std::uint32_t>(json.FindValue("page_size").GetInteger()), 1U), cMaxPageSize);
                 }
 
-                if (!foundTable)
+                Reply reply(req.src_uuid, JsonObject());
+                reply.data.AddValue("cmd", "PlayerList");
+                PlayerPage(prefix, tableId, page, pageSize, reply);
+                out.push_back(reply);
+            }
+            else if (cmd == "RequestTableList")
+            {
+                std::uint32_t page = 0U;
+                std::uint32_t pageSize = cTablePageSize;
+                std::string tables;
+
+                if (json.HasValue("page"))
                 {
-                    Error(cErrorTableIdUnknown, req.src_uuid, out);
+                    page = json.FindValue("page").GetInteger();
                 }
-                else if (assignedPlace.IsValid())
+                if (json.HasValue("page_size"))
                 {
-                    mUsers.SetPlayingTable(req.src_uuid, tableId, assignedPlace);
+                    pageSize = std::min(std::max(static_cast<std::uint32_t>(json.FindValue("page_size").GetInteger()), 1U), cMaxTablePageSize);
+                }
+
+                Reply reply(req.src_uuid, JsonObject());
+                reply.data.AddValue("cmd", "TableList");
+                reply.data.AddValue("total", TablePage(page, pageSize, tables));
+                reply.data.AddValue("page", page);
+                reply.data.AddValue("page_size", pageSize);
+                reply.text = reply.data.ToString();
+                reply.text.insert(reply.text.size() - 1U, ",\"tables\":" + tables);
+                out.push_back(reply);
+            }
+            else if (cmd == "RequestChangeNickname")
+            {
+                std::string nickname = json.FindValue("nickname").GetString();
 
-                    JsonObject reply;
 
-                    reply.AddValue("cmd", "ReplyJoinTable");
-                    reply.AddValue("table_id", tableId);
-                    reply.AddValue("place", assignedPlace.ToString());
-                    reply.AddValue("deck", playerDeck.ToString());
-                    reply.AddValue("context", tableContext); // On envoie toujours tout le contexte de la partie en cours de la table
+                if (mUsers.ChangeNickName(req.src_uuid, nickname))
+                {
+                    mStatusText.erase(req.src_uuid);
+                    std::vector<std::uint32_t> peers;
+                    peers.push_back(req.src_uuid);
 
-                    out.push_back(Reply(req.src_uuid, reply));
-                    SendPlayerEvent(req.src_uuid, "JoinTable", out);
+                    // Send to all the list of players and the event
+                    SendPlayerEvent(req.src_uuid, "Nick", mUsers.GetPlayerTable(req.src_uuid), out);
                 }
                 else
                 {
-                    Error(cErrorFull, req.src_uuid, out);
+                    Error(cErrorNickNameUsed, req.src_uuid, out);
                 }
             }
+            else if (mCommands.count(cmd) > 0U)
+            {
+                // Command of a service
+                std::uint32_t tableId = mUsers.IsHere(req.src_uuid) ? mUsers.GetPlayerTable(req.src_uuid) : Protocol::INVALID_UID;
+                mCommands[cmd](req.src_uuid, tableId, json, out);
+            }
+            else
+            {
+                TLogNetwork("Lobby received a bad packet");
+            }
         }
-        else if (cmd == "RequestQuitTable")
+        else
         {
-            std::uint32_t tableId = json.FindValue("table_id").GetInteger();
+            std::stringstream ss;
+            ss << "Packet destination must be the table or the lobby, nothing else; received UID: " << req.dest_uuid;
+            TLogNetwork(ss.str());
+        }
 
-            if (mUsers.GetPlayerTable(req.src_uuid) == tableId)
-            {
-                RemovePlayerFromTable(req.src_uuid, tableId, out);
-            }
+        Send(out);
+
+        // Warn every listener of that event, then of every output packet
+        if (mNotifier.HasSubscribers())
+        {
+            inbound->direction = LobbyNotification::INBOUND;
+            inbound->src = req.src_uuid;
+            inbound->dest.push_back(req.dest_uuid);
+            mNotifier.Publish(inbound);
+            Publish(out);
         }
-        else if (cmd == "RequestChangeNickname")
+    }
+
+    // Posted once the lock is released: without executor the task runs immediately and takes the lock itself
+    if (actor && task)
+    {
+        actor->Post(task);
+    }
+
+    return true;
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::JoinTable
+ *
+ * Executed by the table actor; the lobby state is updated under the network lock.
+ * With a valid resume token, the player takes back its seat and only gets the
+ * table events it has missed since lastSeq, or a snapshot if they are too old.
+ * With resumeOnly, the player is refused if it cannot take back its seat.
+ */
+void Lobby::JoinTable(PlayingTable &table, std::uint32_t uuid, const std::string &token, std::uint32_t lastSeq, bool resumeOnly)
+{
+    std::uint8_t nbPlayers = 0U;
+    std::vector<Reply> missed;
+    bool resumed = false;
+    bool replayed = false;
+
+    Place assignedPlace = table.ResumePlayer(uuid, token);
+    if (assignedPlace.IsValid())
+    {
+        resumed = true;
+        replayed = table.GetEventsSince(assignedPlace, lastSeq, missed);
+    }
+    else if (!resumeOnly)
+    {
+        assignedPlace = table.AddPlayer(uuid, nbPlayers);
+    }
+
+    std::uint32_t tableId = table.GetId();
+    std::uint32_t seq = table.GetEventSequence();
+    std::string resumeToken;
+    JsonObject tableContext;
+    Deck playerDeck;
+
+    if (assignedPlace.IsValid())
+    {
+        resumeToken = table.GetResumeToken(assignedPlace);
+        if (!replayed)
         {
-            std::string nickname = json.FindValue("nickname").GetString();
+            tableContext = table.GetContext();
+            playerDeck = table.GetPlayerDeck(assignedPlace);
+        }
+    }
 
+    TimedLock lock(*this);
+    std::vector<Reply> out;
 
-            if (mUsers.ChangeNickName(req.src_uuid, nickname))
-            {
-                std::vector<std::uint32_t> peers;
-                peers.push_back(req.src_uuid);
+    if (mUsers.GetPlayerTable(uuid) != tableId)
+    {
+        // Disconnected or quit meanwhile, the table removal is already in the mailbox
+        return;
+    }
 
-                // Send to all the list of players and the event
-                SendPlayerEvent(req.src_uuid, "Nick", out);
-            }
-            else
-            {
-                Error(cErrorNickNameUsed, req.src_uuid, out);
-            }
+    if (assignedPlace.IsValid())
+    {
+        mUsers.SetPlayingTable(uuid, tableId, assignedPlace);
+        mStatusText.erase(uuid);
+
+        JsonObject reply;
+
+        reply.AddValue("cmd", "ReplyJoinTable");
+        reply.AddValue("table_id", tableId);
+        reply.AddValue("place", assignedPlace.ToString());
+        reply.AddValue("seq", seq);
+        reply.AddValue("resume_token", resumeToken);
+        if (replayed)
+        {
+            // The missed events follow this reply
+            reply.AddValue("resume", "events");
         }
         else
         {
-            ret = false;
-            TLogNetwork("Lobby received a bad packet");
+            if (resumed)
+            {
+                reply.AddValue("resume", "snapshot");
+            }
+            reply.AddValue("deck", playerDeck.ToString());
+            reply.AddValue("context", tableContext); // On envoie tout le contexte de la partie en cours de la table
         }
+
+        out.push_back(Reply(uuid, reply));
+        out.insert(out.end(), missed.begin(), missed.end());
+        SendPlayerEvent(uuid, "JoinTable", tableId, out);
     }
     else
     {
-        ret = false;
-        std::stringstream ss;
-        ss << "Packet destination must be the table or the lobby, nothing else; received UID: " << req.dest_uuid;
-        TLogNetwork(ss.str());
+        // Back to the lobby
+        mUsers.SetPlayingTable(uuid, Protocol::LOBBY_UID, Place(Place::NOWHERE));
+        mStatusText.erase(uuid);
+        Error(cErrorFull, uuid, out);
     }
 
     Send(out);
+    Publish(out);
+}
+/*****************************************************************************/
+void Lobby::SendTableReplies(std::vector<Reply> &out)
+{
+    TimedLock lock(*this);
+
+    Send(out);
+    Publish(out);
+}
+/*****************************************************************************/
+TableActorPtr Lobby::FindTable(std::uint32_t tableId)
+{
+    TableActorPtr actor;
 
-    // Also send every output packet to listeners
-    for (auto &reply : out)
+    if ((tableId >= Protocol::TABLES_UID) && ((tableId - Protocol::TABLES_UID) < mTables.size()))
     {
-        mSubject.Notify(reply.data);
+        actor = mTables[tableId - Protocol::TABLES_UID];
+    }
+    return actor;
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::TablePage
+ *
+ * One page of the tables, sorted by ID, as a serialized JSON array. The whole
+ * list would not fit in one frame with thousands of tables.
+ *
+ * @return The total number of tables
+ */
+std::uint32_t Lobby::TablePage(std::uint32_t page, std::uint32_t pageSize, std::string &tables)
+{
+    if (!mTableListValid)
+    {
+        mTableList.clear();
+        for (const auto &t : mTables)
+        {
+            if (t)
+            {
+                JsonObject table;
+                table.AddValue("name", t->GetName());
+                table.AddValue("uuid", t->GetId());
+                mTableList.push_back(table.ToString());
+            }
+        }
+        mTableListValid = true;
     }
 
-    return ret;
+    std::uint64_t first = std::min<std::uint64_t>(static_cast<std::uint64_t>(page) * pageSize, mTableList.size());
+    std::uint64_t last = std::min<std::uint64_t>(first + pageSize, mTableList.size());
+
+    tables = "[";
+    for (std::uint64_t i = first; i < last; i++)
+    {
+        if (i > first)
+        {
+            tables += ",";
+        }
+        tables += mTableList[i];
+    }
+    tables += "]";
+
+    return static_cast<std::uint32_t>(mTableList.size());
+}
+/*****************************************************************************/
+std::vector<TableActor::Stats> Lobby::GetTableStats()
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    std::vector<TableActor::Stats> stats;
+
+    for (const auto &t : mTables)
+    {
+        if (t)
+        {
+            stats.push_back(t->GetStats());
+        }
+    }
+    return stats;
 }
 /*****************************************************************************/
 std::uint32_t Lobby::GetNumberOfPlayers()
@@ -322,59 +797,117 @@ std::uint32_t Lobby::GetNumberOfPlayers()
 /*****************************************************************************/
 uint32_t Lobby::GetNumberOfTables()
 {
-    return mTables.size();
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    return mNbTables;
 }
 /*****************************************************************************/
 uint32_t Lobby::AddUser(PeerPtr peer)
 {
     std::scoped_lock<std::mutex> lock(mNetMutex);
     std::uint32_t uuid = mUserIds.TakeId();
+
+    if (uuid != Protocol::INVALID_UID)
+    {
+        mPeers[uuid] = peer;
+    }
+    else
+    {
+        TLogError("[LOBBY] Cannot add user: maximum number of users reached.");
+    }
+    return uuid;
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::AddUser
+ *
+ * The UUID has been allocated by a front-end that shares the users among
+ * several lobbies (shards)
+ *
+ * @return uuid, or INVALID_UID if it is already used here
+ */
+std::uint32_t Lobby::AddUser(PeerPtr peer, std::uint32_t uuid)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+
+    // The IDs of the table block are marked as taken in the user space
+    if (mUserIds.IsTaken(uuid) || (uuid < mUserIds.GetMin()) || (uuid > mUserIds.GetMax()))
+    {
+        TLogError("[LOBBY] Cannot add user " + std::to_string(uuid) + ": UUID already used or out of range.");
+        return Protocol::INVALID_UID;
+    }
+
+    mUserIds.AddId(uuid);
     mPeers[uuid] = peer;
     return uuid;
 }
 /*****************************************************************************/
 void Lobby::RemoveUser(uint32_t uuid)
 {
-    std::scoped_lock<std::mutex> lock(mNetMutex);
+    TimedLock lock(*this);
     std::vector<Reply> out;
     std::uint32_t tableId = mUsers.GetPlayerTable(uuid);
     if (tableId != Protocol::LOBBY_UID)
     {
-        // First, remove the player from the table
-        RemovePlayerFromTable(uuid, tableId, out);
+        // First, remove the player from the table; its seat is kept if a game is running
+        RemovePlayerFromTable(uuid, tableId, true, out);
+    }
+
+    if (mUsers.IsHere(uuid))
+    {
+        SendPlayerEvent(uuid, "Quit", Protocol::LOBBY_UID, out);
     }
-//    // Generate qui event
-//    SendPlayerEvent(uuid, "Quit", out);
 
     // Remove the player from the lobby list
     mUsers.Remove(uuid);
+    mStatusText.erase(uuid);
+    mPeers.erase(uuid);
+
+    // The services forget it before its ID is given to somebody else
+    for (const auto &handler : mUserRemoved)
+    {
+        handler.second(uuid);
+    }
+
     // Free the ID
     mUserIds.ReleaseId(uuid);
+
+    Send(out);
+    Publish(out);
 }
 /*****************************************************************************/
 void Lobby::RemoveAllUsers()
 {
     mUsers.Clear();
+    mStatusText.clear();
 }
 /*****************************************************************************/
-std::uint32_t Lobby::CreateTable(const std::string &tableName, const Tarot::Game &game)
+std::uint32_t Lobby::CreateTable(const std::string &tableName, const Tarot::Game &game, std::uint8_t nbPlayers)
 {
-    std::uint32_t id = mTableIds.TakeId();
+    std::uint32_t id;
+    {
+        std::scoped_lock<std::mutex> lock(mNetMutex);
+        id = mTableIds.TakeId();
+    }
 
     if (id > 0U)
     {
-        std::stringstream ss;
-        ss << "Creating table \"" << tableName << "\": id=" << id << std::endl;
-        TLogInfo(ss.str());
+        TLogInfo("Creating table \"" + tableName + "\": id=" + std::to_string(id));
 
-        auto table = std::make_unique<PlayingTable>();
+        std::unique_ptr<PlayingTable> table = mTablePool->Take();
         table->SetId(id);
         table->SetName(tableName);
         table->SetAdminMode(mAdminMode);
+        table->SetResumeTimeout(mResumeTimeout);
         table->SetupGame(game);
         table->Initialize();
-        table->CreateTable(4U);
-        mTables.push_back(std::move(table));
+        table->CreateTable(nbPlayers);
+
+        std::scoped_lock<std::mutex> lock(mNetMutex);
+        TablePoolPtr pool = mTablePool;
+        mTables[id - Protocol::TABLES_UID] = std::make_shared<TableActor>(std::move(table), mExecutor,
+                                                                          [pool](std::unique_ptr<PlayingTable> t) { pool->Recycle(std::move(t)); });
+        mNbTables++;
+        mTableListValid = false;
     }
     else
     {
@@ -385,20 +918,153 @@ std::uint32_t Lobby::CreateTable(const std::string &tableName, const Tarot::Game
 /*****************************************************************************/
 bool Lobby::DestroyTable(std::uint32_t id)
 {
+    // Pending messages keep the actor alive until the mailbox is empty; the
+    // last reference recycles the table, here after the lock is released
+    TableActorPtr actor;
+    std::scoped_lock<std::mutex> lock(mNetMutex);
     bool ret = false;
 
-    auto it = find_if(mTables.begin(), mTables.end(), [&](std::unique_ptr<PlayingTable>& t){ return t->GetId() == id; });
-
-    if (it != mTables.end())
+    if (FindTable(id))
     {
         ret = true;
-        mTables.erase(it);
+        actor.swap(mTables[id - Protocol::TABLES_UID]);
+        mNbTables--;
+        mTableListValid = false;
     }
+    mReservedTables.erase(id);
 
     mTableIds.ReleaseId(id);
     return ret;
 }
 /*****************************************************************************/
+/**
+ * @brief Lobby::ReserveTable
+ *
+ * The table is kept for a service (matchmaking): RequestJoinTable is refused,
+ * except for the reconnections. The service seats the players, bots included,
+ * with SeatPlayers().
+ */
+void Lobby::ReserveTable(std::uint32_t tableId)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    mReservedTables.insert(tableId);
+}
+/*****************************************************************************/
+void Lobby::ReleaseTable(std::uint32_t tableId)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    mReservedTables.erase(tableId);
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SeatPlayers
+ *
+ * Sends players of the lobby to a table, as if they had asked to join it
+ *
+ * @param accept Optional, called under the lobby lock: false if the player
+ *               must not be seated (its UUID may be the one of a new player)
+ * @return The players seated, the others have left the lobby meanwhile
+ */
+std::vector<std::uint32_t> Lobby::SeatPlayers(std::uint32_t tableId, const std::vector<std::uint32_t> &uuids, const UserFilter &accept)
+{
+    std::vector<std::uint32_t> seated;
+    TableActorPtr actor;
+    {
+        TimedLock lock(*this);
+
+        actor = FindTable(tableId);
+        if (actor)
+        {
+            for (auto uuid : uuids)
+            {
+                if (mUsers.IsHere(uuid) && (mUsers.GetPlayerTable(uuid) == Protocol::LOBBY_UID) &&
+                    (!accept || accept(uuid)))
+                {
+                    mUsers.SetPlayingTable(uuid, tableId, Place(Place::NOWHERE));
+                    mStatusText.erase(uuid);
+                    seated.push_back(uuid);
+                }
+            }
+        }
+    }
+
+    for (auto uuid : seated)
+    {
+        actor->Post([this, uuid](PlayingTable &t) { JoinTable(t, uuid, std::string(), 0U, false); });
+    }
+    return seated;
+}
+/*****************************************************************************/
+// INVALID_UID if the player is not connected
+std::uint32_t Lobby::GetPlayerTable(std::uint32_t uuid)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    return mUsers.IsHere(uuid) ? mUsers.GetPlayerTable(uuid) : Protocol::INVALID_UID;
+}
+/*****************************************************************************/
+std::uint32_t Lobby::GetNumberOfPlayers(std::uint32_t tableId)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    return static_cast<std::uint32_t>(mUsers.GetTablePlayerIds(tableId).size());
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SetCommandHandler
+ *
+ * Lobby commands handled by a service. The handler is called under the lobby
+ * lock: it must not call the lobby. An empty handler removes the command.
+ */
+void Lobby::SetCommandHandler(const std::string &cmd, const CommandHandler &handler)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    if (handler)
+    {
+        mCommands[cmd] = handler;
+    }
+    else
+    {
+        mCommands.erase(cmd);
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SetUserRemovedHandler
+ *
+ * Called under the lobby lock when a player leaves, before its UUID is
+ * released. It must not call the lobby. An empty handler removes it.
+ */
+void Lobby::SetUserRemovedHandler(const std::string &service, const UserHandler &handler)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    if (handler)
+    {
+        mUserRemoved[service] = handler;
+    }
+    else
+    {
+        mUserRemoved.erase(service);
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SetUserJoinedHandler
+ *
+ * Called under the lobby lock when a player asks to join a table, once the
+ * request is accepted. It must not call the lobby. An empty handler removes it.
+ */
+void Lobby::SetUserJoinedHandler(const std::string &service, const UserReplyHandler &handler)
+{
+    std::scoped_lock<std::mutex> lock(mNetMutex);
+    if (handler)
+    {
+        mUserJoined[service] = handler;
+    }
+    else
+    {
+        mUserJoined.erase(service);
+    }
+}
+/*****************************************************************************/
 void Lobby::Error(std::uint32_t error, std::uint32_t dest_uuid, std::vector<Reply> &out)
 {
     static const char* errors[] { "Table is full", "Nickname already used", "Unknown table ID" };
@@ -415,16 +1081,13 @@ void Lobby::Error(std::uint32_t error, std::uint32_t dest_uuid, std::vector<Repl
     }
 }
 /*****************************************************************************/
-void Lobby::RemovePlayerFromTable(std::uint32_t uuid, std::uint32_t tableId, std::vector<Reply> &out)
+void Lobby::RemovePlayerFromTable(std::uint32_t uuid, std::uint32_t tableId, bool keepSeat, std::vector<Reply> &out)
 {
-    // Forward it to the table PlayingTable
-    for (auto &t : mTables)
+    // Forward it to the table actor, queued after any pending request of this player
+    TableActorPtr actor = FindTable(tableId);
+    if (actor)
     {
-        if (t->GetId() == tableId)
-        {
-            // Remove the player from the table, if we are in game, then all are removed
-            t->RemovePlayer(uuid);
-        }
+        actor->Post([uuid, keepSeat](PlayingTable &t) { t.RemovePlayer(uuid, keepSeat); });
     }
 
     // Warn one or more player that they are kicked from the table
@@ -436,17 +1099,17 @@ void Lobby::RemovePlayerFromTable(std::uint32_t uuid, std::uint32_t tableId, std
     {
         if (mUsers.IsHere(peers[i]))
         {
-            mUsers.SetPlayingTable(peers[i], 0U, Place(Place::NOWHERE)); // refresh lobby state
+            mUsers.SetPlayingTable(peers[i], Protocol::LOBBY_UID, Place(Place::NOWHERE)); // refresh lobby state
+            mStatusText.erase(peers[i]);
         }
 
-        SendPlayerEvent(peers[i], "LeaveTable", out);
+        SendPlayerEvent(peers[i], "LeaveTable", tableId, out);
     }
 }
 /*****************************************************************************/
 JsonObject Lobby::PlayerStatus(std::uint32_t uuid)
 {
     JsonObject obj;
-    Users::Entry entry;
 
     /**
     {
@@ -458,21 +1121,77 @@ JsonObject Lobby::PlayerStatus(std::uint32_t uuid)
         "place": "South"
     }
     */
-    if (mUsers.GetEntry(uuid, entry))
+    const Users::Entry *entry = mUsers.Find(uuid);
+    if (entry != nullptr)
     {
         obj.AddValue("uuid", uuid);
-        obj.AddValue("table", entry.player.tableId);
-        obj.AddValue("place", entry.player.place.ToString());
-        ToJson(entry.identity, obj);
+        obj.AddValue("table", entry->player.tableId);
+        obj.AddValue("place", entry->player.place.ToString());
+        ToJson(entry->identity, obj);
     }
 
     return obj;
 }
 /*****************************************************************************/
-void Lobby::SendPlayerEvent(std::uint32_t uuid, const std::string &event, std::vector<Reply> &out)
+/**
+ * @brief Lobby::PlayerStatusText
+ *
+ * Serialized status of a player, kept until its next change
+ */
+const std::string &Lobby::PlayerStatusText(std::uint32_t uuid)
+{
+    auto it = mStatusText.find(uuid);
+    if (it == mStatusText.end())
+    {
+        it = mStatusText.emplace(uuid, PlayerStatus(uuid).ToString()).first;
+    }
+    return it->second;
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::PlayerPage
+ *
+ * Adds one page of the players, sorted by nickname, to a reply:
+ *   "total": number of matching players, "page", "page_size", "players": [ ... ]
+ * The list of players is inserted in the serialized reply (reply.text).
+ */
+void Lobby::PlayerPage(const std::string &prefix, std::uint32_t tableId, std::uint32_t page, std::uint32_t pageSize, Reply &reply)
+{
+    std::vector<std::uint32_t> uuids;
+    std::uint64_t offset = static_cast<std::uint64_t>(page) * pageSize;
+    std::uint32_t total = mUsers.Select(prefix, tableId, static_cast<std::uint32_t>(std::min<std::uint64_t>(offset, mUsers.Size())), pageSize, uuids);
+
+    reply.data.AddValue("total", total);
+    reply.data.AddValue("page", page);
+    reply.data.AddValue("page_size", pageSize);
+
+    std::string players = ",\"players\":[";
+    for (std::uint32_t i = 0U; i < uuids.size(); i++)
+    {
+        if (i > 0U)
+        {
+            players += ",";
+        }
+        players += PlayerStatusText(uuids[i]);
+    }
+    players += "]";
+
+    reply.text = reply.data.ToString();
+    reply.text.insert(reply.text.size() - 1U, players);
+}
+/*****************************************************************************/
+/**
+ * @brief Lobby::SendPlayerEvent
+ *
+ * The event is given to the event bus, sent at once or at the end of the
+ * event window. The players around a table do not receive the events of the
+ * lobby: when they come back, they get the full list of players.
+ *
+ * @param tableId Table concerned by the event, its players receive it
+ */
+void Lobby::SendPlayerEvent(std::uint32_t uuid, const std::string &event, std::uint32_t tableId, std::vector<Reply> &out)
 {
-    Users::Entry entry;
-    if (mUsers.GetEntry(uuid, entry))
+    if (mUsers.IsHere(uuid))
     {
         /**
             "cmd": "Event",
@@ -487,8 +1206,35 @@ void Lobby::SendPlayerEvent(std::uint32_t uuid, const std::string &event, std::v
         obj.AddValue("type", event);
         obj.AddValue("counter", mEvCounter);
         obj.AddValue("player", PlayerStatus(uuid));
+        mStatusText.erase(uuid);
+
+        mEvents.Post(obj, tableId, mUsers.Size());
 
-        out.push_back(Reply(mUsers.GetAll(), obj));
+        if (event == "LeaveTable")
+        {
+            mResync.insert(uuid);
+        }
+        else if (event == "Quit")
+        {
+            mResync.erase(uuid);
+        }
+
+        if (!mTimer || (mEventWindow == 0U))
+        {
+            FlushEvents(out);
+        }
+        else if (!mFlushPending)
+        {
+            mFlushPending = true;
+            mTimer(mEventWindow, [this]() {
+                TimedLock lock(*this);
+                std::vector<Reply> events;
+
+                FlushEvents(events);
+                Send(events);
+                Publish(events);
+            });
+        }
     }
     else
     {
@@ -496,18 +1242,49 @@ void Lobby::SendPlayerEvent(std::uint32_t uuid, const std::string &event, std::v
     }
 }
 /*****************************************************************************/
-std::string Lobby::GetTableName(const std::uint32_t tableId)
+/**
+ * @brief Lobby::FlushEvents
+ *
+ * An event carries the last status of the player: a client that already has
+ * this status (e.g. in the list of AccessGranted) can apply it again.
+ * Called under the lock.
+ */
+void Lobby::FlushEvents(std::vector<Reply> &out)
 {
-    std::string name = "error_table_not_found";
+    std::vector<std::uint32_t> exclude;
 
-    // Forward it to the table PlayingTable
-    for (const auto &t : mTables)
+    // Back in the lobby: the list replaces the events missed around the table
+    for (auto uuid : mResync)
     {
-        if (t->GetId() == tableId)
+        if (mUsers.GetPlayerTable(uuid) == Protocol::LOBBY_UID)
         {
-            name = t->GetName();
+            exclude.push_back(uuid);
         }
     }
+    mResync.clear();
+
+    if (exclude.size() > 0U)
+    {
+        Reply reply(exclude, JsonObject());
+
+        reply.data.AddValue("cmd", "PlayerList");
+        PlayerPage(std::string(), Protocol::INVALID_UID, 0U, cPageSize, reply);
+        out.push_back(reply);
+    }
+
+    mEvents.Flush(mUsers, exclude, out);
+    mFlushPending = false;
+}
+/*****************************************************************************/
+std::string Lobby::GetTableName(const std::uint32_t tableId)
+{
+    std::string name = "error_table_not_found";
+
+    TableActorPtr actor = FindTable(tableId);
+    if (actor)
+    {
+        name = actor->GetName();
+    }
 
     return name;
 }
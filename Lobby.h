@@ -26,38 +26,59 @@
 #ifndef LOBBY_H
 #define LOBBY_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // Tarot files
 #include "Protocol.h"
 #include "PlayingTable.h"
+#include "TableActor.h"
+#include "TablePool.h"
+#include "LobbyEvents.h"
+#include "LobbyNotifier.h"
 #include "Users.h"
 #include "Network.h"
+#include "ILobbyGateway.h"
 
 // ICL files
 #include "Observer.h"
 
 /*****************************************************************************/
-class Peer
+class Lobby : public ILobbyGateway
 {
+
 public:
-  virtual ~Peer() {}
-  virtual void Deliver(const std::string &data) = 0;
-};
+    // Network lock statistics, to monitor the time spent by the gameplay under the lock
+    struct LockStats
+    {
+        std::uint64_t count;    ///< Number of times the lock has been held
+        std::uint64_t totalUs;  ///< Cumulated hold time, in microseconds
+        std::uint64_t maxUs;    ///< Longest hold time, in microseconds
+    };
 
-typedef std::shared_ptr<Peer> PeerPtr;
+    // Delayed execution of a function, to flush the lobby events
+    typedef std::function<void (std::uint32_t delayMs, std::function<void ()>)> Timer;
 
-/*****************************************************************************/
-class Lobby
-{
+    // Lobby command added by a service; tableId is the table of the player: LOBBY_UID if it is in the lobby,
+    // INVALID_UID if it is not logged in
+    typedef std::function<void (std::uint32_t uuid, std::uint32_t tableId, const JsonValue &json, std::vector<Reply> &out)> CommandHandler;
 
-public:
-    struct Security {
-        std::string webId;
-        std::string gek;
-        std::string passPhrase;
-    };
+    // Player event given to a service (eg: the player has left, its UUID will be given to another one)
+    typedef std::function<void (std::uint32_t uuid)> UserHandler;
+    // Same, with the replies to send to the player (eg: it has asked to join a table)
+    typedef std::function<void (std::uint32_t uuid, std::vector<Reply> &out)> UserReplyHandler;
+    typedef std::function<bool (std::uint32_t uuid)> UserFilter;
+
+    static const std::uint32_t cPageSize            = 50U;  ///< Default number of players in one page of the list
+    static const std::uint32_t cMaxPageSize         = 500U;
+    static const std::uint32_t cTablePageSize       = 20U;  ///< Default number of tables in one page of the list
+    static const std::uint32_t cMaxTablePageSize    = 100U;
 
     static const std::uint32_t cErrorFull           = 0U;
     static const std::uint32_t cErrorNickNameUsed   = 1U;
@@ -66,51 +87,62 @@ public:
     Lobby(bool adminMode = false);
     ~Lobby();
 
+    void SetExecutor(const TableActor::Executor &executor) { mExecutor = executor; } // Call before any table creation
+    void SetCapacity(std::uint32_t maxUsers, std::uint32_t maxTables); // Call before any user or table creation
+    void SetShard(std::uint32_t index, std::uint32_t count); // After SetCapacity(): only the tables of this shard are created here
+    static void GetIdSpaces(std::uint32_t &maxUsers, std::uint32_t &maxTables, UniqueId &tableIds, UniqueId &userIds);
+    static bool GetShardTables(std::uint32_t maxTables, std::uint32_t index, std::uint32_t count, std::uint32_t &first, std::uint32_t &last);
+    void GetTableRange(std::uint32_t &first, std::uint32_t &last);
+    void SetEventWindow(std::uint32_t delayMs, const Timer &timer); // Lobby events are grouped during delayMs, 0 to send them at once
+    void SetTablePool(std::uint32_t size); // Destroyed tables kept for the next ones, 'size' of them created now
+    void SetResumeTimeout(std::uint32_t seconds) { mResumeTimeout = seconds; } // Call before any table creation
     void Initialize(const std::string &name, const std::vector<std::string> &tables);
     std::string GetName() { return mName; }
-    void RegisterListener(Observer<JsonValue> &obs);
+    void RegisterListener(Observer<JsonValue> &obs, LobbyNotifier::Policy policy = LobbyNotifier::DROP);
+    void SetCommandHandler(const std::string &cmd, const CommandHandler &handler);
+    void SetUserRemovedHandler(const std::string &service, const UserHandler &handler);
+    void SetUserJoinedHandler(const std::string &service, const UserReplyHandler &handler);
+    void Subscribe(const std::string &name, const LobbyNotifier::Handler &handler, LobbyNotifier::Policy policy = LobbyNotifier::DROP,
+                   std::uint32_t capacity = LobbyNotifier::cDefaultCapacity);
+    std::vector<LobbyNotifier::Stats> GetListenerStats();
 
     // Users management
     std::uint32_t GetNumberOfPlayers();
+    std::uint32_t GetNumberOfPlayers(std::uint32_t tableId);
+    std::uint32_t GetPlayerTable(std::uint32_t uuid);
+    std::vector<std::uint32_t> SeatPlayers(std::uint32_t tableId, const std::vector<std::uint32_t> &uuids, const UserFilter &accept = UserFilter());
     std::uint32_t GetNumberOfTables();
     void RemoveAllUsers();
+    LockStats GetLockStats() const;
+    LobbyEventBus::Stats GetEventStats();
+    std::vector<TableActor::Stats> GetTableStats();
+    TablePool::Stats GetTablePoolStats() { return mTablePool->GetStats(); }
+    std::vector<Peer::Stats> GetPeerStats();
 
     // Tables management
-    std::uint32_t CreateTable(const std::string &tableName, const Tarot::Game &game = Tarot::Game());
+    std::uint32_t CreateTable(const std::string &tableName, const Tarot::Game &game = Tarot::Game(), std::uint8_t nbPlayers = 4U);
+    void ReserveTable(std::uint32_t tableId);
+    void ReleaseTable(std::uint32_t tableId);
     bool DestroyTable(std::uint32_t id);
     void DeleteTables();
 
-    bool Deliver(const Request &req);
-    std::uint32_t AddUser(PeerPtr peer);
-    void RemoveUser(std::uint32_t uuid);
+    // From ILobbyGateway
+    bool Deliver(const Request &req) override;
+    std::uint32_t AddUser(PeerPtr peer) override;
+    void RemoveUser(std::uint32_t uuid) override;
 
+    CredentialStore &GetCredentials() override { return mAllowedClients; }
 
-    void AddAllowedClient(const std::string &webId, const std::string &gek, const std::string &passPhrase)
-    {
-        std::scoped_lock<std::mutex> lock(mNetMutex);
-        Security sec;
-        sec.webId = webId;
-        sec.gek = gek;
-        sec.passPhrase = passPhrase;
-        mAllowedClients[webId] = sec;
-    }
-
-    bool GetSecurity(const std::string &playerId, Security &sec)
-    {
-        std::scoped_lock<std::mutex> lock(mNetMutex);
-        bool success = false;
-        if (mAllowedClients.count(playerId) > 0)
-        {
-            TLogNetwork("Found webId");
-            sec = mAllowedClients[playerId];
-            success = true;
-        }
-        return success;
-    }
+    std::uint32_t AddUser(PeerPtr peer, std::uint32_t uuid); // UUID given by a lobby front-end (shard)
 
 private:
     bool mInitialized;
-    std::vector<std::unique_ptr<PlayingTable>> mTables;
+    std::vector<TableActorPtr> mTables; ///< Table directory, indexed by tableId - TABLES_UID (null if free)
+    std::uint32_t mNbTables;
+    std::vector<std::string> mTableList; ///< Serialized tables, built again only when a table is created or destroyed
+    bool mTableListValid;
+    TableActor::Executor mExecutor;
+    TablePoolPtr mTablePool;            ///< Destroyed tables, reset and ready to be used again
     UniqueId    mTableIds;
     UniqueId    mUserIds;
 
@@ -118,20 +150,55 @@ private:
     std::string mName;
     bool mAdminMode;
     std::uint32_t mEvCounter;
-    Subject<JsonValue> mSubject;
+    LobbyEventBus mEvents;
+    std::uint32_t mEventWindow;
+    std::uint32_t mResumeTimeout;   ///< Seconds a seat is kept for a player disconnected during a game
+    Timer mTimer;
+    bool mFlushPending;
+    std::unordered_map<std::uint32_t, std::string> mStatusText; // Cache of the serialized player status
+    std::unordered_set<std::uint32_t> mResync; // Players back in the lobby during the window, they need the list of players
+    std::unordered_set<std::uint32_t> mReservedTables; // Tables filled by a service, RequestJoinTable only resumes a seat there
+    std::map<std::string, CommandHandler> mCommands;
+    std::map<std::string, UserHandler> mUserRemoved;
+    std::map<std::string, UserReplyHandler> mUserJoined;
+    LobbyNotifier mNotifier; // Listeners of all the messages, served by their own threads
     std::mutex  mNetMutex;
+    std::atomic<std::uint64_t> mLockCount{0U};
+    std::atomic<std::uint64_t> mLockTotalUs{0U};
+    std::atomic<std::uint64_t> mLockMaxUs{0U};
 
     std::map<std::uint32_t, PeerPtr> mPeers; // uuid <--> GameSession
 
-    // key = playerId
-    std::map<std::string, Security> mAllowedClients; // allowed peers on this server
+    CredentialStore mAllowedClients; // allowed peers on this server, not protected by mNetMutex
 
     std::string GetTableName(const std::uint32_t tableId);
-    void RemovePlayerFromTable(std::uint32_t uuid, std::uint32_t tableId, std::vector<Reply> &out);
+    TableActorPtr FindTable(std::uint32_t tableId);
+    std::uint32_t TablePage(std::uint32_t page, std::uint32_t pageSize, std::string &tables);
+    void JoinTable(PlayingTable &table, std::uint32_t uuid, const std::string &token, std::uint32_t lastSeq, bool resumeOnly);
+    void SendTableReplies(std::vector<Reply> &out);
+    void RemovePlayerFromTable(std::uint32_t uuid, std::uint32_t tableId, bool keepSeat, std::vector<Reply> &out);
     void Error(std::uint32_t error, std::uint32_t dest_uuid, std::vector<Reply> &out);
     JsonObject PlayerStatus(std::uint32_t uuid);
-    void SendPlayerEvent(std::uint32_t uuid, const std::string &event, std::vector<Reply> &out);
+    const std::string &PlayerStatusText(std::uint32_t uuid);
+    void PlayerPage(const std::string &prefix, std::uint32_t tableId, std::uint32_t page, std::uint32_t pageSize, Reply &reply);
+    void SendPlayerEvent(std::uint32_t uuid, const std::string &event, std::uint32_t tableId, std::vector<Reply> &out);
+    void FlushEvents(std::vector<Reply> &out);
     void Send(const std::vector<Reply> &out);
+    void Publish(std::vector<Reply> &out);
+    static std::uint32_t MessageKey(const JsonObject &data);
+    void AddLockTime(std::uint64_t us);
+
+    // Keep the network lock for the scope, its hold time is added to the statistics
+    class TimedLock
+    {
+    public:
+        explicit TimedLock(Lobby &lobby);
+        ~TimedLock();
+    private:
+        Lobby &mLobby;
+        std::scoped_lock<std::mutex> mLock;
+        std::chrono::steady_clock::time_point mStart;
+    };
 };
 
 #endif // LOBBY_H
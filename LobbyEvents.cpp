@@ -0,0 +1,187 @@
+/*=============================================================================
+ * TarotClub - LobbyEvents.cpp
+ *=============================================================================
+ * Coalesced distribution of the lobby events (players arrival, departure...)
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <algorithm>
+#include <map>
+#include "LobbyEvents.h"
+
+/*****************************************************************************/
+LobbyEventBus::LobbyEventBus()
+    : mStats()
+{
+
+}
+/*****************************************************************************/
+void LobbyEventBus::Clear()
+{
+    mEvents.clear();
+    mLast.clear();
+}
+/*****************************************************************************/
+void LobbyEventBus::Post(const JsonObject &event, std::uint32_t tableId, std::uint32_t nbUsers)
+{
+    std::uint32_t uuid = static_cast<std::uint32_t>(event.GetValue("player:uuid").GetInteger());
+    std::string type = event.GetValue("type").GetString();
+    std::uint32_t size = static_cast<std::uint32_t>(event.ToString().size());
+
+    mStats.produced++;
+    mStats.bytesBroadcast += static_cast<std::uint64_t>(size) * nbUsers;
+
+    auto it = mLast.find(uuid);
+    // After a "Quit", the uuid can be given to a new user: the events are kept apart
+    if ((it != mLast.end()) && (mEvents[it->second].type != "Quit"))
+    {
+        Pending &p = mEvents[it->second];
+
+        mStats.merged++;
+        if ((p.type == "New") && (type == "Quit"))
+        {
+            // The other players never knew this one
+            mStats.merged++;
+            p.valid = false;
+            mLast.erase(it);
+        }
+        else
+        {
+            p.event = event;
+            p.size = size;
+            if ((p.type == "New") && (type != "New"))
+            {
+                p.event.AddValue("type", p.type);
+                p.size = static_cast<std::uint32_t>(p.event.ToString().size());
+            }
+            else
+            {
+                p.type = type;
+            }
+            if (std::find(p.tables.begin(), p.tables.end(), tableId) == p.tables.end())
+            {
+                p.tables.push_back(tableId);
+            }
+        }
+    }
+    else
+    {
+        Pending p;
+        p.uuid = uuid;
+        p.type = type;
+        p.event = event;
+        p.tables.push_back(tableId);
+        p.size = size;
+        p.valid = true;
+
+        mLast[uuid] = mEvents.size();
+        mEvents.push_back(p);
+    }
+}
+/*****************************************************************************/
+void LobbyEventBus::Flush(const Users &users, const std::vector<std::uint32_t> &exclude, std::vector<Reply> &out)
+{
+    std::vector<std::size_t> all;
+    std::map<std::uint32_t, std::vector<std::size_t>> tables;
+
+    for (std::size_t i = 0U; i < mEvents.size(); i++)
+    {
+        if (mEvents[i].valid)
+        {
+            all.push_back(i);
+            for (auto t : mEvents[i].tables)
+            {
+                if (t != Protocol::LOBBY_UID)
+                {
+                    tables[t].push_back(i);
+                }
+            }
+        }
+    }
+
+    if (all.size() > 0U)
+    {
+        const std::vector<std::uint32_t> &lobby = users.GetTablePlayerIds(Protocol::LOBBY_UID);
+        if (exclude.empty())
+        {
+            Send(all, lobby, out);
+        }
+        else
+        {
+            std::vector<std::uint32_t> dest;
+            for (auto uuid : lobby)
+            {
+                if (std::find(exclude.begin(), exclude.end(), uuid) == exclude.end())
+                {
+                    dest.push_back(uuid);
+                }
+            }
+            Send(all, dest, out);
+        }
+
+        for (const auto &t : tables)
+        {
+            Send(t.second, users.GetTablePlayerIds(t.first), out);
+        }
+    }
+    Clear();
+}
+/*****************************************************************************/
+void LobbyEventBus::Send(const std::vector<std::size_t> &events, const std::vector<std::uint32_t> &dest, std::vector<Reply> &out)
+{
+    if (dest.empty())
+    {
+        return;
+    }
+
+    std::uint64_t size;
+    if (events.size() == 1U)
+    {
+        out.push_back(Reply(dest, mEvents[events[0]].event));
+        size = mEvents[events[0]].size;
+    }
+    else
+    {
+        JsonObject batch;
+        JsonArray array;
+
+        // {"cmd":"LobbyEvents","events":[]}
+        size = 33U;
+        for (auto i : events)
+        {
+            array.AddValue(mEvents[i].event);
+            size += mEvents[i].size + 1U;
+        }
+        size--;
+
+        batch.AddValue("cmd", "LobbyEvents");
+        batch.AddValue("events", array);
+        out.push_back(Reply(dest, batch));
+    }
+
+    mStats.sent += static_cast<std::uint64_t>(events.size()) * dest.size();
+    mStats.messages += dest.size();
+    mStats.bytesSent += size * dest.size();
+}
+
+//=============================================================================
+// End of file LobbyEvents.cpp
+//=============================================================================
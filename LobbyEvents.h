@@ -0,0 +1,116 @@
+/*=============================================================================
+ * TarotClub - LobbyEvents.h
+ *=============================================================================
+ * Coalesced distribution of the lobby events (players arrival, departure...)
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef LOBBY_EVENTS_H
+#define LOBBY_EVENTS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Tarot files
+#include "Network.h"
+#include "Users.h"
+
+/*****************************************************************************/
+/**
+ * @brief The LobbyEventBus class
+ *
+ * Keeps the lobby events of a time window and sends them in one message per
+ * group of recipients:
+ *   - the players in the lobby get all the events,
+ *   - the players around a table only get the events of this table.
+ *
+ * The events of one player are merged: only its last status is sent, a "New"
+ * stays a "New", and a "New" followed by a "Quit" cancels both. The type is
+ * the one of the last event, so the clients apply the whole status of the
+ * player (nickname and location) whatever the type, except "Quit".
+ *
+ * One event alone is sent as is ("LobbyEvent"), several events are grouped:
+ *   {"cmd":"LobbyEvents","events":[ {LobbyEvent}, ... ]}
+ *
+ * Not thread safe, used under the lobby lock.
+ */
+class LobbyEventBus
+{
+public:
+    struct Stats
+    {
+        std::uint64_t produced;         ///< Events generated by the lobby
+        std::uint64_t merged;           ///< Events replaced by a newer one of the same player, or cancelled
+        std::uint64_t sent;             ///< Events delivered, counted once per recipient
+        std::uint64_t messages;         ///< Messages delivered, counted once per recipient
+        std::uint64_t bytesBroadcast;   ///< Bytes of one broadcast per event to all the users
+        std::uint64_t bytesSent;        ///< Bytes really sent
+
+        std::uint64_t BytesSaved() const { return (bytesBroadcast > bytesSent) ? (bytesBroadcast - bytesSent) : 0U; }
+    };
+
+    LobbyEventBus();
+
+    /**
+     * @brief Post
+     * @param event LobbyEvent message, with the current status of the player
+     * @param tableId Table concerned by the event (LOBBY_UID if none)
+     * @param nbUsers Number of users, for the statistics
+     */
+    void Post(const JsonObject &event, std::uint32_t tableId, std::uint32_t nbUsers);
+
+    /**
+     * @brief Flush
+     * @param users Recipients, according to their current location
+     * @param exclude Players that must not receive the lobby events (their list of players is already up to date)
+     * @param out
+     */
+    void Flush(const Users &users, const std::vector<std::uint32_t> &exclude, std::vector<Reply> &out);
+
+    bool IsEmpty() const { return mEvents.empty(); }
+    void Clear();
+    Stats GetStats() const { return mStats; }
+
+private:
+    struct Pending
+    {
+        std::uint32_t uuid;
+        std::string type;
+        JsonObject event;
+        std::vector<std::uint32_t> tables;  ///< Tables concerned, the event is sent to their players
+        std::uint32_t size;                 ///< Serialized size
+        bool valid;                         ///< False if cancelled
+    };
+
+    std::vector<Pending> mEvents;                           ///< In the order of arrival
+    std::unordered_map<std::uint32_t, std::size_t> mLast;   ///< uuid --> index of its last event
+    Stats mStats;
+
+    void Send(const std::vector<std::size_t> &events, const std::vector<std::uint32_t> &dest, std::vector<Reply> &out);
+};
+
+#endif // LOBBY_EVENTS_H
+
+//=============================================================================
+// End of file LobbyEvents.h
+//=============================================================================
@@ -0,0 +1,194 @@
+/*=============================================================================
+ * TarotClub - LobbyNotifier.cpp
+ *=============================================================================
+ * Asynchronous delivery of the lobby traffic to the listeners
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include "LobbyNotifier.h"
+
+/*****************************************************************************/
+LobbyNotifier::LobbyNotifier()
+{
+
+}
+/*****************************************************************************/
+LobbyNotifier::~LobbyNotifier()
+{
+    Stop();
+}
+/*****************************************************************************/
+void LobbyNotifier::Subscribe(const std::string &name, const Handler &handler, Policy policy, std::uint32_t capacity)
+{
+    mSubscribers.push_back(std::make_unique<Subscriber>(name, handler, policy, capacity));
+}
+/*****************************************************************************/
+void LobbyNotifier::Publish(const LobbyNotificationPtr &notification)
+{
+    for (auto &s : mSubscribers)
+    {
+        s->Push(notification);
+    }
+}
+/*****************************************************************************/
+void LobbyNotifier::Stop()
+{
+    for (auto &s : mSubscribers)
+    {
+        s->Stop();
+    }
+}
+/*****************************************************************************/
+std::vector<LobbyNotifier::Stats> LobbyNotifier::GetStats() const
+{
+    std::vector<Stats> stats;
+
+    for (auto &s : mSubscribers)
+    {
+        stats.push_back(s->GetStats());
+    }
+    return stats;
+}
+/*****************************************************************************/
+LobbyNotifier::Subscriber::Subscriber(const std::string &name, const Handler &handler, Policy policy, std::uint32_t capacity)
+    : mName(name)
+    , mHandler(handler)
+    , mPolicy(policy)
+    , mQueue(capacity)
+    , mSleeping(false)
+    , mStop(false)
+    , mPublished(0U)
+    , mDelivered(0U)
+    , mDropped(0U)
+    , mWaits(0U)
+{
+    mThread = std::thread(&Subscriber::Run, this);
+}
+/*****************************************************************************/
+void LobbyNotifier::Subscriber::Push(const LobbyNotificationPtr &notification)
+{
+    mPublished.fetch_add(1U, std::memory_order_relaxed);
+
+    bool pushed = mQueue.TryPush(notification);
+    if (!pushed && (mPolicy == BLOCK))
+    {
+        mWaits.fetch_add(1U, std::memory_order_relaxed);
+        // The listener is running (the queue is full), give it some time
+        while (!pushed && !mStop.load(std::memory_order_relaxed))
+        {
+            std::this_thread::yield();
+            pushed = mQueue.TryPush(notification);
+        }
+    }
+
+    if (pushed)
+    {
+        // Pairs with the fence of Run(): either the listener sees the notification
+        // before going to sleep, or we see it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mSleeping.load(std::memory_order_relaxed))
+        {
+            WakeUp();
+        }
+    }
+    else
+    {
+        mDropped.fetch_add(1U, std::memory_order_relaxed);
+    }
+}
+/*****************************************************************************/
+void LobbyNotifier::Subscriber::WakeUp()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSleeping.store(false, std::memory_order_relaxed);
+    mCondVar.notify_one();
+}
+/*****************************************************************************/
+void LobbyNotifier::Subscriber::Run()
+{
+    LobbyNotificationPtr notification;
+
+    for (;;)
+    {
+        if (mQueue.TryPop(notification))
+        {
+            mHandler(*notification);
+            notification.reset();
+            mDelivered.fetch_add(1U, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (mStop.load(std::memory_order_acquire))
+        {
+            // Everything published before Stop() has been delivered
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mQueue.TryPop(notification))
+        {
+            mSleeping.store(false, std::memory_order_relaxed);
+            lock.unlock();
+            mHandler(*notification);
+            notification.reset();
+            mDelivered.fetch_add(1U, std::memory_order_relaxed);
+        }
+        else
+        {
+            mCondVar.wait(lock, [this]() {
+                return !mSleeping.load(std::memory_order_relaxed) || mStop.load(std::memory_order_relaxed);
+            });
+            mSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+/*****************************************************************************/
+void LobbyNotifier::Subscriber::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop.store(true, std::memory_order_release);
+        mCondVar.notify_one();
+    }
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
+}
+/*****************************************************************************/
+LobbyNotifier::Stats LobbyNotifier::Subscriber::GetStats() const
+{
+    Stats stats;
+
+    stats.name = mName;
+    stats.published = mPublished.load(std::memory_order_relaxed);
+    stats.delivered = mDelivered.load(std::memory_order_relaxed);
+    stats.dropped = mDropped.load(std::memory_order_relaxed);
+    stats.waits = mWaits.load(std::memory_order_relaxed);
+    stats.capacity = mQueue.Capacity();
+    return stats;
+}
+
+//=============================================================================
+// End of file LobbyNotifier.cpp
+//=============================================================================
@@ -0,0 +1,165 @@
+/*=============================================================================
+ * TarotClub - LobbyNotifier.h
+ *=============================================================================
+ * Asynchronous delivery of the lobby traffic to the listeners
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef LOBBY_NOTIFIER_H
+#define LOBBY_NOTIFIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tarot files
+#include "JsonValue.h"
+#include "LockFreeQueue.h"
+
+/*****************************************************************************/
+/**
+ * @brief One message seen by the lobby
+ *
+ * Shared between all the listeners and never modified once published.
+ */
+struct LobbyNotification
+{
+    enum Direction
+    {
+        INBOUND,    ///< Received from a player
+        OUTBOUND    ///< Sent by the lobby or by a table
+    };
+
+    Direction direction;
+    std::uint32_t src;                  ///< Inbound: sender, outbound: INVALID_UID
+    std::vector<std::uint32_t> dest;    ///< Inbound: lobby or table, outbound: recipients
+    JsonValue data;
+
+    LobbyNotification()
+        : direction(INBOUND)
+        , src(0U)
+    {
+
+    }
+
+    // The reply is moved, not copied
+    LobbyNotification(Direction d, std::uint32_t s, std::vector<std::uint32_t> &&to, JsonObject &&obj)
+        : direction(d)
+        , src(s)
+        , dest(std::move(to))
+        , data(std::move(obj))
+    {
+
+    }
+};
+
+typedef std::shared_ptr<const LobbyNotification> LobbyNotificationPtr;
+
+/*****************************************************************************/
+/**
+ * @brief The LobbyNotifier class
+ *
+ * Each listener has its own bounded queue and its own thread: publishing is
+ * one enqueue per listener, the listener works outside of the lobby lock and
+ * a slow one only delays itself.
+ *
+ * When the queue of a listener is full:
+ *   - DROP: the notification is lost for this listener (counted),
+ *   - BLOCK: the publisher waits for a free place (backpressure on the lobby).
+ *
+ * Subscribe() and Publish() are serialized by the caller (lobby lock).
+ */
+class LobbyNotifier
+{
+public:
+    enum Policy
+    {
+        DROP,
+        BLOCK
+    };
+
+    struct Stats
+    {
+        std::string name;
+        std::uint64_t published;
+        std::uint64_t delivered;
+        std::uint64_t dropped;
+        std::uint64_t waits;    ///< Publications that waited for a free place (BLOCK)
+        std::uint32_t capacity;
+    };
+
+    typedef std::function<void (const LobbyNotification &)> Handler;
+
+    static const std::uint32_t cDefaultCapacity = 4096U;
+
+    LobbyNotifier();
+    ~LobbyNotifier();
+
+    void Subscribe(const std::string &name, const Handler &handler, Policy policy = DROP, std::uint32_t capacity = cDefaultCapacity);
+    bool HasSubscribers() const { return !mSubscribers.empty(); }
+    void Publish(const LobbyNotificationPtr &notification);
+    void Stop(); ///< Delivers the pending notifications and stops the threads
+    std::vector<Stats> GetStats() const;
+
+private:
+    class Subscriber
+    {
+    public:
+        Subscriber(const std::string &name, const Handler &handler, Policy policy, std::uint32_t capacity);
+
+        void Push(const LobbyNotificationPtr &notification);
+        void Stop();
+        Stats GetStats() const;
+
+    private:
+        std::string mName;
+        Handler mHandler;
+        Policy mPolicy;
+        LockFreeQueue<LobbyNotificationPtr> mQueue;
+        std::atomic<bool> mSleeping;
+        std::atomic<bool> mStop;
+        std::mutex mMutex;  ///< Only to sleep when the queue is empty
+        std::condition_variable mCondVar;
+        std::thread mThread;
+
+        std::atomic<std::uint64_t> mPublished;
+        std::atomic<std::uint64_t> mDelivered;
+        std::atomic<std::uint64_t> mDropped;
+        std::atomic<std::uint64_t> mWaits;
+
+        void Run();
+        void WakeUp();
+    };
+
+    std::vector<std::unique_ptr<Subscriber>> mSubscribers;
+};
+
+#endif // LOBBY_NOTIFIER_H
+
+//=============================================================================
+// End of file LobbyNotifier.h
+//=============================================================================
@@ -0,0 +1,140 @@
+/**
+ * MIT License
+ * Copyright (c) 2019 Anthony Rabine
+ */
+
+#ifndef LOCK_FREE_QUEUE_H
+#define LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*****************************************************************************/
+/**
+ * @brief The LockFreeQueue class
+ *
+ * Bounded queue without lock, any number of producers and consumers.
+ * Each cell holds a sequence number telling if it is ready to be written
+ * (sequence == position) or read (sequence == position + 1); a thread
+ * reserves a position with a compare-and-swap and never waits for another.
+ *
+ * The capacity is rounded up to a power of two.
+ */
+template<typename Data>
+class LockFreeQueue
+{
+
+public:
+    explicit LockFreeQueue(std::uint32_t capacity)
+        : mCells(RoundUp(capacity))
+        , mMask(static_cast<std::uint32_t>(mCells.size()) - 1U)
+        , mWritePos(0U)
+        , mReadPos(0U)
+    {
+        for (std::uint32_t i = 0U; i < mCells.size(); i++)
+        {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false if the queue is full
+    bool TryPush(const Data &data)
+    {
+        Cell *cell;
+        std::uint32_t pos = mWritePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            std::uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::int32_t diff = static_cast<std::int32_t>(seq - pos);
+            if (diff == 0)
+            {
+                if (mWritePos.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = mWritePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = data;
+        cell->sequence.store(pos + 1U, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool TryPop(Data &popped_value)
+    {
+        Cell *cell;
+        std::uint32_t pos = mReadPos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            std::uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::int32_t diff = static_cast<std::int32_t>(seq - (pos + 1U));
+            if (diff == 0)
+            {
+                if (mReadPos.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = mReadPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        popped_value = std::move(cell->data);
+        cell->data = Data();
+        cell->sequence.store(pos + mMask + 1U, std::memory_order_release);
+        return true;
+    }
+
+    std::uint32_t Capacity() const { return mMask + 1U; }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::uint32_t> sequence;
+        Data data;
+
+        Cell() : sequence(0U), data() {}
+    };
+
+    std::vector<Cell> mCells;
+    const std::uint32_t mMask;
+    // Separate cache lines: producers and consumers do not slow each other
+    alignas(64) std::atomic<std::uint32_t> mWritePos;
+    alignas(64) std::atomic<std::uint32_t> mReadPos;
+
+    static std::size_t RoundUp(std::uint32_t capacity)
+    {
+        std::size_t size = 2U;
+        while (size < capacity)
+        {
+            size *= 2U;
+        }
+        return size;
+    }
+};
+
+#endif // LOCK_FREE_QUEUE_H
+
+//=============================================================================
+// End of file LockFreeQueue.h
+//=============================================================================
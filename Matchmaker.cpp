@@ -0,0 +1,664 @@
+/*=============================================================================
+ * TarotClub - Matchmaker.cpp
+ *=============================================================================
+ * Automatic matchmaking: waiting queues that fill tables on demand
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include "Matchmaker.h"
+#include "Log.h"
+
+namespace {
+
+// Credentials of the bots
+std::string RandomString(std::uint32_t size)
+{
+    static const char cChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    static std::mt19937 generator(std::random_device{}());
+    std::uniform_int_distribution<std::uint32_t> distribution(0U, sizeof(cChars) - 2U);
+
+    std::string str;
+    for (std::uint32_t i = 0U; i < size; i++)
+    {
+        str.push_back(cChars[distribution(generator)]);
+    }
+    return str;
+}
+
+std::uint64_t Elapsed(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point now)
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - since).count());
+}
+
+} // namespace
+
+/*****************************************************************************/
+Matchmaker::Matchmaker()
+    : mRunning(false)
+    , mWakeUp(false)
+    , mTablesCreated(0U)
+    , mPoolHits(0U)
+    , mPoolMisses(0U)
+    , mBotsAdded(0U)
+    , mActiveTables(0U)
+    , mNextAccount(0U)
+{
+
+}
+/*****************************************************************************/
+Matchmaker::~Matchmaker()
+{
+    Stop();
+}
+/*****************************************************************************/
+std::string Matchmaker::GetName()
+{
+    return "Matchmaker";
+}
+/*****************************************************************************/
+void Matchmaker::Initialize(std::shared_ptr<IServer> server, std::shared_ptr<Lobby> lobby)
+{
+    mServer = server;
+    mLobby = lobby;
+}
+/*****************************************************************************/
+/**
+ * @brief Matchmaker::Start
+ *
+ * Adds the lobby commands, prepares the tables of the default queue (four
+ * players, quick deal) then starts the matching thread.
+ *
+ * @return false if not attached to a server or already running
+ */
+bool Matchmaker::Start(const Options &options)
+{
+    if (!mServer || !mLobby || mRunning)
+    {
+        return false;
+    }
+
+    mOptions = options;
+    mOptions.tick = std::max(mOptions.tick, 1U);
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mQueues[QueueKey(4U, Tarot::Game::cQuickDeal)];
+        mRunning = true;
+    }
+    FillPool();
+
+    mLobby->SetCommandHandler("RequestMatch", [this](std::uint32_t uuid, std::uint32_t tableId, const JsonValue &json, std::vector<Reply> &out) {
+        RequestMatch(uuid, tableId, json, out);
+    });
+    mLobby->SetCommandHandler("CancelMatch", [this](std::uint32_t uuid, std::uint32_t tableId, const JsonValue &json, std::vector<Reply> &out) {
+        (void) tableId;
+        (void) json;
+        CancelMatch(uuid, out);
+    });
+    mLobby->SetUserRemovedHandler(GetName(), [this](std::uint32_t uuid) {
+        RemoveUser(uuid);
+    });
+    // A queued player who joins a table by itself leaves the queues
+    mLobby->SetUserJoinedHandler(GetName(), [this](std::uint32_t uuid, std::vector<Reply> &out) {
+        if (RemoveUser(uuid))
+        {
+            JsonObject reply;
+            reply.AddValue("cmd", "ReplyMatch");
+            reply.AddValue("status", "cancelled");
+            out.push_back(Reply(uuid, reply));
+        }
+    });
+
+    mThread = std::thread(&Matchmaker::Run, this);
+    TLogInfo("[MATCHMAKER] Started");
+    return true;
+}
+/*****************************************************************************/
+/**
+ * @brief Matchmaker::Stop
+ *
+ * The tables in use stay in the lobby (open to everybody), the bots leave.
+ */
+void Matchmaker::Stop()
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mRunning)
+        {
+            return;
+        }
+        mRunning = false;
+        mCondVar.notify_one();
+    }
+
+    mLobby->SetCommandHandler("RequestMatch", Lobby::CommandHandler());
+    mLobby->SetCommandHandler("CancelMatch", Lobby::CommandHandler());
+    mLobby->SetUserRemovedHandler(GetName(), Lobby::UserHandler());
+    mLobby->SetUserJoinedHandler(GetName(), Lobby::UserReplyHandler());
+    mThread.join();
+
+    mBots.KillBots();
+    for (auto &pool : mPool)
+    {
+        for (auto id : pool.second)
+        {
+            mLobby->DestroyTable(id);
+        }
+    }
+    mPool.clear();
+    for (auto &m : mMatches)
+    {
+        mLobby->ReleaseTable(m.tableId);
+    }
+    mMatches.clear();
+
+    std::scoped_lock<std::mutex> lock(mMutex);
+    mQueues.clear();
+    mInFlight.clear();
+    mActiveTables = 0U;
+}
+/*****************************************************************************/
+// Called under the lobby lock
+void Matchmaker::RequestMatch(std::uint32_t uuid, std::uint32_t tableId, const JsonValue &json, std::vector<Reply> &out)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    JsonObject reply;
+    Tarot::Game game;
+    std::uint32_t nbPlayers = 4U;
+
+    if (json.HasValue("players"))
+    {
+        nbPlayers = json.FindValue("players").GetInteger();
+    }
+    if (json.HasValue("mode"))
+    {
+        game.Set(json.FindValue("mode").GetString());
+    }
+
+    reply.AddValue("cmd", "ReplyMatch");
+    reply.AddValue("players", nbPlayers);
+    reply.AddValue("mode", game.Get());
+
+    // The custom games need their deals, they are played at the tables of the lobby.
+    // A player already at a table could not be seated
+    if ((nbPlayers < 3U) || (nbPlayers > 5U) || (game.mode == Tarot::Game::cCustom) || IsQueued(uuid) ||
+        (tableId != Protocol::LOBBY_UID))
+    {
+        reply.AddValue("status", "error");
+    }
+    else
+    {
+        Queue &queue = mQueues[QueueKey(nbPlayers, game.mode)];
+        queue.players.push_back(Waiting{uuid, std::chrono::steady_clock::now()});
+
+        reply.AddValue("status", "queued");
+        reply.AddValue("position", static_cast<std::uint32_t>(queue.players.size()));
+
+        if (queue.players.size() >= nbPlayers)
+        {
+            // Do not wait for the next tick
+            mWakeUp = true;
+            mCondVar.notify_one();
+        }
+    }
+    out.push_back(Reply(uuid, reply));
+}
+/*****************************************************************************/
+// Called under the lobby lock
+void Matchmaker::CancelMatch(std::uint32_t uuid, std::vector<Reply> &out)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    JsonObject reply;
+
+    reply.AddValue("cmd", "ReplyMatch");
+    reply.AddValue("status", "error");
+    for (auto &q : mQueues)
+    {
+        auto it = std::find_if(q.second.players.begin(), q.second.players.end(), [uuid](const Waiting &w) { return w.uuid == uuid; });
+        if (it != q.second.players.end())
+        {
+            q.second.players.erase(it);
+            q.second.cancelled++;
+            reply.ReplaceValue("status", "cancelled");
+            break;
+        }
+    }
+    out.push_back(Reply(uuid, reply));
+}
+/*****************************************************************************/
+bool Matchmaker::IsQueued(std::uint32_t uuid) const
+{
+    if (mInFlight.count(uuid) > 0U)
+    {
+        return true;
+    }
+    for (const auto &q : mQueues)
+    {
+        for (const auto &w : q.second.players)
+        {
+            if (w.uuid == uuid)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+/*****************************************************************************/
+/**
+ * @brief Matchmaker::RemoveUser
+ *
+ * Called under the lobby lock when a player leaves: its UUID can be given to
+ * a new player, who must not inherit its place in the queue nor its seat.
+ * Also called when a player joins a table by itself.
+ *
+ * @return true if the player was waiting for a match
+ */
+bool Matchmaker::RemoveUser(std::uint32_t uuid)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+
+    bool removed = (mInFlight.erase(uuid) > 0U);
+    for (auto &q : mQueues)
+    {
+        auto it = std::find_if(q.second.players.begin(), q.second.players.end(), [uuid](const Waiting &w) { return w.uuid == uuid; });
+        if (it != q.second.players.end())
+        {
+            q.second.players.erase(it);
+            q.second.cancelled++;
+            removed = true;
+            break;
+        }
+    }
+    return removed;
+}
+/*****************************************************************************/
+void Matchmaker::Run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (mRunning)
+    {
+        mCondVar.wait_for(lock, std::chrono::milliseconds(mOptions.tick), [this]() { return mWakeUp || !mRunning; });
+        mWakeUp = false;
+        if (mRunning)
+        {
+            // The lobby is called without our lock: its commands take it
+            lock.unlock();
+            Tick();
+            lock.lock();
+        }
+    }
+}
+/*****************************************************************************/
+void Matchmaker::Tick()
+{
+    struct Plan
+    {
+        QueueKey key;
+        Match *match;   ///< nullptr for a new table
+        std::vector<Waiting> players;
+    };
+
+    auto now = std::chrono::steady_clock::now();
+    std::vector<Plan> plans;
+
+    // Players taken from the queues, seated afterwards
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        for (auto &q : mQueues)
+        {
+            std::deque<Waiting> &players = q.second.players;
+            std::uint32_t nbPlayers = q.first.first;
+
+            // First the seats of the players who left before being seated
+            for (auto &m : mMatches)
+            {
+                if ((m.key == q.first) && !m.closing && (m.freeSeats > 0U) && !players.empty())
+                {
+                    std::size_t n = std::min<std::size_t>(m.freeSeats, players.size());
+                    plans.push_back(Plan{q.first, &m, std::vector<Waiting>(players.begin(), players.begin() + n)});
+                    players.erase(players.begin(), players.begin() + n);
+                }
+            }
+
+            while (players.size() >= nbPlayers)
+            {
+                plans.push_back(Plan{q.first, nullptr, std::vector<Waiting>(players.begin(), players.begin() + nbPlayers)});
+                players.erase(players.begin(), players.begin() + nbPlayers);
+            }
+
+            // Waited long enough: the bots will complete the table
+            if ((mOptions.botTimeout > 0U) && !players.empty() &&
+                (Elapsed(players.front().since, now) >= (mOptions.botTimeout * 1000ULL)))
+            {
+                plans.push_back(Plan{q.first, nullptr, std::vector<Waiting>(players.begin(), players.end())});
+                players.clear();
+            }
+        }
+
+        for (const auto &plan : plans)
+        {
+            for (const auto &w : plan.players)
+            {
+                mInFlight.insert(w.uuid);
+            }
+        }
+    }
+
+    for (auto &plan : plans)
+    {
+        if (plan.match == nullptr)
+        {
+            Match match;
+            match.key = plan.key;
+            match.tableId = TakeTable(plan.key);
+            match.freeSeats = plan.key.first;
+            match.since = plan.players.front().since;
+            match.closing = false;
+            if (match.tableId == Protocol::INVALID_UID)
+            {
+                // No more table: back in the queue, in the same order, except the players gone meanwhile
+                std::scoped_lock<std::mutex> lock(mMutex);
+                std::deque<Waiting> &players = mQueues[plan.key].players;
+                for (auto it = plan.players.rbegin(); it != plan.players.rend(); ++it)
+                {
+                    if (mInFlight.erase(it->uuid) > 0U)
+                    {
+                        players.push_front(*it);
+                    }
+                }
+                continue;
+            }
+            mMatches.push_back(match);
+            plan.match = &mMatches.back();
+        }
+        Seat(plan.key, *plan.match, plan.players);
+    }
+
+    // Free seats after the timeout go to the bots
+    if (mOptions.botTimeout > 0U)
+    {
+        for (auto &m : mMatches)
+        {
+            if (!m.closing && (m.freeSeats > 0U) && (Elapsed(m.since, now) >= (mOptions.botTimeout * 1000ULL)))
+            {
+                AddBots(m);
+            }
+            if (!m.closing)
+            {
+                SeatBots(m);
+            }
+        }
+    }
+
+    CloseMatches();
+    FillPool();
+}
+/*****************************************************************************/
+void Matchmaker::Seat(const QueueKey &key, Match &match, std::vector<Waiting> &players)
+{
+    std::vector<std::uint32_t> uuids;
+    for (const auto &w : players)
+    {
+        uuids.push_back(w.uuid);
+    }
+
+    // A player removed meanwhile is no longer in flight: its UUID may be the one of a new player
+    std::vector<std::uint32_t> seated = mLobby->SeatPlayers(match.tableId, uuids, [this](std::uint32_t uuid) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mInFlight.count(uuid) > 0U;
+    });
+    auto now = std::chrono::steady_clock::now();
+
+    match.players.insert(match.players.end(), seated.begin(), seated.end());
+    match.freeSeats -= static_cast<std::uint32_t>(seated.size());
+
+    std::scoped_lock<std::mutex> lock(mMutex);
+    Queue &queue = mQueues[key];
+    for (const auto &w : players)
+    {
+        mInFlight.erase(w.uuid);
+        if (std::find(seated.begin(), seated.end(), w.uuid) != seated.end())
+        {
+            queue.waits.Add(Elapsed(w.since, now));
+            queue.matched++;
+        }
+    }
+}
+/*****************************************************************************/
+std::uint32_t Matchmaker::TakeTable(const QueueKey &key)
+{
+    std::uint32_t id;
+    std::vector<std::uint32_t> &pool = mPool[key];
+
+    if (pool.size() > 0U)
+    {
+        id = pool.back();
+        pool.pop_back();
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mPoolHits++;
+    }
+    else
+    {
+        id = NewTable(key);
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mPoolMisses++;
+    }
+    return id;
+}
+/*****************************************************************************/
+std::uint32_t Matchmaker::NewTable(const QueueKey &key)
+{
+    Tarot::Game game;
+    game.mode = key.second;
+
+    std::uint32_t id = mLobby->CreateTable("Match " + std::to_string(key.first) + "P " + game.Get(), game, key.first);
+    if (id != Protocol::INVALID_UID)
+    {
+        // Nobody can sit there but the matched players
+        mLobby->ReserveTable(id);
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mTablesCreated++;
+    }
+    return id;
+}
+/*****************************************************************************/
+// Prepares the tables of the queues used so far
+void Matchmaker::FillPool()
+{
+    std::vector<QueueKey> keys;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        for (const auto &q : mQueues)
+        {
+            keys.push_back(q.first);
+        }
+    }
+
+    for (const auto &key : keys)
+    {
+        std::vector<std::uint32_t> &pool = mPool[key];
+        while (pool.size() < mOptions.poolSize)
+        {
+            std::uint32_t id = NewTable(key);
+            if (id == Protocol::INVALID_UID)
+            {
+                return;
+            }
+            pool.push_back(id);
+        }
+    }
+}
+/*****************************************************************************/
+void Matchmaker::AddBots(Match &match)
+{
+    // The table stays reserved: the bots are seated by SeatBots() once logged in,
+    // so a lobby user cannot take their seats
+    for (std::uint32_t i = 0U; i < match.freeSeats; i++)
+    {
+        BotAccount account;
+        if (mFreeAccounts.size() > 0U)
+        {
+            account = mFreeAccounts.back();
+            mFreeAccounts.pop_back();
+        }
+        else
+        {
+            account.webId = "matchbot" + std::to_string(++mNextAccount);
+            account.key = RandomString(16U);
+            account.passPhrase = RandomString(16U);
+            mServer->AddClient(account.webId, account.key, account.passPhrase);
+        }
+
+        account.seated = false;
+        account.botId = mBots.AddBot(match.tableId, Identity(account.webId, "", Identity::cGenderRobot), mOptions.botDelay, "");
+        mBots.Initialize(account.botId, account.webId, account.key, account.passPhrase);
+        mBots.ConnectBot(account.botId, "127.0.0.1", mServer->GetOptions().game_tcp_port);
+        match.bots.push_back(account);
+    }
+
+    std::scoped_lock<std::mutex> lock(mMutex);
+    mBotsAdded += match.freeSeats;
+    match.freeSeats = 0U;
+}
+/*****************************************************************************/
+// Sends the bots of the table that have entered the lobby to their seats
+void Matchmaker::SeatBots(Match &match)
+{
+    for (auto &bot : match.bots)
+    {
+        if (!bot.seated)
+        {
+            std::uint32_t uuid = mBots.GetUuid(bot.botId);
+            if (uuid != Protocol::INVALID_UID)
+            {
+                // Not seated while still logging in, tried again at the next tick
+                bot.seated = !mLobby->SeatPlayers(match.tableId, { uuid }).empty();
+            }
+        }
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief Matchmaker::CloseMatches
+ *
+ * When all the players have left a table, its bots are disconnected; the
+ * table is destroyed once empty.
+ */
+void Matchmaker::CloseMatches()
+{
+    for (auto it = mMatches.begin(); it != mMatches.end(); )
+    {
+        Match &m = *it;
+        if (!m.closing)
+        {
+            bool left = true;
+            for (auto uuid : m.players)
+            {
+                if (mLobby->GetPlayerTable(uuid) == m.tableId)
+                {
+                    left = false;
+                    break;
+                }
+            }
+
+            if (left)
+            {
+                for (auto &bot : m.bots)
+                {
+                    mBots.RemoveBot(bot.botId);
+                    mFreeAccounts.push_back(bot);
+                }
+                m.bots.clear();
+                m.closing = true;
+            }
+        }
+
+        if (m.closing && (mLobby->GetNumberOfPlayers(m.tableId) == 0U))
+        {
+            mLobby->DestroyTable(m.tableId);
+            it = mMatches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    std::scoped_lock<std::mutex> lock(mMutex);
+    mActiveTables = static_cast<std::uint32_t>(mMatches.size());
+}
+/*****************************************************************************/
+Matchmaker::Report Matchmaker::GetReport()
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    Report r;
+
+    for (const auto &q : mQueues)
+    {
+        Tarot::Game game;
+        game.mode = q.first.second;
+
+        QueueReport qr;
+        qr.players = q.first.first;
+        qr.mode = game.Get();
+        qr.waiting = static_cast<std::uint32_t>(q.second.players.size());
+        qr.matched = q.second.matched;
+        qr.cancelled = q.second.cancelled;
+        qr.p50 = q.second.waits.Percentile(50.0);
+        qr.p99 = q.second.waits.Percentile(99.0);
+        qr.max = q.second.waits.Max();
+        r.queues.push_back(qr);
+    }
+    r.activeTables = mActiveTables;
+    r.tablesCreated = mTablesCreated;
+    r.poolHits = mPoolHits;
+    r.poolMisses = mPoolMisses;
+    r.bots = mBotsAdded;
+    return r;
+}
+/*****************************************************************************/
+std::string Matchmaker::Report::ToString() const
+{
+    std::stringstream ss;
+
+    ss << "Tables: active " << activeTables << ", created " << tablesCreated
+       << ", ready on demand " << poolHits << "/" << (poolHits + poolMisses) << ", bots " << bots << "\n";
+
+    ss << std::left << std::setw(24) << "Queue" << std::right << std::setw(10) << "waiting" << std::setw(10) << "matched"
+       << std::setw(10) << "cancel" << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms" << std::setw(12) << "max ms" << "\n";
+    ss << std::fixed << std::setprecision(1);
+    for (const auto &q : queues)
+    {
+        ss << std::left << std::setw(24) << (std::to_string(q.players) + "P " + q.mode) << std::right
+           << std::setw(10) << q.waiting << std::setw(10) << q.matched << std::setw(10) << q.cancelled
+           << std::setw(12) << q.p50 / 1000.0 << std::setw(12) << q.p99 / 1000.0 << std::setw(12) << q.max / 1000.0 << "\n";
+    }
+    return ss.str();
+}
+
+//=============================================================================
+// End of file Matchmaker.cpp
+//=============================================================================
@@ -0,0 +1,210 @@
+/*=============================================================================
+ * TarotClub - Matchmaker.h
+ *=============================================================================
+ * Automatic matchmaking: waiting queues that fill tables on demand
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef MATCHMAKER_H
+#define MATCHMAKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "IService.h"
+#include "BotManager.h"
+#include "LatencyHistogram.h"
+
+/*****************************************************************************/
+/**
+ * @brief The Matchmaker class
+ *
+ * The players ask to play instead of choosing a table:
+ *   {"cmd":"RequestMatch","players":4,"mode":"QuickDeal"}  (both optional)
+ *   {"cmd":"CancelMatch"}
+ * and are answered {"cmd":"ReplyMatch","status":"queued"|"cancelled"|"error",...}.
+ *
+ * There is one queue per number of players and game mode. As soon as a queue
+ * holds enough players, they are seated together at a new table; the player
+ * receives the usual ReplyJoinTable. The tables are created in advance (a few
+ * per queue) and reserved in the lobby, so nobody else can sit there.
+ *
+ * If the first player of a queue waits longer than the bot timeout, a table
+ * is started with the players present and the empty seats are given to bots.
+ * A table is destroyed when all its players have left. A player who leaves
+ * the lobby, or joins a table by itself, is removed from the queues (and is
+ * not seated if it was about to). Only a player in the lobby can be queued.
+ *
+ * The matching runs in its own thread, never under the lobby lock.
+ *
+ * Usage:
+ *   auto matchmaker = std::make_shared<Matchmaker>();
+ *   server->AddService(matchmaker);
+ *   matchmaker->Start(options);
+ */
+class Matchmaker : public IService
+{
+public:
+    struct Options
+    {
+        std::uint32_t tick;         ///< Matching period in milliseconds, a full queue is served at once
+        std::uint32_t poolSize;     ///< Empty tables kept ready per queue
+        std::uint32_t botTimeout;   ///< Wait in milliseconds before completing a table with bots, 0 for never
+        std::uint16_t botDelay;     ///< Delay of the answers of the bots, in milliseconds
+
+        Options()
+            : tick(100U)
+            , poolSize(2U)
+            , botTimeout(30000U)
+            , botDelay(500U)
+        {
+
+        }
+    };
+
+    struct QueueReport
+    {
+        std::uint8_t players;
+        std::string mode;
+        std::uint32_t waiting;      ///< Players in the queue now
+        std::uint64_t matched;      ///< Players seated
+        std::uint64_t cancelled;
+        std::uint64_t p50;          ///< Wait between the request and the seat, in microseconds
+        std::uint64_t p99;
+        std::uint64_t max;
+    };
+
+    struct Report
+    {
+        std::vector<QueueReport> queues;
+        std::uint32_t activeTables;
+        std::uint64_t tablesCreated;
+        std::uint64_t poolHits;     ///< Matches served by a table created in advance
+        std::uint64_t poolMisses;
+        std::uint64_t bots;         ///< Bots added to complete the tables
+
+        std::string ToString() const;
+    };
+
+    Matchmaker();
+    ~Matchmaker();
+
+    // From IService
+    std::string GetName();
+    void Initialize(std::shared_ptr<IServer> server, std::shared_ptr<Lobby> lobby);
+    void Stop();
+
+    bool Start(const Options &options);
+    Report GetReport();
+
+private:
+    typedef std::pair<std::uint8_t, std::uint8_t> QueueKey; // Number of players, game mode
+
+    struct Waiting
+    {
+        std::uint32_t uuid;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    struct Queue
+    {
+        std::deque<Waiting> players;
+        LatencyHistogram waits;
+        std::uint64_t matched;
+        std::uint64_t cancelled;
+
+        Queue() : matched(0U), cancelled(0U) {}
+    };
+
+    // Credentials of a bot, reused by the next bots
+    struct BotAccount
+    {
+        std::uint32_t botId;    ///< Id in the BotManager
+        std::string webId;
+        std::string key;
+        std::string passPhrase;
+        bool seated;            ///< Sent to its table, once logged in
+    };
+
+    // Table started by the matchmaker, used by the matching thread only
+    struct Match
+    {
+        QueueKey key;
+        std::uint32_t tableId;
+        std::vector<std::uint32_t> players;
+        std::vector<BotAccount> bots;
+        std::uint32_t freeSeats;
+        std::chrono::steady_clock::time_point since; ///< Arrival in the queue of its first player
+        bool closing;                       ///< All the players have left, waiting for the bots to leave
+    };
+
+    std::shared_ptr<IServer> mServer;
+    std::shared_ptr<Lobby> mLobby;
+    Options mOptions;
+    BotManager mBots;
+
+    // Shared with the lobby commands
+    std::mutex mMutex;
+    std::condition_variable mCondVar;
+    std::map<QueueKey, Queue> mQueues;
+    std::unordered_set<std::uint32_t> mInFlight; ///< Players taken from the queues, not seated yet
+    bool mRunning;
+    bool mWakeUp;
+    std::uint64_t mTablesCreated;
+    std::uint64_t mPoolHits;
+    std::uint64_t mPoolMisses;
+    std::uint64_t mBotsAdded;
+    std::uint32_t mActiveTables;
+
+    // Matching thread
+    std::thread mThread;
+    std::map<QueueKey, std::vector<std::uint32_t>> mPool; ///< Empty reserved tables
+    std::list<Match> mMatches;
+    std::vector<BotAccount> mFreeAccounts;
+    std::uint32_t mNextAccount;
+
+    void RequestMatch(std::uint32_t uuid, std::uint32_t tableId, const JsonValue &json, std::vector<Reply> &out);
+    void CancelMatch(std::uint32_t uuid, std::vector<Reply> &out);
+    bool IsQueued(std::uint32_t uuid) const;
+    bool RemoveUser(std::uint32_t uuid);
+
+    void Run();
+    void Tick();
+    void Seat(const QueueKey &key, Match &match, std::vector<Waiting> &players);
+    std::uint32_t TakeTable(const QueueKey &key);
+    std::uint32_t NewTable(const QueueKey &key);
+    void FillPool();
+    void AddBots(Match &match);
+    void SeatBots(Match &match);
+    void CloseMatches();
+};
+
+#endif // MATCHMAKER_H
+
+//=============================================================================
+// End of file Matchmaker.h
+//=============================================================================
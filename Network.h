@@ -15,6 +15,7 @@ struct Reply
 {
     std::vector<std::uint32_t> dest;
     JsonObject data;
+    std::string text;   // If not empty, sent instead of data: already serialized message, data holds only a part of it
 
     Reply(std::uint32_t d, const JsonObject &obj)
         : data(obj)
@@ -85,7 +86,7 @@ inline bool FromJson(Identity &ident, JsonObject &obj)
     return ret;
 }
 
-inline void ToJson(Identity &ident, JsonObject &obj)
+inline void ToJson(const Identity &ident, JsonObject &obj)
 {
     obj.AddValue("nickname", ident.username);
     obj.AddValue("avatar", ident.avatar);
@@ -34,6 +34,8 @@
 /*****************************************************************************/
 PlayerContext::PlayerContext()
     : mTableToJoin(0U)
+    , mLastSeq(0U)
+    , mResumeTableId(Protocol::INVALID_UID)
 {
 
 }
@@ -41,6 +43,7 @@ PlayerContext::PlayerContext()
 void PlayerContext::Clear()
 {
     mTables.clear();
+    mTablesTotal = 0U;
     mMessages.clear();
     mUsers.Clear();
     mMyself.Clear();
@@ -247,6 +250,10 @@ void PlayerContext::BuildQuitTable(std::uint32_t tableId, std::vector<Reply> &ou
     obj.AddValue("cmd", "RequestQuitTable");
     obj.AddValue("table_id", tableId);
 
+    // The seat is released by the server, nothing to resume
+    mResumeTableId = Protocol::INVALID_UID;
+    mResumeToken.clear();
+
     out.push_back(Reply(mMyself.tableId, obj));
 }
 /*****************************************************************************/
@@ -266,6 +273,47 @@ void PlayerContext::BuildJoinTable(uint32_t tableId, std::vector<Reply> &out)
 
     obj.AddValue("cmd", "RequestJoinTable");
     obj.AddValue("table_id", tableId);
+    if ((tableId == mResumeTableId) && !mResumeToken.empty())
+    {
+        // Take back our seat, the server sends only what we have missed
+        obj.AddValue("resume_token", mResumeToken);
+        obj.AddValue("last_seq", mLastSeq);
+    }
+
+    out.push_back(Reply(Protocol::LOBBY_UID, obj));
+}
+/*****************************************************************************/
+void PlayerContext::BuildRequestPlayerList(std::uint32_t page, const std::string &prefix, std::vector<Reply> &out)
+{
+    JsonObject obj;
+
+    obj.AddValue("cmd", "RequestPlayerList");
+    obj.AddValue("page", page);
+    if (!prefix.empty())
+    {
+        obj.AddValue("prefix", prefix);
+    }
+
+    out.push_back(Reply(Protocol::LOBBY_UID, obj));
+}
+/*****************************************************************************/
+void PlayerContext::BuildRequestTableList(std::uint32_t page, std::vector<Reply> &out)
+{
+    JsonObject obj;
+
+    obj.AddValue("cmd", "RequestTableList");
+    obj.AddValue("page", page);
+
+    out.push_back(Reply(Protocol::LOBBY_UID, obj));
+}
+/*****************************************************************************/
+void PlayerContext::BuildRequestMatch(std::uint8_t nbPlayers, const Tarot::Game &game, std::vector<Reply> &out)
+{
+    JsonObject obj;
+
+    obj.AddValue("cmd", "RequestMatch");
+    obj.AddValue("players", nbPlayers);
+    obj.AddValue("mode", game.Get());
 
     out.push_back(Reply(Protocol::LOBBY_UID, obj));
 }
@@ -484,17 +532,43 @@ void PlayerContext::DecodeRequestLogin(const JsonValue &json)
 /*****************************************************************************/
 void PlayerContext::DecodeAccessGranted(const JsonValue &json)
 {
-    JsonArray tablesArray = json.FindValue("tables").GetArray();
+    // First page of the tables, the others are requested with BuildRequestTableList()
     mTables.clear();
+    mTablesTotal = static_cast<std::uint32_t>(json.FindValue("tables_total").GetInteger());
+    AddTables(json.FindValue("tables").GetArray());
+
+    DecodePlayerList(json);
+}
+/*****************************************************************************/
+void PlayerContext::DecodeTableList(const JsonValue &json)
+{
+    if (json.FindValue("page").GetInteger() == 0)
+    {
+        mTables.clear();
+    }
+    mTablesTotal = static_cast<std::uint32_t>(json.FindValue("total").GetInteger());
+    AddTables(json.FindValue("tables").GetArray());
+}
+/*****************************************************************************/
+void PlayerContext::AddTables(const JsonArray &tablesArray)
+{
     for (std::uint32_t i = 0U; i < tablesArray.Size(); i++)
     {
        JsonObject tableObj = tablesArray.GetEntry(i).GetObj();
        uint32_t uuid = static_cast<std::uint32_t>(tableObj.GetValue("uuid").GetInteger());
        mTables[uuid] = tableObj.GetValue("name").GetString();
     }
-
+}
+/*****************************************************************************/
+void PlayerContext::DecodePlayerList(const JsonValue &json)
+{
     JsonArray players = json.FindValue("players").GetArray();
-    mUsers.Clear();
+
+    // The list is sent page by page, sorted by nickname; the first page replaces the list
+    if (!json.HasValue("page") || (json.FindValue("page").GetInteger() == 0))
+    {
+        mUsers.Clear();
+    }
 
     for (std::uint32_t i = 0U; i < players.Size(); i++)
     {
@@ -525,22 +599,34 @@ void PlayerContext::DecodeLobbyEvent(const JsonValue &json)
 
     Users::Entry member;
     UserFromJson(member, player);
-
-    if (type == "JoinTable")
+    UpdateMember(member, type);
+}
+/*****************************************************************************/
+void PlayerContext::DecodeLobbyEvents(const JsonValue &json)
+{
+    // Events grouped by the server, in their order of arrival
+    JsonArray events = json.FindValue("events").GetArray();
+    for (std::uint32_t i = 0U; i < events.Size(); i++)
     {
-        // Player has join a table
-        mUsers.UpdateLocation(member.player.uuid, member.player.tableId, member.player.place);
+        DecodeLobbyEvent(events.GetEntry(i));
     }
-
 }
 /*****************************************************************************/
 void PlayerContext::DecodeReplyJoinTable(const JsonValue &json)
 {
     mMyself.place = Place(json.FindValue("place").GetString());
     mMyself.tableId = static_cast<std::uint32_t>(json.FindValue("table_id").GetInteger());
-    mDeck.SetCards(json.FindValue("deck").GetString());
-    JsonObject gameContext = json.FindValue("context").GetObj();
-    mGameState.LoadFromJson(gameContext);
+    mResumeTableId = mMyself.tableId;
+    mResumeToken = json.FindValue("resume_token").GetString();
+
+    // Resumed from the events: our state is still valid, the missed events follow
+    if (json.FindValue("resume").GetString() != "events")
+    {
+        mDeck.SetCards(json.FindValue("deck").GetString());
+        JsonObject gameContext = json.FindValue("context").GetObj();
+        mGameState.LoadFromJson(gameContext);
+        mLastSeq = static_cast<std::uint32_t>(json.FindValue("seq").GetInteger());
+    }
 }
 /*****************************************************************************/
 void PlayerContext::DecodeNewGame(const JsonValue &json)
@@ -669,6 +755,11 @@ bool PlayerContext::Decode(const Request &req, JsonObject &json)
     else
     {
         json = jsonVal.GetObj();
+        if (json.HasValue("seq") && (json.GetValue("cmd").GetString() != "ReplyJoinTable"))
+        {
+            // Table event
+            mLastSeq = static_cast<std::uint32_t>(json.GetValue("seq").GetInteger());
+        }
     }
     return success;
 }
@@ -691,22 +782,18 @@ void PlayerContext::UpdateMember(Users::Entry &member, const std::string &event)
                     TLogError("AddEntry should not fail, the list is managed by the server");
                 }
             }
-            else
+            else if ((event != "JoinTable") && (event != "LeaveTable")) // Players of the table events may be unknown
             {
                 TLogError("User uuid should be in the list");
             }
         }
         else
         {
-            if (event == "Nick")
-            {
-                mUsers.ChangeNickName(member.player.uuid, member.identity.username);
-            }
-            else if ((event == "Join") ||
-                     (event == "Leave"))
-            {
-                mUsers.UpdateLocation(member.player.uuid, member.player.tableId, member.player.place);
-            }
+            // The server merges the events of a player and keeps the type of
+            // the last one (eg: JoinTable then Nick gives Nick): the event
+            // always carries the whole status, apply all of it
+            mUsers.ChangeNickName(member.player.uuid, member.identity.username);
+            mUsers.UpdateLocation(member.player.uuid, member.player.tableId, member.player.place);
         }
     }
 }
@@ -116,6 +116,9 @@ public:
     void BuildChangeNickname(std::vector<Reply> &out);
     void BuildReplyBid(std::vector<Reply> &out);
     void BuildJoinTable(std::uint32_t tableId, std::vector<Reply> &out);
+    void BuildRequestPlayerList(std::uint32_t page, const std::string &prefix, std::vector<Reply> &out);
+    void BuildRequestTableList(std::uint32_t page, std::vector<Reply> &out);
+    void BuildRequestMatch(std::uint8_t nbPlayers, const Tarot::Game &game, std::vector<Reply> &out);
     void BuildHandle(const Deck &handle, std::vector<Reply> &out);
     void BuildDiscard(const Deck &discard, std::vector<Reply> &out);
     void BuildSendCard(Card c, std::vector<Reply> &out);
@@ -138,6 +141,11 @@ public:
 
     Users::Player mMyself;
     std::uint32_t mTableToJoin;
+
+    // Resume of the table seat after a reconnection
+    std::uint32_t mLastSeq;         ///< Last table event received
+    std::uint32_t mResumeTableId;
+    std::string mResumeToken;
     Sit mSits[5];
     ClientOptions mOptions;
 
@@ -154,8 +162,9 @@ public:
 
     TableMode mMode = TABLE_MODE_BLOCKED;
 
-    // uuid --> name
+    // uuid --> name, the pages received so far
     std::map<std::uint32_t, std::string> mTables;
+    std::uint32_t mTablesTotal = 0U;
     std::vector<Message> mMessages;
     Users mUsers;
 
@@ -176,12 +185,16 @@ public:
     void DecodeNewGame(const JsonValue &json);
     void DecodeReplyJoinTable(const JsonValue &json);
     void DecodeLobbyEvent(const JsonValue &json);
+    void DecodeLobbyEvents(const JsonValue &json);
+    void DecodePlayerList(const JsonValue &json);
+    void DecodeTableList(const JsonValue &json);
     void DecodeChatMessage(const JsonValue &json);
     void DecodeAccessGranted(const JsonValue &json);
     void DecodeRequestLogin(const JsonValue &json);
 
 private:
     void UserFromJson(Users::Entry &member, JsonObject &player);
+    void AddTables(const JsonArray &tablesArray);
     void UpdateMember(Users::Entry &member, const std::string &event);
 };
 
@@ -24,13 +24,31 @@
  */
 
 #include <chrono>
+#include <random>
 #include <string>
 #include "Log.h"
+#include "Util.h"
 #include "PlayingTable.h"
 #include "Network.h"
 #include "System.h"
 #include "Protocol.h"
 
+/*****************************************************************************/
+// Util::GenerateRandomString() is seeded with the time, two players joining in
+// the same second would get the same token
+static std::string NewResumeToken()
+{
+    std::random_device rd;
+    std::uint8_t bytes[8];
+    for (std::uint32_t i = 0U; i < sizeof(bytes); i++)
+    {
+        bytes[i] = static_cast<std::uint8_t>(rd());
+    }
+
+    char hex[sizeof(bytes) * 2U];
+    Util::EncodeHex(bytes, sizeof(bytes), hex);
+    return std::string(hex, sizeof(hex));
+}
 /*****************************************************************************/
 PlayingTable::PlayingTable()
     : mFull(false)
@@ -38,6 +56,9 @@ PlayingTable::PlayingTable()
     , mName("Default")
     , mId(1U)
     , mAdminMode(false)
+    , mEventSeq(0U)
+    , mContextValid(false)
+    , mResumeTimeout(cDefaultResumeTimeout)
 {
 
 }
@@ -93,10 +114,13 @@ std::uint32_t PlayingTable::GetPlayerUuid(Place p)
 /*****************************************************************************/
 void PlayingTable::SendToAllPlayers(std::vector<Reply> &out, JsonObject &obj)
 {
+    AddEvent(0x1FU, obj);
+
     std::vector<std::uint32_t> list;
     for (std::uint32_t i = 0U; i < mEngine.Ctx().mNbPlayers; i++)
     {
-        if (!mPlayers[i].IsFree())
+        // Reserved seats only get the events when their player is back
+        if (mPlayers[i].uuid != Protocol::INVALID_UID)
         {
             list.push_back(mPlayers[i].uuid);
         }
@@ -104,6 +128,97 @@ void PlayingTable::SendToAllPlayers(std::vector<Reply> &out, JsonObject &obj)
     out.push_back(Reply(list, obj));
 }
 /*****************************************************************************/
+void PlayingTable::SendToPlayer(std::vector<Reply> &out, Place p, JsonObject &obj)
+{
+    AddEvent(static_cast<std::uint8_t>(1U << p.Value()), obj);
+
+    std::uint32_t uuid = GetPlayerUuid(p);
+    if (uuid != Protocol::INVALID_UID)
+    {
+        out.push_back(Reply(uuid, obj));
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief PlayingTable::AddEvent
+ *
+ * Stamp a table event with the next sequence number and keep it in the
+ * event log, so that a reconnecting player can get back what it has missed
+ */
+void PlayingTable::AddEvent(std::uint8_t places, JsonObject &obj)
+{
+    mEventSeq++;
+    obj.AddValue("seq", mEventSeq);
+
+    Event ev;
+    ev.seq = mEventSeq;
+    ev.places = places;
+    ev.data = obj;
+    mEvents.push_back(ev);
+    if (mEvents.size() > cEventLogSize)
+    {
+        mEvents.pop_front();
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief PlayingTable::GetEventsSince
+ *
+ * Replay the events of place p that follow lastSeq, addressed to the
+ * current player of this place
+ *
+ * @return false if the log does not contain all the missing events anymore:
+ * the player needs a full snapshot of the game
+ */
+bool PlayingTable::GetEventsSince(Place p, std::uint32_t lastSeq, std::vector<Reply> &out)
+{
+    bool ret = false;
+    std::uint8_t place = p.Value();
+
+    if ((place < mEngine.Ctx().mNbPlayers) && (lastSeq <= mEventSeq))
+    {
+        if (lastSeq == mEventSeq)
+        {
+            ret = true; // Nothing missed
+        }
+        else if (!mEvents.empty() && ((lastSeq + 1U) >= mEvents.front().seq))
+        {
+            std::uint32_t uuid = GetPlayerUuid(p);
+            for (const auto &ev : mEvents)
+            {
+                if ((ev.seq > lastSeq) && ((ev.places & (1U << place)) != 0U))
+                {
+                    out.push_back(Reply(uuid, ev.data));
+                }
+            }
+            ret = true;
+        }
+    }
+    return ret;
+}
+/*****************************************************************************/
+std::string PlayingTable::GetResumeToken(Place p)
+{
+    std::string token;
+    if (p.Value() < mEngine.Ctx().mNbPlayers)
+    {
+        token = mPlayers[p.Value()].token;
+    }
+    return token;
+}
+/*****************************************************************************/
+const JsonObject &PlayingTable::GetContext()
+{
+    // Several players may ask for the context between two requests (reconnections)
+    if (!mContextValid)
+    {
+        mContextCache.Clear();
+        mEngine.Ctx().SaveToJson(mContextCache);
+        mContextValid = true;
+    }
+    return mContextCache;
+}
+/*****************************************************************************/
 bool PlayingTable::Sync(Engine::Sequence sequence, std::uint32_t uuid)
 {
     for (std::uint32_t i = 0U; i < mEngine.Ctx().mNbPlayers; i++)
@@ -124,6 +239,36 @@ void PlayingTable::Initialize()
     mEngine.Initialize();
 }
 /*****************************************************************************/
+/**
+ * @brief PlayingTable::Reset
+ *
+ * Same state as a table just constructed. The containers are cleared, not
+ * freed: a recycled table is created again without allocating.
+ */
+void PlayingTable::Reset()
+{
+    mEngine.Reset();
+    for (std::uint32_t i = 0U; i < 5U; i++)
+    {
+        mPlayers[i].Clear();
+    }
+
+    mFull = false;
+    mAdmin = Protocol::INVALID_UID;
+    mName = "Default";
+    mId = 1U;
+    mScore.NewGame(TournamentConfig::DEFAULT_NUMBER_OF_TURNS);
+    mGame.mode = Tarot::Game::cQuickDeal;
+    mGame.deals.resize(1U);
+    mGame.deals[0] = Tarot::Distribution();
+    mAdminMode = false;
+    mResumeTimeout = cDefaultResumeTimeout;
+    mEventSeq = 0U;
+    mEvents.clear();
+    mContextCache.Clear();
+    mContextValid = false;
+}
+/*****************************************************************************/
 void PlayingTable::SetupGame(const Tarot::Game &game)
 {
     mGame = game;
@@ -146,6 +291,8 @@ void PlayingTable::CreateTable(std::uint8_t nbPlayers)
 
     mFull = false;
     mAdmin = Protocol::INVALID_UID;
+    mEvents.clear();
+    mContextValid = false;
 }
 /*****************************************************************************/
 Place PlayingTable::AddPlayer(std::uint32_t uuid, std::uint8_t &nbPlayers)
@@ -156,10 +303,13 @@ Place PlayingTable::AddPlayer(std::uint32_t uuid, std::uint8_t &nbPlayers)
     // Check if player is not already connected
     if (GetPlayerPlace(uuid) == Place(Place::NOWHERE))
     {
+        // A player who did not come back in time loses the seat
+        ReleaseSeats(true);
+
         // Look for free Place and assign the uuid to this player
         for (std::uint32_t i = 0U; i < mEngine.Ctx().mNbPlayers; i++)
         {
-            if (mPlayers[i].uuid == Protocol::INVALID_UID)
+            if (mPlayers[i].IsFree())
             {
                 assigned = i;
                 break;
@@ -170,6 +320,7 @@ Place PlayingTable::AddPlayer(std::uint32_t uuid, std::uint8_t &nbPlayers)
         if (place < Place::NOWHERE)
         {
             mPlayers[place].uuid = uuid;
+            mPlayers[place].token = NewResumeToken();
             // If it is the first player, then it is an admin
             if (mAdmin == Protocol::INVALID_UID)
             {
@@ -184,7 +335,45 @@ Place PlayingTable::AddPlayer(std::uint32_t uuid, std::uint8_t &nbPlayers)
     return assigned;
 }
 /*****************************************************************************/
-void PlayingTable::RemovePlayer(std::uint32_t kicked_player)
+/**
+ * @brief PlayingTable::ResumePlayer
+ *
+ * Give back a reserved seat to a reconnecting player
+ *
+ * @return The place of the player, NOWHERE if the token does not match any reserved seat
+ */
+Place PlayingTable::ResumePlayer(std::uint32_t uuid, const std::string &token)
+{
+    Place assigned;
+
+    if (!token.empty() && (GetPlayerPlace(uuid) == Place(Place::NOWHERE)))
+    {
+        ReleaseSeats(true);
+        for (std::uint32_t i = 0U; i < mEngine.Ctx().mNbPlayers; i++)
+        {
+            if (mPlayers[i].reserved && (mPlayers[i].token == token))
+            {
+                mPlayers[i].uuid = uuid;
+                mPlayers[i].reserved = false;
+                assigned = i;
+                if (mAdmin == Protocol::INVALID_UID)
+                {
+                    mAdmin = uuid;
+                }
+                break;
+            }
+        }
+    }
+    return assigned;
+}
+/*****************************************************************************/
+/**
+ * @brief PlayingTable::RemovePlayer
+ *
+ * @param kicked_player
+ * @param keepSeat Lost connection: during a game, the seat is kept for the player to resume
+ */
+void PlayingTable::RemovePlayer(std::uint32_t kicked_player, bool keepSeat)
 {
     // Check if the uuid exists
     Place place = GetPlayerPlace(kicked_player);
@@ -198,7 +387,7 @@ void PlayingTable::RemovePlayer(std::uint32_t kicked_player)
             {
                 // Choose another admin
                 std::uint32_t uuid = GetPlayerUuid(Place(i));
-                if (uuid != kicked_player)
+                if ((uuid != kicked_player) && (uuid != Protocol::INVALID_UID))
                 {
                     newAdmin = uuid;
                     break;
@@ -207,10 +396,31 @@ void PlayingTable::RemovePlayer(std::uint32_t kicked_player)
             mAdmin = newAdmin;
         }
 
+        bool inGame = (mEngine.GetSequence() != Engine::WAIT_FOR_PLAYERS) &&
+                      (mEngine.GetSequence() != Engine::STOPPED);
+
         // Actually remove it
         for (std::uint32_t i = 0U; i < mEngine.Ctx().mNbPlayers; i++)
         {
             if (mPlayers[i].uuid == kicked_player)
+            {
+                if (keepSeat && inGame && (mResumeTimeout > 0U))
+                {
+                    mPlayers[i].uuid = Protocol::INVALID_UID;
+                    mPlayers[i].reserved = true;
+                    mPlayers[i].lost = std::chrono::steady_clock::now();
+                }
+                else
+                {
+                    mPlayers[i].Clear();
+                }
+            }
+        }
+
+        // Nobody left to wait for: release the reserved seats
+        if (mAdmin == Protocol::INVALID_UID)
+        {
+            for (std::uint32_t i = 0U; i < 5U; i++)
             {
                 mPlayers[i].Clear();
             }
@@ -218,6 +428,26 @@ void PlayingTable::RemovePlayer(std::uint32_t kicked_player)
     }
 }
 /*****************************************************************************/
+/**
+ * @brief PlayingTable::ReleaseSeats
+ *
+ * Gives the reserved seats to anyone: the expired reservations only, or all
+ * of them (end of the game, nothing to resume)
+ */
+void PlayingTable::ReleaseSeats(bool expiredOnly)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    for (std::uint32_t i = 0U; i < 5U; i++)
+    {
+        if (mPlayers[i].reserved &&
+            (!expiredOnly || ((now - mPlayers[i].lost) >= std::chrono::seconds(mResumeTimeout))))
+        {
+            mPlayers[i].Clear();
+        }
+    }
+}
+/*****************************************************************************/
 Deck PlayingTable::GetPlayerDeck(Place p)
 {
     return mEngine.GetDeck(p);
@@ -240,6 +470,7 @@ bool PlayingTable::ExecuteRequest(std::uint32_t src_uuid, std::uint32_t dest_uui
 {
     (void) dest_uuid;
     bool isEndOfDeal = false;
+    mContextValid = false;
 
     std::string cmd = json.FindValue("cmd").GetString();
 
@@ -304,7 +535,7 @@ bool PlayingTable::ExecuteRequest(std::uint32_t src_uuid, std::uint32_t dest_uui
                         JsonObject obj;
 
                         obj.AddValue("cmd", "BuildDiscard");
-                        out.push_back(Reply(GetPlayerUuid(mEngine.Ctx().mBid.taker), obj));
+                        SendToPlayer(out, mEngine.Ctx().mBid.taker, obj);
                         break;
                     }
                     case Engine::WAIT_FOR_START_DEAL:
@@ -543,6 +774,7 @@ void PlayingTable::EndOfDeal(std::vector<Reply> &out)
     {
         // No more deal, send a end of game
         mEngine.NewGame();
+        ReleaseSeats(false);
         JsonObject obj;
 
         obj.AddValue("cmd", "EndOfGame");
@@ -596,7 +828,7 @@ void PlayingTable::NewDeal(std::vector<Reply> &out)
         obj.AddValue("cmd", "NewDeal");
         obj.AddValue("cards", deck.ToString());
 
-        out.push_back(Reply(GetPlayerUuid(place), obj));
+        SendToPlayer(out, place, obj);
     }
 }
 /*****************************************************************************/
@@ -725,7 +957,7 @@ void PlayingTable::GameSequence(std::vector<Reply> &out)
             JsonObject obj;
 
             obj.AddValue("cmd", "AskForHandle");
-            out.push_back(Reply(GetPlayerUuid(p), obj));
+            SendToPlayer(out, p, obj);
         }
         break;
 
@@ -25,6 +25,8 @@
 #ifndef PLAYING_TABLE_H
 #define PLAYING_TABLE_H
 
+#include <chrono>
+#include <deque>
 #include <vector>
 #include "Protocol.h"
 #include "Engine.h"
@@ -41,6 +43,7 @@ public:
     virtual ~PlayingTable () { /* nothing to do */ }
 
     void Initialize();
+    void Reset(); // Back to the state of a new table, keeps the allocated memory (table pool)
     bool ExecuteRequest(std::uint32_t src_uuid, std::uint32_t dest_uuid, const JsonValue &json, std::vector<Reply> &out);
 
     std::string GetName();
@@ -52,22 +55,31 @@ public:
     void CreateTable(std::uint8_t nbPlayers);
     void SetupGame(const Tarot::Game &game);
     void SetAdminMode(bool enable); // Automatic or table managed by the admin
+    void SetResumeTimeout(std::uint32_t seconds) { mResumeTimeout = seconds; } // 0: the seat of a lost player is released at once
     Place AddPlayer(std::uint32_t uuid, std::uint8_t &nbPlayers);
-    void RemovePlayer(std::uint32_t kicked_player);
+    void RemovePlayer(std::uint32_t kicked_player, bool keepSeat = false);
     Score GetScore() { return mScore; }
-    JsonObject GetContext() {
-        JsonObject json;
-        mEngine.Ctx().SaveToJson(json);
-        return json;
-    }
+    const JsonObject &GetContext();
 
     Deck GetPlayerDeck(Place p);
 
+    // Reconnection: a seat left by a disconnection during a game is kept for its player
+    Place ResumePlayer(std::uint32_t uuid, const std::string &token);
+    bool GetEventsSince(Place p, std::uint32_t lastSeq, std::vector<Reply> &out);
+    std::string GetResumeToken(Place p);
+    std::uint32_t GetEventSequence() { return mEventSeq; }
+
+    static const std::uint32_t cEventLogSize = 512U; ///< Table events kept for the reconnections (more than one deal)
+    static const std::uint32_t cDefaultResumeTimeout = 60U; ///< Seconds, then the seat of a lost player is given to anyone
+
 private:
     struct Challenger
     {
         std::uint32_t uuid;
         bool ack;
+        bool reserved;      ///< Player disconnected during a game, waiting for the resume
+        std::string token;  ///< Secret given to the player to take back the seat
+        std::chrono::steady_clock::time_point lost; ///< Start of the reservation
 
         Challenger()
         {
@@ -78,11 +90,13 @@ private:
         {
             uuid = Protocol::INVALID_UID;
             ack = false;
+            reserved = false;
+            token.clear();
         }
 
         bool IsFree()
         {
-            if (uuid == Protocol::INVALID_UID)
+            if ((uuid == Protocol::INVALID_UID) && !reserved)
             {
                 return true;
             }
@@ -94,6 +108,14 @@ private:
 
     };
 
+    // One entry per message sent by the table, with its sequence number
+    struct Event
+    {
+        std::uint32_t seq;
+        std::uint8_t places; ///< Bit mask of the destination places
+        JsonObject data;
+    };
+
     Engine mEngine;
     Challenger mPlayers[5]; ///< Players around the table, sorted by Place value
     bool mFull;
@@ -103,7 +125,13 @@ private:
     Score   mScore;         ///< Score of this table
     Tarot::Game mGame;      ///< Game mode
     bool mAdminMode;
+    std::uint32_t mEventSeq;        ///< Sequence number of the last table event
+    std::deque<Event> mEvents;      ///< Last cEventLogSize events
+    JsonObject mContextCache;       ///< Snapshot of the game context, valid until the next request
+    bool mContextValid;
+    std::uint32_t mResumeTimeout;   ///< Seconds a seat is reserved for a disconnected player
 
+    void ReleaseSeats(bool expiredOnly);
     void NewGame(std::vector<Reply> &out);
     void NewDeal(std::vector<Reply> &out);
     void StartDeal(std::vector<Reply> &out);
@@ -116,6 +144,8 @@ private:
     bool AckFromAllPlayers();
     std::uint32_t GetPlayerUuid(Place p);
     void SendToAllPlayers(std::vector<Reply> &out, JsonObject &obj);
+    void SendToPlayer(std::vector<Reply> &out, Place p, JsonObject &obj);
+    void AddEvent(std::uint8_t places, JsonObject &obj);
     void ShowKingCall(const Card &c, std::vector<Reply> &out);
 };
 
@@ -23,12 +23,14 @@
  *=============================================================================
  */
 
-#include <iomanip>
+#include <chrono>
 #include <cstring>
-#include <sstream>
+#include <mutex>
 #include "Protocol.h"
+#include "FramePool.h"
 #include "Log.h"
 #include "Util.h"
+#include "miniz.h"
 #include "mbedtls/md.h"
 #include "mbedtls/sha256.h"
 #include "mbedtls/gcm.h"
@@ -42,6 +44,7 @@ const std::uint32_t Protocol::USERS_UID         = 10U;
 const std::uint32_t Protocol::MAXIMUM_USERS     = 200U;
 const std::uint32_t Protocol::TABLES_UID        = 1000U;
 const std::uint32_t Protocol::MAXIMUM_TABLES    = 50U;
+const std::uint32_t Protocol::MAXIMUM_UID       = 0xFFFFU;
 
 
 const std::uint32_t Protocol::cTagSize              = 16U;
@@ -49,7 +52,28 @@ const std::uint32_t Protocol::cIVSize               = 12U;
 
 
 const std::uint16_t Protocol::cOptionClearData      = 0U;
-const std::uint16_t Protocol::cOptionCypheredData   = 1U;
+const std::uint16_t Protocol::cOptionCypheredData   = 0x01U;
+const std::uint16_t Protocol::cOptionDeflatedData   = 0x02U;
+const std::uint16_t Protocol::cOptionDeflateSupported = 0x04U;
+
+const std::uint32_t Protocol::cDefaultDeflateThreshold  = 512U;
+const std::uint32_t Protocol::cMaxInflatedSize          = 256U * 1024U;
+
+// Raw deflate (no zlib header, the frame is already authenticated by GCM), fast level: messages are small
+static const int cDeflateLevel = 1;
+
+struct Protocol::DeflateContext
+{
+    tdefl_compressor compressor;
+    std::string buffer; ///< Original size (4 bytes, little endian) + deflated data
+};
+
+namespace {
+
+std::mutex gDeflateStatsMutex;
+std::map<std::string, Protocol::DeflateStats> gDeflateStats;
+
+} // namespace
 
 /**
  * \page protocol Protocol format
@@ -67,180 +91,236 @@ const std::uint16_t Protocol::cOptionCypheredData   = 1U;
 
 /*****************************************************************************/
 Protocol::Protocol()
+    : mDeflateThreshold(cDefaultDeflateThreshold)
+    , mPeerInflates(false)
 {
-
-
+    mbedtls_gcm_init(&mEncryptCtx);
+    mbedtls_gcm_init(&mDecryptCtx);
 }
 /*****************************************************************************/
 Protocol::~Protocol()
 {
-
+    mbedtls_gcm_free(&mEncryptCtx);
+    mbedtls_gcm_free(&mDecryptCtx);
 }
 /*****************************************************************************/
-void Protocol::Encrypt(const std::string &aad, const std::string &payload, const std::string &iv, std::string &output)
+/**
+ * @brief Protocol::Encrypt
+ *
+ * Output buffer is provided by the caller and must hold at least
+ * cIVSize + payload.size() + cTagSize bytes (IV + ciphered data + tag)
+ */
+void Protocol::Encrypt(const std::string_view &aad, const std::string_view &payload, const uint8_t *iv, uint8_t *output)
 {
-    uint8_t tag[cTagSize];
-    uint8_t scratch[payload.size()];
+    uint8_t *ciphered = output + cIVSize;
 
-    mbedtls_gcm_context ctx;
-    mbedtls_gcm_init (&ctx);
-    mbedtls_gcm_setkey (&ctx, MBEDTLS_CIPHER_ID_AES, reinterpret_cast<const unsigned char *>(mKey.data()), 128);
-
-    mbedtls_gcm_crypt_and_tag(&ctx, MBEDTLS_GCM_ENCRYPT, payload.size(),
-                            reinterpret_cast<const unsigned char *>(iv.data()), 12,
-                            reinterpret_cast<const unsigned char *>(aad.data()), aad.size(),
+    std::memcpy(output, iv, cIVSize);
+    mbedtls_gcm_crypt_and_tag(&mEncryptCtx, MBEDTLS_GCM_ENCRYPT, payload.size(),
+                              iv, cIVSize,
+                              reinterpret_cast<const unsigned char *>(aad.data()), aad.size(),
                               reinterpret_cast<const unsigned char *>(payload.data()),
-                            scratch, cTagSize,tag
-                            );
-    /*
-
-    mbedtls_gcm_starts (&ctx, MBEDTLS_GCM_ENCRYPT,
-                        reinterpret_cast<const unsigned char *>(iv.data()), 12,
-                        reinterpret_cast<const unsigned char *>(aad.data()), aad.size());
-
-    int bound_size = (payload.size() >> 4) * 16;
-    int last_packet_size = payload.size() - bound_size;
-
-    if (bound_size > 0)
-    {
-        mbedtls_gcm_update (&ctx, bound_size, reinterpret_cast<const unsigned char *>(payload.data()), scratch);
-    }
-    if (last_packet_size > 0)
+                              ciphered, cTagSize, ciphered + payload.size());
+}
+/*****************************************************************************/
+/**
+ * @brief Protocol::Decrypt
+ *
+ * Decryption is performed in place: on success, the clear data is located
+ * at ciphered + cIVSize and is (size - cIVSize - cTagSize) bytes long
+ */
+bool Protocol::Decrypt(const std::string_view &aad, uint8_t *ciphered, uint32_t size)
+{
+    if (!mHasKey || (size < (cIVSize + cTagSize)))
     {
-        mbedtls_gcm_update (&ctx, last_packet_size, reinterpret_cast<const unsigned char *>(payload.data() + bound_size) , scratch + bound_size);
+        return false;
     }
 
-    // After the loop
-    mbedtls_gcm_finish (&ctx, tag, cTagSize);
-*/
-    mbedtls_gcm_free (&ctx);
-
-    output.append(iv);
-    output.append(reinterpret_cast<char *>(scratch), sizeof(scratch));
-    output.append(reinterpret_cast<char *>(tag), cTagSize);
+    uint8_t *payload = ciphered + cIVSize;
+    uint32_t plainTextSize = size - (cIVSize + cTagSize);
 
+    int ret = mbedtls_gcm_auth_decrypt(&mDecryptCtx, plainTextSize,
+                                       ciphered, cIVSize,
+                                       reinterpret_cast<const unsigned char *>(aad.data()), aad.size(),
+                                       ciphered + cIVSize + plainTextSize, cTagSize,
+                                       payload, payload);
+    return ret == 0;
 }
 /*****************************************************************************/
-bool Protocol::Decrypt(const std::string_view &aad, uint8_t *ciphered, uint32_t size, std::string &output) const
+// Value of the "cmd" field, the compact JSON format is expected
+std::string Protocol::MessageType(const char *data, std::size_t size)
 {
-    uint8_t tag_computed[cTagSize];
-    uint8_t tag[cTagSize];
-    uint8_t iv[cIVSize];
+    static const std::string_view key = "\"cmd\":\"";
+    std::string_view json(data, size);
+    std::string type = "unknown";
 
-    uint8_t *payload = ciphered + cIVSize;
+    std::size_t pos = json.find(key);
+    if (pos != std::string_view::npos)
+    {
+        pos += key.size();
+        std::size_t end = json.find('"', pos);
+        if (end != std::string_view::npos)
+        {
+            type = json.substr(pos, end - pos);
+        }
+    }
+    return type;
+}
+/*****************************************************************************/
+/**
+ * @brief Protocol::Build
+ *
+ * The frame is written in one buffer taken from the FramePool: the header is
+ * formatted in place, then the ciphered payload is hex-encoded right behind it.
+ * Give the frame back to the pool once sent (the WriteQueue does it).
+ * Returns an empty frame if the message does not fit in PROTO_MAX_BODY_SIZE.
+ */
+std::string Protocol::Build(std::uint32_t src, std::uint32_t dst, const std::string &clearMessage, const std::string &prefix)
+{
+    std::uint16_t option = cOptionCypheredData;
+    static const uint8_t iv[cIVSize] = { '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0' }; // Util::GenerateRandomString(cIVSize)
+    std::string_view payload = clearMessage;
 
-    memcpy(tag, ciphered + (size - cTagSize), cTagSize);
-    memcpy(iv, ciphered , cIVSize);
+    if (mDeflateThreshold > 0U)
+    {
+        option |= cOptionDeflateSupported;
 
-    uint32_t plainTextSize = size - (cIVSize + cTagSize);
-    uint8_t plainText[plainTextSize];
+        // Compression avant le chiffrement, uniquement si le pair sait décompresser
+        if (mPeerInflates && (clearMessage.size() >= mDeflateThreshold) && Deflate(clearMessage, payload))
+        {
+            option |= cOptionDeflatedData;
+        }
+    }
 
-    mbedtls_gcm_context ctx;
-    mbedtls_gcm_init (&ctx);
-    mbedtls_gcm_setkey (&ctx, MBEDTLS_CIPHER_ID_AES, reinterpret_cast<const unsigned char *>(mKey.data()), 128);
+    // Prédiction de la taille finale de la trame
+    uint32_t cipheredSize = cIVSize + payload.size() + cTagSize;
+    uint32_t cipheredPayloadSize = cipheredSize * 2;
+    std::size_t headerSize = PROTO_HEADER_SIZE + prefix.size() + 1U;
 
-    mbedtls_gcm_auth_decrypt(&ctx, plainTextSize,
-                              reinterpret_cast<const unsigned char *>(iv), 12,
-                              reinterpret_cast<const unsigned char *>(aad.data()), aad.size(),
-                             reinterpret_cast<const unsigned char *>(tag), cTagSize,
-                              reinterpret_cast<const unsigned char *>(payload),
-                             reinterpret_cast<unsigned char *>(plainText)
-                              );
+    // The sizes are written on four digits, and the peer refuses a larger body anyway
+    if ((static_cast<std::uint64_t>(cipheredPayloadSize) + prefix.size() + 1U) >= PROTO_MAX_BODY_SIZE)
+    {
+        TLogError("[PROTO] Message too large (" + std::to_string(clearMessage.size()) + " bytes): " +
+                  MessageType(clearMessage.data(), clearMessage.size()));
+        return std::string();
+    }
 
-    /*
-    mbedtls_gcm_starts (&ctx, MBEDTLS_GCM_DECRYPT,
-                        iv, cIVSize,
-                        reinterpret_cast<const unsigned char *>(aad.data()), aad.size());
+    std::string frame = FramePool::Instance().Acquire(headerSize + cipheredPayloadSize);
+    frame.resize(headerSize + cipheredPayloadSize);
 
-    int bound_size = (plainTextSize >> 4) * 16;
-    int last_packet_size = plainTextSize - bound_size;
+    // Fixed width fields: the frame counter wraps around
+    char *p = &frame[0];
+    p = WriteField(p, option, 2U);
+    p = WriteField(p, src, 4U);
+    p = WriteField(p, dst, 4U);
+    p = WriteField(p, cipheredPayloadSize, 4U);
+    p = WriteField(p, mTxFrameCounter, 4U);
+    p = WriteField(p, prefix.size(), 4U);
+    prefix.copy(p, prefix.size());
+    p[prefix.size()] = ':';
 
-    if (bound_size > 0)
-    {
-        mbedtls_gcm_update (&ctx, bound_size, payload, plainText);
-    }
-    if (last_packet_size > 0)
-    {
-        mbedtls_gcm_update (&ctx, last_packet_size, payload + bound_size , plainText + bound_size);
-    }
+    // On chiffre dans le buffer d'émission (IV + data + tag), réutilisé d'une trame à l'autre
+    mTxBuffer.resize(cipheredSize);
+    Encrypt(std::string_view(frame.data(), headerSize), payload, iv, mTxBuffer.data()); // l'AAD c'est tout l'en-tête + le prefix
 
-    // After the loop
-    mbedtls_gcm_finish (&ctx, tag_computed, cTagSize);
-*/
+    // Encodage hex directement à la fin de la trame
+    Util::EncodeHex(mTxBuffer.data(), cipheredSize, &frame[headerSize]);
 
-    mbedtls_gcm_free (&ctx);
-    output.append(reinterpret_cast<char *>(plainText), sizeof(plainText));
-    return std::memcmp(&tag_computed[0], tag, cTagSize) == 0;
+    mTxFrameCounter++;
+    return frame;
 }
 /*****************************************************************************/
-std::string Protocol::Build(std::uint32_t src, std::uint32_t dst, const std::string &clearMessage, const std::string &prefix)
+// Writes value as 'digits' lower case hex characters followed by the ':' separator
+char *Protocol::WriteField(char *out, std::uint32_t value, std::uint32_t digits)
 {
-    std::stringstream stream;
-    static const std::uint16_t option = cOptionCypheredData;
+    static const char cHex[] = "0123456789abcdef";
 
-    // Prédiction de la taille finale du payload
-    uint32_t cipheredPayloadSize = (cIVSize + clearMessage.size() + cTagSize) * 2;
-
-    stream  << std::setfill ('0') << std::setw(2) << std::hex << option << ":"
-            << std::setfill ('0') << std::setw(4) << std::hex << src << ":"
-            << std::setfill ('0') << std::setw(4) << std::hex << dst << ":"
-            << std::setfill ('0') << std::setw(4) << std::hex << cipheredPayloadSize << ":"
-            << std::setfill ('0') << std::setw(4) << std::hex << mTxFrameCounter << ":"
-            << std::setfill ('0') << std::setw(4) << std::hex << prefix.size() << ":"
-            << prefix  << ":";
-
-    // On chiffre
-    std::string payload; // IV + data + tag
-    std::string iv = "000000000000"; // Util::GenerateRandomString(cIVSize)
-    Encrypt(stream.str(), clearMessage, iv, payload); // l'AAD c'est tout l'en-tête + le prefix
-    std::string payloadAscii = Util::ToHex(reinterpret_cast<const char *>(payload.data()), payload.size());
-
-    stream << payloadAscii;
-
-    mTxFrameCounter++;
-    return stream.str();
+    for (std::uint32_t i = digits; i > 0U; i--)
+    {
+        out[i - 1U] = cHex[value & 0x0FU];
+        value >>= 4U;
+    }
+    out[digits] = ':';
+    return out + digits + 1U;
 }
 /*****************************************************************************/
+/**
+ * @brief Protocol::SetSecurity
+ *
+ * Expands the AES key once for both directions; the contexts are then
+ * reused for every frame of the session
+ */
 void Protocol::SetSecurity(const std::string &key)
 {
-    mKey = key;
+    mHasKey = (mbedtls_gcm_setkey(&mEncryptCtx, MBEDTLS_CIPHER_ID_AES, reinterpret_cast<const unsigned char *>(key.data()), 128) == 0) &&
+              (mbedtls_gcm_setkey(&mDecryptCtx, MBEDTLS_CIPHER_ID_AES, reinterpret_cast<const unsigned char *>(key.data()), 128) == 0);
+    if (!mHasKey)
+    {
+        TLogError("[PROTO] Cannot set security key");
+    }
     mRxFrameCounter = 0;
     mTxFrameCounter = 0;
 }
 /*****************************************************************************/
-bool Protocol::ParseUint32(const char* data, std::uint32_t size, std::uint32_t &value) const
+/**
+ * @brief Protocol::ParseHex
+ *
+ * Fixed width field: exactly 'size' hex digits, no sign, no blank and no "0x"
+ * (strtoul accepts all of them, and a negative size wraps around)
+ */
+bool Protocol::ParseHex(const char *data, std::uint32_t size, std::uint32_t &value)
 {
-    bool ret = false;
-    char *ptr;
-    value = std::strtoul(data, &ptr, 16);
-    std::uint32_t comp_size = static_cast<std::uint32_t>(ptr - data);
-    if (size == comp_size)
+    value = 0U;
+    for (std::uint32_t i = 0U; i < size; i++)
     {
-        ret = true;
+        char c = data[i];
+        std::uint32_t digit;
+
+        if ((c >= '0') && (c <= '9'))
+        {
+            digit = static_cast<std::uint32_t>(c - '0');
+        }
+        else if ((c >= 'a') && (c <= 'f'))
+        {
+            digit = static_cast<std::uint32_t>(c - 'a' + 10);
+        }
+        else if ((c >= 'A') && (c <= 'F'))
+        {
+            digit = static_cast<std::uint32_t>(c - 'A' + 10);
+        }
+        else
+        {
+            return false;
+        }
+        value = (value << 4U) | digit;
     }
-    return ret;
+    return true;
+}
+/*****************************************************************************/
+bool Protocol::ParseUint32(const char* data, std::uint32_t size, std::uint32_t &value) const
+{
+    return ParseHex(data, size, value);
 }
 /*****************************************************************************/
 bool Protocol::ParseUint16(const char* data, std::uint32_t size, std::uint16_t &value) const
 {
-    bool ret = false;
-    char *ptr;
-    value = std::strtoul(data, &ptr, 16);
-    std::uint32_t comp_size = static_cast<std::uint16_t>(ptr - data);
-    if (size == comp_size)
-    {
-        ret = true;
-    }
+    std::uint32_t field;
+    bool ret = ParseHex(data, size, field) && (field <= 0xFFFFU);
+    value = static_cast<std::uint16_t>(field);
     return ret;
 }
 /*****************************************************************************/
 void Protocol::ParsePrefix(Header &h)
+{
+    ParsePrefix(h, Data());
+}
+/*****************************************************************************/
+void Protocol::ParsePrefix(Header &h, const char *frame) const
 {
     if (h.prefix_size > 0)
     {
         if (h.prefix_size < PROTO_MAX_BODY_SIZE)
         {
-            h.prefix = std::string(&mData[28], h.prefix_size);
+            h.prefix = std::string(&frame[PROTO_HEADER_SIZE], h.prefix_size);
         }
         else
         {
@@ -249,44 +329,190 @@ void Protocol::ParsePrefix(Header &h)
     }
 }
 /*****************************************************************************/
+bool Protocol::DecryptPayload(std::string &output, const Header &h)
+{
+    return DecryptPayload(output, h, Data());
+}
+/*****************************************************************************/
 // Format d'entrée : IV + cyphered data + Tag
 // L'ensemble est transmis en ascii hex
 // Le header est utilisé comme Additional Data (s'il est corrompu, on le détectera)
 // Format de sortie : clear data
-bool Protocol::DecryptPayload(std::string &output, const Header &h) const
+bool Protocol::DecryptPayload(std::string &output, const Header &h, const char *frame)
 {
+    // The header may come from anywhere, do not trust it more than ParseHeader()
+    if ((static_cast<std::uint64_t>(h.payload_size) + h.prefix_size + 1U) >= PROTO_MAX_BODY_SIZE)
+    {
+        TLogError("[PROTO] Bad payload size");
+        return false;
+    }
+
     uint32_t cipheredPayloadSize = h.payload_size / 2;
-    uint8_t ciphered[cipheredPayloadSize];
+    mRxBuffer.resize(cipheredPayloadSize);
 
     // Transformation en ascii > décimal
-    Util::HexStringToUint8(std::string_view(Payload(h), h.payload_size), ciphered);
+    if (!Util::DecodeHex(&frame[PROTO_HEADER_SIZE + h.prefix_size + 1], h.payload_size, mRxBuffer.data()))
+    {
+        TLogError("[PROTO] Bad hex payload");
+        return false;
+    }
 
     // l'Additional Data: tout l'en-tête + le prefix
-    return Decrypt(std::string_view(Data(), PROTO_HEADER_SIZE + h.prefix_size + 1), ciphered, cipheredPayloadSize, output);
+    bool ret = Decrypt(std::string_view(frame, PROTO_HEADER_SIZE + h.prefix_size + 1), mRxBuffer.data(), cipheredPayloadSize);
+    if (ret)
+    {
+        const uint8_t *clear = mRxBuffer.data() + cIVSize;
+        uint32_t clearSize = cipheredPayloadSize - (cIVSize + cTagSize);
+
+        // The option field is authenticated (AAD), we can trust it
+        if ((h.option & cOptionDeflateSupported) != 0U)
+        {
+            mPeerInflates = true;
+        }
+
+        if ((h.option & cOptionDeflatedData) != 0U)
+        {
+            ret = Inflate(clear, clearSize, output);
+        }
+        else
+        {
+            output.assign(reinterpret_cast<const char *>(clear), clearSize);
+        }
+    }
+    return ret;
+}
+/*****************************************************************************/
+/**
+ * @brief Protocol::Deflate
+ *
+ * The compressor state (about 300 KB) is allocated once per protocol instance.
+ * Returns false if the compressed message would not be smaller.
+ */
+bool Protocol::Deflate(const std::string &message, std::string_view &compressed)
+{
+    if (message.size() <= 4U)
+    {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (!mDeflate)
+    {
+        mDeflate.reset(new DeflateContext); // default-initialized: tdefl_init() sets what is needed
+    }
+
+    std::string &buffer = mDeflate->buffer;
+    std::uint32_t rawSize = static_cast<std::uint32_t>(message.size());
+
+    // No room for more than the original size: no gain means no compression
+    buffer.resize(message.size());
+    buffer[0] = static_cast<char>(rawSize & 0xFFU);
+    buffer[1] = static_cast<char>((rawSize >> 8) & 0xFFU);
+    buffer[2] = static_cast<char>((rawSize >> 16) & 0xFFU);
+    buffer[3] = static_cast<char>((rawSize >> 24) & 0xFFU);
+
+    static const int flags = static_cast<int>(tdefl_create_comp_flags_from_zip_params(cDeflateLevel, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY));
+    tdefl_init(&mDeflate->compressor, nullptr, nullptr, flags);
+
+    std::size_t inSize = message.size();
+    std::size_t outSize = buffer.size() - 4U;
+    tdefl_status status = tdefl_compress(&mDeflate->compressor, message.data(), &inSize, &buffer[4], &outSize, TDEFL_FINISH);
+
+    bool ret = (status == TDEFL_STATUS_DONE);
+    if (ret)
+    {
+        compressed = std::string_view(buffer.data(), 4U + outSize);
+
+        std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        std::string type = MessageType(message.data(), message.size());
+
+        std::scoped_lock<std::mutex> lock(gDeflateStatsMutex);
+        DeflateStats &stats = gDeflateStats[type];
+        stats.deflated++;
+        stats.rawBytes += message.size();
+        stats.deflatedBytes += compressed.size();
+        stats.deflateNs += ns;
+    }
+    return ret;
+}
+/*****************************************************************************/
+bool Protocol::Inflate(const uint8_t *data, uint32_t size, std::string &output)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (size < 4U)
+    {
+        TLogError("[PROTOCOL] Bad deflated payload");
+        return false;
+    }
+
+    std::uint32_t rawSize = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<std::uint32_t>(data[3]) << 24);
+    if (rawSize > cMaxInflatedSize)
+    {
+        TLogError("[PROTOCOL] Inflated size too large");
+        return false;
+    }
+
+    output.resize(rawSize);
+    std::size_t written = tinfl_decompress_mem_to_mem(&output[0], rawSize, data + 4, size - 4U, 0);
+    if (written != rawSize)
+    {
+        TLogError("[PROTOCOL] Inflate error");
+        return false;
+    }
+
+    std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    std::string type = MessageType(output.data(), output.size());
+
+    std::scoped_lock<std::mutex> lock(gDeflateStatsMutex);
+    DeflateStats &stats = gDeflateStats[type];
+    stats.inflated++;
+    stats.inflateNs += ns;
+    return true;
+}
+/*****************************************************************************/
+std::map<std::string, Protocol::DeflateStats> Protocol::GetDeflateStats()
+{
+    std::scoped_lock<std::mutex> lock(gDeflateStatsMutex);
+    return gDeflateStats;
 }
 /*****************************************************************************/
 bool Protocol::ParseHeader(Header &h) const
+{
+    return ParseHeader(h, Data());
+}
+/*****************************************************************************/
+/**
+ * @brief Protocol::ParseHeader
+ *
+ * Returns false if the header is malformed or if the announced body does not
+ * fit in PROTO_MAX_BODY_SIZE; in both cases the peer is not trustworthy
+ * and the connection should be closed.
+ */
+bool Protocol::ParseHeader(Header &h, const char *frame) const
 {
     bool ret = true;
 
-    if ((mData[2] == ':') &&
-        (mData[7] == ':') &&
-        (mData[12] == ':') &&
-        (mData[17] == ':') &&
-        (mData[22] == ':') &&
-        (mData[27] == ':'))
+    if ((frame[2] == ':') &&
+        (frame[7] == ':') &&
+        (frame[12] == ':') &&
+        (frame[17] == ':') &&
+        (frame[22] == ':') &&
+        (frame[27] == ':'))
     {
-        ret = ParseUint16(&mData[0], 2, h.option);
-        ret = ret && ParseUint32(&mData[3], 4, h.src_uid);
-        ret = ret && ParseUint32(&mData[8], 4, h.dst_uid);
-        ret = ret && ParseUint32(&mData[13], 4, h.payload_size);
-        ret = ret && ParseUint32(&mData[18], 4, h.frame_counter);
-        ret = ret && ParseUint32(&mData[23], 4, h.prefix_size);
-
-        if ((h.payload_size + h.prefix_size + 1) >= PROTO_MAX_BODY_SIZE)
+        ret = ParseUint16(&frame[0], 2, h.option);
+        ret = ret && ParseUint32(&frame[3], 4, h.src_uid);
+        ret = ret && ParseUint32(&frame[8], 4, h.dst_uid);
+        ret = ret && ParseUint32(&frame[13], 4, h.payload_size);
+        ret = ret && ParseUint32(&frame[18], 4, h.frame_counter);
+        ret = ret && ParseUint32(&frame[23], 4, h.prefix_size);
+
+        // Each field has four digits at most, summed on 64 bits anyway
+        if (ret && ((static_cast<std::uint64_t>(h.payload_size) + h.prefix_size + 1U) >= PROTO_MAX_BODY_SIZE))
         {
             TLogError("[PROTOCOL] Body size too large");
-            abort();
+            ret = false;
         }
     }
     else
@@ -297,7 +523,6 @@ bool Protocol::ParseHeader(Header &h) const
     return ret;
 }
 
-
 //=============================================================================
 // End of file Protocol.cpp
 //=============================================================================
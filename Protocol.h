@@ -25,8 +25,14 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <atomic>
 #include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+#include "mbedtls/gcm.h"
 
 #define PROTO_HEADER_SIZE  28
 #define PROTO_MAX_BODY_SIZE (10*1024)
@@ -40,9 +46,10 @@ public:
     static const std::uint32_t LOBBY_UID;      //!< The lobby itself
 
     static const std::uint32_t USERS_UID;      //!< Start of users UUID
-    static const std::uint32_t MAXIMUM_USERS;  //!< Maximum number of users
+    static const std::uint32_t MAXIMUM_USERS;  //!< Default maximum number of users
     static const std::uint32_t TABLES_UID;     //!< Start of tables UUID
-    static const std::uint32_t MAXIMUM_TABLES; //!< Maximum number of tables
+    static const std::uint32_t MAXIMUM_TABLES; //!< Default maximum number of tables
+    static const std::uint32_t MAXIMUM_UID;    //!< Highest UUID (4 hex digits in the frame header)
     static const std::uint32_t NO_TABLE;       //!< Identifier for "no table"
 
     // Packets types
@@ -52,9 +59,26 @@ public:
     static const std::uint32_t cTagSize;
     static const std::uint32_t cIVSize;
 
-    // Options field
+    // Options field (bit flags)
     static const std::uint16_t cOptionClearData;
     static const std::uint16_t cOptionCypheredData;
+    static const std::uint16_t cOptionDeflatedData;       ///< Payload compressed before encryption
+    static const std::uint16_t cOptionDeflateSupported;   ///< The sender accepts compressed payloads
+
+    // Compression
+    static const std::uint32_t cDefaultDeflateThreshold;  ///< Smaller messages are never compressed
+    static const std::uint32_t cMaxInflatedSize;          ///< Bigger announced sizes are rejected
+
+    // Compression statistics, by message type ("cmd" field)
+    struct DeflateStats
+    {
+        std::uint64_t deflated;         ///< Number of messages compressed
+        std::uint64_t rawBytes;         ///< Size before compression
+        std::uint64_t deflatedBytes;    ///< Size after compression
+        std::uint64_t deflateNs;        ///< Time spent compressing
+        std::uint64_t inflated;         ///< Number of messages decompressed
+        std::uint64_t inflateNs;        ///< Time spent decompressing
+    };
 
     struct Header {
 
@@ -83,6 +107,10 @@ public:
     Protocol();
     ~Protocol();
 
+    // The GCM contexts own the expanded key, a protocol instance is bound to one peer
+    Protocol(const Protocol &) = delete;
+    Protocol &operator=(const Protocol &) = delete;
+
     char *Data()
     {
         return &mData[0];
@@ -103,21 +131,53 @@ public:
         return &mData[PROTO_HEADER_SIZE + h.prefix_size + 1];
     }
 
-    std::string Build(std::uint32_t src, std::uint32_t dst, const std::string &clearMessage, const std::string &prefix = "");
-    bool DecryptPayload(std::string &output, const Header &h) const;
+    std::string Build(std::uint32_t src, std::uint32_t dst, const std::string &clearMessage, const std::string &prefix = ""); // Empty if too large
     void SetSecurity(const std::string &key);
+
+    // Messages of at least threshold bytes are compressed if the peer supports it, 0 disables the compression
+    void SetDeflateThreshold(std::uint32_t threshold) { mDeflateThreshold = threshold; }
+    bool IsPeerDeflateSupported() const { return mPeerInflates; }
+    static std::map<std::string, DeflateStats> GetDeflateStats();
+
+    // Value of the "cmd" field of a JSON message, "unknown" if not found
+    static std::string MessageType(const char *data, std::size_t size);
+
+    // Parsing of the frame stored in the internal buffer
+    bool DecryptPayload(std::string &output, const Header &h);
     bool ParseHeader(Header &h) const;
     void ParsePrefix(Header &h);
 
+    // Parsing of a frame stored elsewhere (eg: stream receive buffer), frame points to the header
+    bool DecryptPayload(std::string &output, const Header &h, const char *frame);
+    bool ParseHeader(Header &h, const char *frame) const;
+    void ParsePrefix(Header &h, const char *frame) const;
+
 private:
     char mData[PROTO_HEADER_SIZE + PROTO_MAX_BODY_SIZE];
-    std::string mKey;
     uint32_t mTxFrameCounter = 0;
     uint32_t mRxFrameCounter = 0;
 
+    // AES key schedule is computed once in SetSecurity(), then reused for every frame.
+    // Separate contexts so that the sending and receiving paths can run on different threads
+    mbedtls_gcm_context mEncryptCtx;
+    mbedtls_gcm_context mDecryptCtx;
+    bool mHasKey = false;
+    std::vector<uint8_t> mTxBuffer; ///< IV + ciphered data + tag of the last built frame
+    std::vector<uint8_t> mRxBuffer; ///< Ciphered then clear data of the last received frame
+
+    // Compressor state is allocated at the first compressed message, then reused
+    struct DeflateContext;
+    std::unique_ptr<DeflateContext> mDeflate;
+    std::uint32_t mDeflateThreshold;
+    std::atomic<bool> mPeerInflates; ///< Learnt from the option field of the received frames
+
+    static bool ParseHex(const char *data, std::uint32_t size, std::uint32_t &value);
     bool ParseUint32(const char *data, uint32_t size, std::uint32_t &value) const;
-    void Encrypt(const std::string &aad, const std::string &payload, const std::string &iv, std::string &output);
-    bool Decrypt(const std::string_view &aad, uint8_t *ciphered, uint32_t size, std::string &output) const;
+    static char *WriteField(char *out, std::uint32_t value, std::uint32_t digits);
+    void Encrypt(const std::string_view &aad, const std::string_view &payload, const uint8_t *iv, uint8_t *output);
+    bool Deflate(const std::string &message, std::string_view &compressed);
+    bool Inflate(const uint8_t *data, uint32_t size, std::string &output);
+    bool Decrypt(const std::string_view &aad, uint8_t *ciphered, uint32_t size);
     bool ParseUint16(const char *data, std::uint32_t size, uint16_t &value) const;
 };
 
@@ -23,90 +23,286 @@
  *=============================================================================
  */
 
+#include <algorithm>
 #include <cctype>
 #include <iostream>
+#include <map>
 #include <string>
 #include <sstream>
 #include <memory>
 #include "Util.h"
 #include "Server.h"
+#include "WebSocketSession.h"
+#include "ShardHost.h"
+#include "FramePool.h"
 #include "System.h"
 #include "Base64Util.h"
 
 using namespace boost;
 
-PeerSession::PeerSession(asio::ip::tcp::socket socket, std::shared_ptr<Lobby> lobby, asio::io_context &io_context)
-    : socket_(std::move(socket))
-    , mLobby(lobby)
-    , read(io_context)
+ProtocolPeer::ProtocolPeer(std::shared_ptr<ILobbyGateway> lobby, asio::thread_pool &workers, const PoolStrand &lobbyStrand)
+    : mLobby(lobby)
+    , mTxStrand(asio::make_strand(workers))
+    , mLobbyStrand(lobbyStrand)
 {
 }
 
-void PeerSession::Start()
+bool ProtocolPeer::Register()
 {
-    TLogInfo("[SERVER] New peer");
     uuid = mLobby->AddUser(shared_from_this());
-    ReadHeader();
+    return uuid != Protocol::INVALID_UID;
+}
+
+void ProtocolPeer::Unregister()
+{
+    // Same hand-off as the requests, so that pending requests of this peer are executed before
+    asio::post(mLobbyStrand, [lobby = mLobby, id = uuid]() { lobby->RemoveUser(id); });
+}
+
+ProtocolPeer::SlowPeerPolicy ProtocolPeer::PolicyFromString(const std::string &policy)
+{
+    SlowPeerPolicy p = POLICY_COALESCE;
+
+    if (policy == "drop")
+    {
+        p = POLICY_DROP;
+    }
+    else if (policy == "disconnect")
+    {
+        p = POLICY_DISCONNECT;
+    }
+    return p;
+}
+
+void ProtocolPeer::Deliver(const std::string &data, std::uint32_t key)
+{
+    // Called under the lobby lock: only queue the message, the ciphering is done on the worker pool
+    std::scoped_lock<std::mutex> lock(mOutMutex);
+
+    if (mStats.overflow)
+    {
+        return;
+    }
+
+    if (((mOutBytes + data.size()) > mLimits.maxBytes) || (mOutQueue.size() >= mLimits.maxMessages))
+    {
+        if (Overflow(data, key))
+        {
+            return;
+        }
+    }
+
+    mOutQueue.push_back(Message{data, key});
+    mOutBytes += data.size();
+    mStats.maxQueuedBytes = std::max(mStats.maxQueuedBytes, mOutBytes);
+    ScheduleDrain();
+}
+
+/**
+ * @brief ProtocolPeer::Overflow
+ *
+ * The peer does not read its data fast enough: apply the slow peer policy.
+ * Called with the queue locked.
+ *
+ * @return true if the message has been handled (dropped, merged or peer disconnected),
+ * false if there is now room in the queue for it
+ */
+bool ProtocolPeer::Overflow(const std::string &data, std::uint32_t key)
+{
+    bool handled = false;
+
+    if (mLimits.policy == POLICY_DROP)
+    {
+        if (key != cCritical)
+        {
+            mStats.dropped++;
+            handled = true;
+        }
+        else
+        {
+            // Make room with the queued lobby events
+            for (auto it = mOutQueue.begin(); it != mOutQueue.end();)
+            {
+                if (it->key != cCritical)
+                {
+                    mOutBytes -= it->data.size();
+                    mStats.dropped++;
+                    it = mOutQueue.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+    else if (mLimits.policy == POLICY_COALESCE)
+    {
+        // Keep only the last queued event of each player
+        std::map<std::uint32_t, std::size_t> last;
+        for (std::size_t i = 0U; i < mOutQueue.size(); i++)
+        {
+            if (mOutQueue[i].key != cCritical)
+            {
+                last[mOutQueue[i].key] = i;
+            }
+        }
+
+        std::deque<Message> kept;
+        for (std::size_t i = 0U; i < mOutQueue.size(); i++)
+        {
+            Message &m = mOutQueue[i];
+            if ((m.key == cCritical) || (last[m.key] == i))
+            {
+                kept.push_back(std::move(m));
+            }
+            else
+            {
+                mOutBytes -= m.data.size();
+                mStats.coalesced++;
+            }
+        }
+        mOutQueue.swap(kept);
+
+        if (key != cCritical)
+        {
+            // A newer status of this player replaces the queued one
+            for (auto &m : mOutQueue)
+            {
+                if (m.key == key)
+                {
+                    mOutBytes = mOutBytes - m.data.size() + data.size();
+                    m.data = data;
+                    mStats.coalesced++;
+                    handled = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!handled &&
+        (((mOutBytes + data.size()) > mLimits.maxBytes) || (mOutQueue.size() >= mLimits.maxMessages)))
+    {
+        std::stringstream ss;
+        ss << "[SERVER] Peer " << uuid << " does not read its data, closing connection (" << mOutQueue.size() << " messages, " << mOutBytes << " bytes pending)";
+        TLogNetwork(ss.str());
+
+        mStats.overflow = true;
+        mOutQueue.clear();
+        mOutBytes = 0U;
+        Abort();
+        handled = true;
+    }
+    return handled;
 }
 
-void PeerSession::Deliver(const std::string &data)
+void ProtocolPeer::ScheduleDrain()
+{
+    // Called with the queue locked
+    if (!mDraining && !mOutQueue.empty() && (mTxBytes.load() < cTxBudget))
+    {
+        mDraining = true;
+        asio::post(mTxStrand, [self = shared_from_this()]() { self->Drain(); });
+    }
+}
+
+void ProtocolPeer::Drain()
 {
     // On génère une trame uniquement pour ce client, chiffrée avec ses clés
     // La source est toujours le lobby, et la destination notre peer
-    DoWrite(mProto.Build(Protocol::LOBBY_UID, uuid, data));
+    // Le chiffrement est fait sur le pool de threads : le strand garantit l'ordre des trames
+    // et protège le compteur de trames, l'écriture est ensuite faite dans le strand du transport
+    for (;;)
+    {
+        Message msg;
+        {
+            std::scoped_lock<std::mutex> lock(mOutMutex);
+            if (mOutQueue.empty() || mStats.overflow || (mTxBytes.load() >= cTxBudget))
+            {
+                // Resumed by FramesSent() when the transport has written its data
+                mDraining = false;
+                break;
+            }
+            msg = std::move(mOutQueue.front());
+            mOutQueue.pop_front();
+            mOutBytes -= msg.data.size();
+            mStats.delivered++;
+        }
+
+        std::string frame = mProto.Build(Protocol::LOBBY_UID, uuid, msg.data);
+        if (!frame.empty())
+        {
+            mTxBytes += frame.size();
+            WriteFrame(std::move(frame));
+        }
+    }
 }
 
-void PeerSession::ReadHeader()
+void ProtocolPeer::FramesSent(std::uint64_t bytes)
 {
-    socket_.async_receive(asio::buffer(mProto.Data(), PROTO_HEADER_SIZE),asio::bind_executor(read,
-          [&] (boost::system::error_code error, std::size_t /*length*/)
-     {
-          if ((asio::error::eof == error) || (asio::error::connection_reset == error))
-          {
-              boost::system::error_code ec;
-              socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
-              if (ec)
-              {
-                  TLogError("[SERVER] Close error");
-              }
-              TLogNetwork("[SERVER] Peer disconnected");
-              mLobby->RemoveUser(uuid);
-          }
-          else if (mProto.ParseHeader(h))
-          {
-              ReadBody();
-          }
-          else
-          {
-              ReadHeader();
-          }
-     }));
+    mTxBytes -= bytes;
+
+    std::scoped_lock<std::mutex> lock(mOutMutex);
+    ScheduleDrain();
 }
 
-void PeerSession::ReadBody()
+Peer::Stats ProtocolPeer::GetStats() const
 {
-    socket_.async_receive(asio::buffer(mProto.Body(), h.BodyLength()),asio::bind_executor(read,
-          [&] (std::error_code error, std::size_t /*length*/)
-     {
-         if(!error)
-         {
-            HandleBody();
-            ReadHeader();
-         }
-     }));
+    std::scoped_lock<std::mutex> lock(mOutMutex);
+    Stats stats = mStats;
+
+    stats.uuid = uuid;
+    stats.queuedMessages = static_cast<std::uint32_t>(mOutQueue.size());
+    stats.queuedBytes = mOutBytes;
+    return stats;
 }
 
-void PeerSession::HandleBody()
+/**
+ * @brief ProtocolPeer::ParseFrames
+ *
+ * Handle all the complete frames received so far; a partial frame stays in
+ * the receive buffer until the next read.
+ *
+ * @return false if the connection must be closed
+ */
+bool ProtocolPeer::ParseFrames()
 {
+    bool ret = true;
+    Protocol::Header h;
+    FrameParser::Status status;
+
+    while (ret && ((status = mRxParser.Next(mProto, h)) != FrameParser::FRAME_INCOMPLETE))
+    {
+        if (status == FrameParser::FRAME_READY)
+        {
+            ret = HandleFrame(h, mRxParser.Frame());
+            mRxParser.Consume(h);
+        }
+        else
+        {
+            TLogNetwork("[SERVER] Bad frame header, closing connection");
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+bool ProtocolPeer::HandleFrame(const Protocol::Header &header, const char *frame)
+{
+    bool ret = true;
+    Protocol::Header h = header;
+
     if (mIsPending)
     {
-        mProto.ParsePrefix(h);
+        mProto.ParsePrefix(h, frame);
         // 2. set player security key
         // prefix contains webId
         // à l'aide de cette information, on va récupérer la clé associée à ce joueur
-        if (mLobby->GetSecurity(h.prefix, sec))
+        sec = mLobby->GetSecurity(h.prefix);
+        if (sec)
         {
-            mProto.SetSecurity(sec.gek);
+            mProto.SetSecurity(sec->gek);
         }
         else
         {
@@ -115,7 +311,8 @@ void PeerSession::HandleBody()
     }
 
     Request req;
-    if (mProto.DecryptPayload(req.arg, h))
+    req.arg = FramePool::Instance().Acquire(h.payload_size / 2U);
+    if (mProto.DecryptPayload(req.arg, h, frame))
     {
 //        TLogNetwork("[SESSION] Found one packet with data: " + req.arg);
         req.src_uuid = h.src_uid;
@@ -123,7 +320,7 @@ void PeerSession::HandleBody()
 
         if (mIsPending)
         {
-            if (req.arg == sec.passPhrase)
+            if (sec && (req.arg == sec->passPhrase))
             {
                 mIsPending = false;
 
@@ -136,44 +333,195 @@ void PeerSession::HandleBody()
             }
             else
             {
-                TLogNetwork("[SERVER] Bad pass phrase, expected: " + sec.passPhrase + " decoded: " + req.arg);
-                mLobby->RemoveUser(uuid);
+                TLogNetwork("[SERVER] Bad pass phrase, expected: " + (sec ? sec->passPhrase : std::string()) + " decoded: " + req.arg);
+                ret = false;
             }
         }
         else
         {
             req.src_uuid = h.src_uid;
             req.dest_uuid = h.dst_uid;
-            mLobby->Deliver(req);
+            // Deciphering and parsing are done in this io thread, the game logic runs in the lobby strand
+            // The payload buffer goes back to the pool once processed
+            asio::post(mLobbyStrand, [self = shared_from_this(), lobby = mLobby, req = std::move(req)]() mutable {
+                if (!lobby->Deliver(req))
+                {
+                    self->Abort();
+                }
+                FramePool::Instance().Release(std::move(req.arg));
+            });
         }
     }
     else
     {
         TLogNetwork("[SERVER] Decrypt problem");
-        mLobby->RemoveUser(uuid);
+        ret = false;
+    }
+    return ret;
+}
+
+PeerSession::PeerSession(asio::ip::tcp::socket socket, std::shared_ptr<ILobbyGateway> lobby, asio::thread_pool &workers, const PoolStrand &lobbyStrand)
+    : ProtocolPeer(lobby, workers, lobbyStrand)
+    , socket_(std::move(socket))
+    , read(asio::make_strand(socket_.get_executor()))
+{
+}
+
+void PeerSession::Start()
+{
+    TLogInfo("[SERVER] New peer");
+    if (Register())
+    {
+        asio::post(read, [self = Self()]() { self->DoRead(); });
+    }
+    else
+    {
+        Abort();
+    }
+}
+
+void PeerSession::WriteFrame(std::string &&frame)
+{
+    asio::post(read, [self = Self(), frame = std::move(frame)]() mutable
+    {
+        self->DoWrite(std::move(frame));
+    });
+}
+
+void PeerSession::Abort()
+{
+    asio::post(read, [self = Self()]() { self->Close(); });
+}
+
+void PeerSession::DoRead()
+{
+    auto self = Self();
+    socket_.async_read_some(asio::buffer(mRxParser.Prepare(cReadChunkSize), cReadChunkSize), asio::bind_executor(read,
+          [self] (boost::system::error_code error, std::size_t length)
+     {
+          if (error)
+          {
+              if ((asio::error::eof == error) || (asio::error::connection_reset == error))
+              {
+                  TLogNetwork("[SERVER] Peer disconnected");
+              }
+              self->Close();
+          }
+          else
+          {
+              self->mRxParser.Commit(static_cast<std::uint32_t>(length));
+              if (self->ParseFrames())
+              {
+                  self->DoRead();
+              }
+              else
+              {
+                  self->Close();
+              }
+          }
+     }));
+}
+
+void PeerSession::Close()
+{
+    if (!mClosed)
+    {
+        mClosed = true;
+        boost::system::error_code ec;
+        socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+        if (ec)
+        {
+            TLogError("[SERVER] Close error");
+        }
+        Unregister();
     }
 }
 
-void PeerSession::DoWrite(const std::string &d)
+void PeerSession::DoWrite(std::string &&frame)
 {
-    asio::async_write(socket_, asio::buffer(d.c_str(), d.size()),
-                      [](std::error_code ec, std::size_t /*length*/)
+    // Only one write in flight; frames queued meanwhile are sent in the next gather write
+    if (mWriteQueue.Push(std::move(frame)))
+    {
+        StartWrite();
+    }
+}
+
+void PeerSession::StartWrite()
+{
+    auto self = Self();
+    asio::async_write(socket_, mWriteQueue.Prepare(), asio::bind_executor(read,
+                      [self](std::error_code ec, std::size_t /*length*/)
     {
         if (!ec)
         {
+            std::uint64_t pending = self->mWriteQueue.BytesPending();
+            bool more = self->mWriteQueue.Complete();
+            self->FramesSent(pending - self->mWriteQueue.BytesPending());
+            if (more)
+            {
+                self->StartWrite();
+            }
         }
-    });
+        else
+        {
+            TLogNetwork("[SERVER] Write error, dropping outgoing frames");
+            self->mWriteQueue.Clear();
+        }
+    }));
 }
 
 Server::Server(asio::io_context &io_context, ServerOptions &options)
     : mOptions(options)
-    , mLobby(std::make_shared<Lobby>())
+    , mNextIoContext(0U)
     , acceptor_(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), options.game_tcp_port))
-    , socket_(io_context)
-    , context(io_context)
+    , mWorkers(options.worker_threads > 0U ? options.worker_threads : std::max(1U, std::thread::hardware_concurrency()))
+    , mLobbyStrand(asio::make_strand(mWorkers))
 {
-    mLobby->CreateTable("Local game");
+    std::uint32_t nbThreads = options.io_threads > 0U ? options.io_threads : std::max(1U, std::thread::hardware_concurrency());
+
+    for (std::uint32_t i = 0U; i < nbThreads; i++)
+    {
+        mIoContexts.push_back(std::make_unique<StoppableContext<asio::io_context>>(1));
+        mIoWork.push_back(asio::make_work_guard(*mIoContexts.back()));
+    }
+
+    for (auto &ctx : mIoContexts)
+    {
+        asio::io_context *c = ctx.get();
+        mIoThreads.push_back(std::thread([c]() { c->run(); }));
+    }
+
+    if (options.shards > 0U)
+    {
+        // Front-end only: the players are routed to the shard processes
+        mRouter = std::make_shared<ShardRouter>(std::make_shared<LocalShardDirectory>(options.shards,
+                                                static_cast<std::uint32_t>(std::max(options.lobby_max_conn, 1)),
+                                                options.lobby_max_tables));
+        for (std::uint32_t i = 0U; i < options.shards; i++)
+        {
+            mRouter->AddShard(NextIoContext(), ShardHost::SocketPath(options, i));
+        }
+        mGateway = mRouter;
+    }
+    else
+    {
+        mLobby = std::make_shared<Lobby>();
+        SetupLobby(*mLobby, options, mWorkers);
+        mLobby->CreateTable("Local game");
+        mGateway = mLobby;
+    }
+
+    if (!options.credentials_file.empty())
+    {
+        LoadCredentials(options.credentials_file, false);
+    }
     Accept();
+
+    if (options.websocket_tcp_port != 0U)
+    {
+        mWsAcceptor = std::make_unique<asio::ip::tcp::acceptor>(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), options.websocket_tcp_port));
+        AcceptWebSocket();
+    }
 }
 
 Server::~Server()
@@ -182,11 +530,79 @@ Server::~Server()
     {
         s->Stop();
     }
+
+    if (mRouter)
+    {
+        mRouter->Stop();
+    }
+
+    for (auto &ctx : mIoContexts)
+    {
+        ctx->stop();
+    }
+
+    for (auto &t : mIoThreads)
+    {
+        if (t.joinable())
+        {
+            t.join();
+        }
+    }
+
+    // The queued handlers keep sessions alive: a session needs both its io_context
+    // (socket) and the worker pool (strands), so all the handlers are destroyed
+    // before any of these contexts
+    mWorkers.stop();
+    mWorkers.join();
+    mWorkers.shutdown();
+    for (auto &ctx : mIoContexts)
+    {
+        ctx->shutdown();
+    }
+}
+
+void Server::SetupLobby(Lobby &lobby, const ServerOptions &options, asio::thread_pool &workers)
+{
+    // Each table is an actor executed on the worker pool
+    lobby.SetExecutor([ex = workers.get_executor()](std::function<void ()> f) { asio::post(ex, std::move(f)); });
+    lobby.SetCapacity(static_cast<std::uint32_t>(std::max(options.lobby_max_conn, 1)), options.lobby_max_tables);
+    lobby.SetResumeTimeout(options.resume_timeout);
+    lobby.SetEventWindow(options.lobby_event_window, [ex = workers.get_executor()](std::uint32_t delayMs, std::function<void ()> f)
+    {
+        auto timer = std::make_shared<asio::steady_timer>(ex, std::chrono::milliseconds(delayMs));
+        timer->async_wait([timer, f](const boost::system::error_code &ec)
+        {
+            if (!ec)
+            {
+                f();
+            }
+        });
+    });
 }
 
 void Server::AddClient(const std::string &webId, const std::string &gek, const std::string &passPhrase)
 {
-    mLobby->AddAllowedClient(webId, gek, passPhrase);
+    mGateway->AddAllowedClient(webId, gek, passPhrase);
+}
+
+void Server::AddClients(const std::vector<CredentialStore::Credential> &clients)
+{
+    mGateway->GetCredentials().Add(clients);
+}
+
+bool Server::LoadCredentials(const std::string &fileName, bool replace)
+{
+    return mGateway->GetCredentials().LoadFile(fileName, replace);
+}
+
+bool Server::GetRouterStats(ShardRouter::Stats &stats)
+{
+    if (mRouter)
+    {
+        stats = mRouter->GetStats();
+        return true;
+    }
+    return false;
 }
 
 void Server::AddService(std::shared_ptr<IService> svc)
@@ -197,18 +613,56 @@ void Server::AddService(std::shared_ptr<IService> svc)
 
 void Server::Accept()
 {
-    acceptor_.async_accept(socket_,
-                           [this](std::error_code ec)
+    // The new socket is bound to the next io thread (round robin)
+    acceptor_.async_accept(NextIoContext(),
+                           [this](std::error_code ec, asio::ip::tcp::socket socket)
     {
         if (!ec)
         {
-            std::make_shared<PeerSession>(std::move(socket_), mLobby, context)->Start();
+            auto session = std::make_shared<PeerSession>(std::move(socket), mGateway, mWorkers, mLobbyStrand);
+            ConfigurePeer(*session);
+            session->Start();
         }
 
         Accept();
     });
 }
 
+void Server::AcceptWebSocket()
+{
+    // Same round robin, on a strand: the WebSocket stream handlers are bound to the socket executor
+    mWsAcceptor->async_accept(asio::make_strand(NextIoContext()),
+                              [this](std::error_code ec, asio::ip::tcp::socket socket)
+    {
+        if (!ec)
+        {
+            auto session = std::make_shared<WebSocketSession>(std::move(socket), mGateway, mWorkers, mLobbyStrand);
+            ConfigurePeer(*session);
+            session->Start();
+        }
+
+        AcceptWebSocket();
+    });
+}
+
+void Server::ConfigurePeer(ProtocolPeer &peer)
+{
+    ProtocolPeer::Limits limits;
+
+    limits.maxBytes = mOptions.peer_max_queue_bytes;
+    limits.maxMessages = mOptions.peer_max_queue_msgs;
+    limits.policy = ProtocolPeer::PolicyFromString(mOptions.slow_peer_policy);
+
+    peer.SetDeflateThreshold(mOptions.deflate_threshold);
+    peer.SetLimits(limits);
+}
+
+asio::io_context &Server::NextIoContext()
+{
+    asio::io_context &ctx = *mIoContexts[mNextIoContext];
+    mNextIoContext = (mNextIoContext + 1U) % mIoContexts.size();
+    return ctx;
+}
 
 //=============================================================================
 // End of file Server.cpp
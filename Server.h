@@ -26,6 +26,8 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <deque>
+#include <thread>
 #include <vector>
 #include "Lobby.h"
 #include "Protocol.h"
@@ -34,32 +36,133 @@
 #include <boost/asio.hpp>
 #include "IService.h"
 #include "IServer.h"
+#include "WriteQueue.h"
+#include "FrameParser.h"
+#include "ShardRouter.h"
 
 using namespace boost;
 
-class PeerSession : public Peer, public std::enable_shared_from_this<PeerSession>
+typedef boost::asio::strand<boost::asio::thread_pool::executor_type> PoolStrand;
+
+// Execution context whose pending handlers can be destroyed before the context itself,
+// while the other contexts that their sessions use are still alive
+template<typename Context>
+class StoppableContext : public Context
 {
 public:
-    PeerSession(boost::asio::ip::tcp::socket socket, std::shared_ptr<Lobby> lobby, boost::asio::io_context& io_context);
-
-    void Start();
-    virtual void Deliver(const std::string &data) override;
+    using Context::Context;
+    using boost::asio::execution_context::shutdown;
+};
 
-private:
+/*****************************************************************************/
+/**
+ * @brief The ProtocolPeer class
+ *
+ * Game protocol of one connected client, whatever the transport: security
+ * handshake, frame ciphering and hand-off of the requests to the lobby.
+ * The transport gives the received bytes to mRxParser then calls ParseFrames(),
+ * and writes the frames given to WriteFrame().
+ *
+ * Outgoing messages wait in clear in a bounded queue; they are ciphered only
+ * when the transport has less than cTxBudget bytes in flight. When a peer
+ * does not read its data, the queue reaches its limits and the slow peer
+ * policy is applied, so that one stalled client does not make the server
+ * memory grow.
+ */
+class ProtocolPeer : public Peer, public std::enable_shared_from_this<ProtocolPeer>
+{
+public:
+    enum SlowPeerPolicy
+    {
+        POLICY_DROP,        ///< Drop the lobby events, disconnect if the critical messages still overflow
+        POLICY_COALESCE,    ///< Keep only the last lobby event of each player, then disconnect
+        POLICY_DISCONNECT   ///< Disconnect as soon as a limit is reached
+    };
+
+    struct Limits
+    {
+        std::uint64_t maxBytes;
+        std::uint32_t maxMessages;
+        SlowPeerPolicy policy;
+    };
+
+    static const std::uint64_t cTxBudget = 64U * 1024U; ///< Ciphered bytes given to the transport and not yet written
+
+    ProtocolPeer(std::shared_ptr<ILobbyGateway> lobby, boost::asio::thread_pool &workers, const PoolStrand &lobbyStrand);
+
+    void SetDeflateThreshold(std::uint32_t threshold) { mProto.SetDeflateThreshold(threshold); } // Before Start()
+    void SetLimits(const Limits &limits) { mLimits = limits; } // Before Start()
+    static SlowPeerPolicy PolicyFromString(const std::string &policy);
+
+    // Thread safe: the frame is built (ciphered) later on the worker pool, in the call order
+    virtual void Deliver(const std::string &data, std::uint32_t key = cCritical) override;
+    virtual Stats GetStats() const override;
+    virtual void Disconnect() override { Abort(); }
+
+protected:
     std::uint32_t uuid = 0;
     Protocol mProto;
     bool mIsPending = true;
-    boost::asio::ip::tcp::socket socket_;
-    std::shared_ptr<Lobby> mLobby;
+    std::shared_ptr<ILobbyGateway> mLobby;
+    CredentialStore::CredentialPtr sec; ///< Found at the first frame, shared with the store
+    FrameParser mRxParser; ///< Accessed in the transport strand only
+    WriteQueue mWriteQueue; ///< Accessed in the transport strand only
+    PoolStrand mTxStrand; ///< Serializes frame building (tx frame counter)
+    PoolStrand mLobbyStrand; ///< Hand-off of the received requests to the game logic
+
+    bool Register(); // False if the lobby is full
+    void Unregister();
+    bool ParseFrames();
+    bool HandleFrame(const Protocol::Header &h, const char *frame);
+    void FramesSent(std::uint64_t bytes); // To call by the transport when a write completes
+
+    // Called from the worker pool with a ready to send frame
+    virtual void WriteFrame(std::string &&frame) = 0;
+    // Called from any thread: close the connection
+    virtual void Abort() = 0;
 
-    Lobby::Security sec;
-    Protocol::Header h;
-    boost::asio::io_context::strand read;
+private:
+    struct Message
+    {
+        std::string data;
+        std::uint32_t key;
+    };
+
+    mutable std::mutex mOutMutex;
+    std::deque<Message> mOutQueue;  ///< Not yet ciphered
+    std::uint64_t mOutBytes = 0U;
+    bool mDraining = false;         ///< A drain of the queue is posted in the tx strand
+    Limits mLimits = { 256U * 1024U, 1024U, POLICY_COALESCE };
+    Stats mStats = {};
+    std::atomic<std::uint64_t> mTxBytes{0U}; ///< Ciphered, not yet written
+
+    bool Overflow(const std::string &data, std::uint32_t key);
+    void ScheduleDrain();
+    void Drain();
+};
+
+/*****************************************************************************/
+class PeerSession : public ProtocolPeer
+{
+public:
+    PeerSession(boost::asio::ip::tcp::socket socket, std::shared_ptr<ILobbyGateway> lobby, boost::asio::thread_pool &workers, const PoolStrand &lobbyStrand);
+
+    void Start();
 
-    void ReadHeader();
-    void DoWrite(const std::string &d);
-    void ReadBody();
-    void HandleBody();
+private:
+    boost::asio::ip::tcp::socket socket_;
+    bool mClosed = false;
+    boost::asio::strand<boost::asio::ip::tcp::socket::executor_type> read; ///< Bound to the io thread owning the socket
+
+    static const std::uint32_t cReadChunkSize = 4096U;
+
+    std::shared_ptr<PeerSession> Self() { return std::static_pointer_cast<PeerSession>(shared_from_this()); }
+    void DoRead();
+    void Close();
+    virtual void WriteFrame(std::string &&frame) override;
+    virtual void Abort() override;
+    void DoWrite(std::string &&frame);
+    void StartWrite();
 };
 
 
@@ -71,21 +174,40 @@ public:
 
     // From IServer
     void AddClient(const std::string &webId, const std::string &gek, const std::string &passPhrase);
+    void AddClients(const std::vector<CredentialStore::Credential> &clients) override;
     ServerOptions &GetOptions() { return mOptions; }
 
     void AddService(std::shared_ptr<IService> svc);
+    bool LoadCredentials(const std::string &fileName, bool replace); // replace: also drops the clients added by AddClient()
+    bool GetRouterStats(ShardRouter::Stats &stats); // False if not in sharded mode
+
+    // Executor, capacity and event timers of a lobby served by the worker pool
+    static void SetupLobby(Lobby &lobby, const ServerOptions &options, asio::thread_pool &workers);
 
 private:
     ServerOptions &mOptions;
-    std::shared_ptr<Lobby> mLobby;
+
+    // One io_context per thread: a connection is bound to one thread for its whole life
+    std::vector<std::unique_ptr<StoppableContext<asio::io_context>>> mIoContexts;
+    std::vector<asio::executor_work_guard<asio::io_context::executor_type>> mIoWork;
+    std::vector<std::thread> mIoThreads;
+    std::uint32_t mNextIoContext;
+
+    std::shared_ptr<Lobby> mLobby;          ///< Null in sharded mode, the lobbies are in the shard processes
+    std::shared_ptr<ShardRouter> mRouter;   ///< Sharded mode only
+    std::shared_ptr<ILobbyGateway> mGateway; ///< Lobby or router, given to the peers
     std::vector<std::shared_ptr<IService>> mServices;
 
     // Net stuff
     asio::ip::tcp::acceptor acceptor_;
-    asio::ip::tcp::socket socket_;
-    asio::io_context &context;
+    std::unique_ptr<asio::ip::tcp::acceptor> mWsAcceptor; ///< Browser clients, disabled if the port is zero
+    StoppableContext<asio::thread_pool> mWorkers; ///< Outgoing frames are ciphered here, off the lobby lock
+    PoolStrand mLobbyStrand;    ///< Lobby requests are executed in order here, off the io threads
 
     void Accept();
+    void AcceptWebSocket();
+    void ConfigurePeer(ProtocolPeer &peer);
+    asio::io_context &NextIoContext();
 };
 
 
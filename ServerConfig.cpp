@@ -33,6 +33,8 @@
 static const std::string SERVER_CONFIG_VERSION  = "8"; // increase the version to force any incompatible update in the file structure
 const std::string ServerConfig::DEFAULT_SERVER_CONFIG_FILE  = "tcds.json";
 const std::string ServerConfig::DEFAULT_SERVER_NAME = "server1";
+const std::string ServerConfig::DEFAULT_SLOW_PEER_POLICY = "coalesce";
+const std::string ServerConfig::DEFAULT_SHARD_SOCKET = "/tmp/tarotclub-shard";
 
 
 /*
@@ -231,6 +233,69 @@ bool ServerConfig::Load(const std::string &fileName)
                     mOptions.lobby_max_conn = unsignedVal;
                 }
 
+                if (json.GetValue("lobby_max_tables", unsignedVal) && (unsignedVal > 0U))
+                {
+                    mOptions.lobby_max_tables = unsignedVal;
+                }
+
+                if (json.GetValue("lobby_event_window", unsignedVal))
+                {
+                    mOptions.lobby_event_window = unsignedVal;
+                }
+
+                if (json.GetValue("resume_timeout", unsignedVal))
+                {
+                    mOptions.resume_timeout = unsignedVal;
+                }
+
+                if (json.GetValue("worker_threads", unsignedVal))
+                {
+                    mOptions.worker_threads = unsignedVal;
+                }
+
+                if (json.GetValue("io_threads", unsignedVal))
+                {
+                    mOptions.io_threads = unsignedVal;
+                }
+
+                if (json.GetValue("deflate_threshold", unsignedVal))
+                {
+                    mOptions.deflate_threshold = unsignedVal;
+                }
+
+                if (json.GetValue("peer_max_queue_bytes", unsignedVal))
+                {
+                    mOptions.peer_max_queue_bytes = unsignedVal;
+                }
+
+                if (json.GetValue("peer_max_queue_msgs", unsignedVal))
+                {
+                    mOptions.peer_max_queue_msgs = unsignedVal;
+                }
+
+                if (json.GetValue("slow_peer_policy", stringVal))
+                {
+                    if ((stringVal == "drop") || (stringVal == "coalesce") || (stringVal == "disconnect"))
+                    {
+                        mOptions.slow_peer_policy = stringVal;
+                    }
+                }
+
+                if (json.GetValue("shards", unsignedVal))
+                {
+                    mOptions.shards = unsignedVal;
+                }
+
+                if (json.GetValue("shard_socket", stringVal))
+                {
+                    mOptions.shard_socket = stringVal;
+                }
+
+                if (json.GetValue("credentials_file", stringVal))
+                {
+                    mOptions.credentials_file = stringVal;
+                }
+
                 if (json.GetValue("local_host_only", boolVal))
                 {
                     mOptions.localHostOnly = boolVal;
@@ -296,6 +361,18 @@ bool ServerConfig::Save(const std::string &fileName)
     json.AddValue("websocket_tcp_port", mOptions.websocket_tcp_port);
     json.AddValue("console_tcp_port", mOptions.console_tcp_port);
     json.AddValue("lobby_max_conn", mOptions.lobby_max_conn);
+    json.AddValue("lobby_max_tables", mOptions.lobby_max_tables);
+    json.AddValue("lobby_event_window", mOptions.lobby_event_window);
+    json.AddValue("resume_timeout", mOptions.resume_timeout);
+    json.AddValue("worker_threads", mOptions.worker_threads);
+    json.AddValue("io_threads", mOptions.io_threads);
+    json.AddValue("deflate_threshold", mOptions.deflate_threshold);
+    json.AddValue("peer_max_queue_bytes", mOptions.peer_max_queue_bytes);
+    json.AddValue("peer_max_queue_msgs", mOptions.peer_max_queue_msgs);
+    json.AddValue("slow_peer_policy", mOptions.slow_peer_policy);
+    json.AddValue("shards", mOptions.shards);
+    json.AddValue("shard_socket", mOptions.shard_socket);
+    json.AddValue("credentials_file", mOptions.credentials_file);
     json.AddValue("local_host_only", mOptions.localHostOnly);
     json.AddValue("name", mOptions.name);
     json.AddValue("token", mOptions.token);
@@ -323,6 +400,18 @@ ServerOptions ServerConfig::GetDefault()
     opt.console_tcp_port    = DEFAULT_CONSOLE_TCP_PORT;
     opt.websocket_tcp_port  = DEFAULT_WEBSOCKET_TCP_PORT;
     opt.lobby_max_conn      = DEFAULT_LOBBY_MAX_CONN;
+    opt.lobby_max_tables    = DEFAULT_LOBBY_MAX_TABLES;
+    opt.lobby_event_window  = DEFAULT_LOBBY_EVENT_WINDOW;
+    opt.resume_timeout      = DEFAULT_RESUME_TIMEOUT;
+    opt.worker_threads      = DEFAULT_WORKER_THREADS;
+    opt.io_threads          = DEFAULT_IO_THREADS;
+    opt.deflate_threshold   = DEFAULT_DEFLATE_THRESHOLD;
+    opt.peer_max_queue_bytes = DEFAULT_PEER_MAX_QUEUE_BYTES;
+    opt.peer_max_queue_msgs = DEFAULT_PEER_MAX_QUEUE_MSGS;
+    opt.slow_peer_policy    = DEFAULT_SLOW_PEER_POLICY;
+    opt.shards              = DEFAULT_SHARDS;
+    opt.shard_socket        = DEFAULT_SHARD_SOCKET;
+    opt.credentials_file    = "";
     opt.localHostOnly       = false;
     opt.name                = DEFAULT_SERVER_NAME;
     opt.tables.push_back("Table 1"); // default table name (one table minimum)
@@ -35,6 +35,18 @@ struct ServerOptions
     std::uint16_t console_tcp_port;
     std::uint16_t websocket_tcp_port;
     std::int32_t lobby_max_conn;    // Max number of simultaneous connected clients
+    std::uint32_t lobby_max_tables; // Max number of tables; with the clients, limited to 65525 UUIDs
+    std::uint32_t lobby_event_window; // Lobby events are grouped during this delay (ms), 0 sends them at once
+    std::uint32_t resume_timeout;   // A player disconnected during a game can take back the seat during this delay (s), 0 disables the resume
+    std::uint32_t worker_threads;   // Threads used to build (cipher) outgoing frames, 0 means one per core
+    std::uint32_t io_threads;       // Threads serving the client connections (read, decipher), 0 means one per core
+    std::uint32_t deflate_threshold; // Messages of at least this size are compressed (if the client supports it), 0 disables the compression
+    std::uint32_t peer_max_queue_bytes; // Outgoing data waiting for a client that does not read fast enough
+    std::uint32_t peer_max_queue_msgs;
+    std::string slow_peer_policy;   // When a queue is full: "drop" lobby events, "coalesce" them or "disconnect" the client
+    std::uint32_t shards;           // Number of lobby shard processes behind this front-end, 0 runs the lobby in this process
+    std::string shard_socket;       // Unix socket of the shards, shard i listens on shard_socket + "." + i (from 1)
+    std::string credentials_file;   // Allowed clients loaded at startup (see CredentialStore::LoadFile()), empty for none
     bool localHostOnly; // if true, restrict to local host server
     std::string name;
     std::string token;
@@ -50,6 +62,17 @@ public:
     static const std::uint16_t  DEFAULT_WEBSOCKET_TCP_PORT  = 4270U;
     static const std::uint16_t  DEFAULT_CONSOLE_TCP_PORT    = 8090U;
     static const std::uint32_t  DEFAULT_LOBBY_MAX_CONN      = 250U;
+    static const std::uint32_t  DEFAULT_LOBBY_MAX_TABLES    = 50U;
+    static const std::uint32_t  DEFAULT_LOBBY_EVENT_WINDOW  = 100U;
+    static const std::uint32_t  DEFAULT_RESUME_TIMEOUT      = 60U;
+    static const std::uint32_t  DEFAULT_WORKER_THREADS      = 0U;
+    static const std::uint32_t  DEFAULT_IO_THREADS          = 0U;
+    static const std::uint32_t  DEFAULT_DEFLATE_THRESHOLD   = 512U;
+    static const std::uint32_t  DEFAULT_PEER_MAX_QUEUE_BYTES = 256U * 1024U;
+    static const std::uint32_t  DEFAULT_PEER_MAX_QUEUE_MSGS = 1024U;
+    static const std::uint32_t  DEFAULT_SHARDS              = 0U;
+    static const std::string    DEFAULT_SLOW_PEER_POLICY;
+    static const std::string    DEFAULT_SHARD_SOCKET;
     static const std::string    DEFAULT_SERVER_CONFIG_FILE;
     static const std::string    DEFAULT_SERVER_NAME;
 
@@ -1,6 +1,7 @@
 #include "Session.h"
 #include "Log.h"
 #include "Protocol.h"
+#include "FramePool.h"
 
 using namespace boost;
 
@@ -35,44 +36,97 @@ std::string Session::BuildConnectionPacket()
 /*****************************************************************************/
 void Session::Send(uint32_t my_uid, const std::vector<Reply> &out)
 {
-    // Send all messages
+    // All the frames of one event are queued together, so they leave in the same gather write
+    std::vector<std::string> frames;
     for (std::uint32_t i = 0U; i < out.size(); i++)
     {
+        // Serialized once, whatever the number of destinations
+        std::string data = out[i].data.ToString();
+
         // To all indicated peers
         for (std::uint32_t j = 0U; j < out[i].dest.size(); j++)
         {
-            SendToHost(mProto.Build(my_uid, out[i].dest[j], out[i].data.ToString()));
+            std::string frame = mProto.Build(my_uid, out[i].dest[j], data);
+            if (!frame.empty())
+            {
+                frames.push_back(std::move(frame));
+            }
         }
     }
+
+    if (frames.size() > 0U)
+    {
+        mEvents++;
+        mFrames += frames.size();
+        SendToHost(std::move(frames));
+    }
+}
+/*****************************************************************************/
+Session::Stats Session::GetStats() const
+{
+    Stats s;
+    s.events = mEvents;
+    s.frames = mFrames;
+    s.writes = mWrites;
+    return s;
 }
 /*****************************************************************************/
-void Session::SendToHost(const std::string &data)
+void Session::SendToHost(std::string &&frame)
+{
+    std::vector<std::string> frames;
+    frames.push_back(std::move(frame));
+    SendToHost(std::move(frames));
+}
+/*****************************************************************************/
+void Session::SendToHost(std::vector<std::string> &&frames)
 {
 //    std::stringstream dbg;
 //    dbg << "Client sending packet: 0x" << std::hex << (int)cmd;
 ///    TLogNetwork(dbg.str());
 
-    if (socket.is_open())
+    // May be called from any thread: the queue is only accessed in the io_context thread
+    asio::post(io_context, [this, frames = std::move(frames)]() mutable
     {
-        asio::async_write(socket,
-            asio::buffer(data.c_str(),
-              data.length()),
-            [this](std::error_code ec, std::size_t /*length*/)
+        if (socket.is_open())
+        {
+            // Only one write in flight; frames queued meanwhile are sent in the next gather write
+            bool start = false;
+            for (auto &f : frames)
+            {
+                start = mWriteQueue.Push(std::move(f));
+            }
+
+            if (start)
+            {
+                StartWrite();
+            }
+        }
+        else
+        {
+            TLogNetwork("WARNING! try to send packet without any connection.");
+        }
+    });
+}
+/*****************************************************************************/
+void Session::StartWrite()
+{
+    mWrites++;
+    asio::async_write(socket, mWriteQueue.Prepare(),
+        [this](std::error_code ec, std::size_t /*length*/)
+        {
+            if (!ec)
             {
-              if (!ec)
-              {
-                 // okay
-              }
-              else
-              {
+                if (mWriteQueue.Complete())
+                {
+                    StartWrite();
+                }
+            }
+            else
+            {
+                mWriteQueue.Clear();
                 socket.close();
-              }
-            });
-    }
-    else
-    {
-        TLogNetwork("WARNING! try to send packet without any connection.");
-    }
+            }
+        });
 }
 /*****************************************************************************/
 bool Session::IsConnected()
@@ -150,6 +204,7 @@ void Session::ReadBody()
             if (!ec)
             {
                 Request req;
+                req.arg = FramePool::Instance().Acquire(h.payload_size / 2U);
                 if (mProto.DecryptPayload(req.arg, h))
                 {
 //                    TLogNetwork("[SESSION] Found one packet with data: " + req.arg);
@@ -157,6 +212,7 @@ void Session::ReadBody()
                     req.dest_uuid = h.dst_uid;
                     (void) mListener.Deliver(req);
                 }
+                FramePool::Instance().Release(std::move(req.arg));
                 ReadHeader();
             }
             else
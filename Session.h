@@ -1,10 +1,12 @@
 #ifndef SESSION_H
 #define SESSION_H
 
+#include <atomic>
 #include "Network.h"
 #include "ThreadQueue.h"
 #include <boost/asio.hpp>
 #include "Protocol.h"
+#include "WriteQueue.h"
 
 class Session
 {
@@ -16,6 +18,13 @@ public:
         EXIT
     };
 
+    struct Stats
+    {
+        std::uint64_t events;   ///< Number of Send() calls with at least one frame
+        std::uint64_t frames;   ///< Number of frames built by Send()
+        std::uint64_t writes;   ///< Number of socket writes, one gather write can carry several events
+    };
+
     explicit Session(INetClientEvent &client);
 
     void Initialize(const std::string &webId, const std::string &key, const std::string &passPhrase);
@@ -25,6 +34,14 @@ public:
     void Disconnect();
     void ConnectToHost(const std::string &hostName, std::uint16_t port);
     void Close();
+    // Compression is negotiated during the handshake, 0 disables it; call before ConnectToHost()
+    void SetDeflateThreshold(std::uint32_t threshold) { mProto.SetDeflateThreshold(threshold); }
+
+    // Outgoing statistics
+    std::uint32_t GetQueueDepth() const { return mWriteQueue.Depth(); }
+    std::uint64_t GetBytesPending() const { return mWriteQueue.BytesPending(); }
+    Stats GetStats() const;
+
 private:
     INetClientEvent &mListener;
 
@@ -39,12 +56,18 @@ private:
     boost::asio::io_context io_context;
     boost::asio::ip::tcp::resolver resolver;
     boost::asio::ip::tcp::socket socket;
+    WriteQueue mWriteQueue; ///< Accessed in the io_context thread only
+    std::atomic<std::uint64_t> mEvents{0U};
+    std::atomic<std::uint64_t> mFrames{0U};
+    std::atomic<std::uint64_t> mWrites{0U};
 
 
     std::string mWebId;
     std::string mPassPhrase;
 
-    void SendToHost(const std::string &data);
+    void SendToHost(std::string &&frame);
+    void SendToHost(std::vector<std::string> &&frames);
+    void StartWrite();
     void Run();
     void ReadHeader();
     void ReadBody();
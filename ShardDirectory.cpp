@@ -0,0 +1,136 @@
+/*=============================================================================
+ * TarotClub - ShardDirectory.cpp
+ *=============================================================================
+ * Location of the users and of the tables among the lobby shards
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include "ShardDirectory.h"
+#include "Lobby.h"
+
+const std::uint32_t LocalShardDirectory::cNoShard;
+
+/*****************************************************************************/
+LocalShardDirectory::LocalShardDirectory(std::uint32_t nbShards, std::uint32_t maxUsers, std::uint32_t maxTables)
+    : mUserIds(Protocol::USERS_UID, Protocol::MAXIMUM_USERS)
+    , mUserShard(Protocol::MAXIMUM_UID + 1U, cNoShard)
+{
+    // Same UUID space as the lobbies of the shards
+    UniqueId tableIds(Protocol::TABLES_UID, Protocol::TABLES_UID);
+    Lobby::GetIdSpaces(maxUsers, maxTables, tableIds, mUserIds);
+
+    for (std::uint32_t i = 0U; i < std::max(nbShards, 1U); i++)
+    {
+        mShards.push_back(Load{i, 0U, 0U, 0U});
+    }
+}
+/*****************************************************************************/
+void LocalShardDirectory::SetShardTables(std::uint32_t shard, std::uint32_t firstTable, std::uint32_t lastTable)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    if (shard < mShards.size())
+    {
+        mShards[shard].firstTable = firstTable;
+        mShards[shard].lastTable = lastTable;
+    }
+}
+/*****************************************************************************/
+std::uint32_t LocalShardDirectory::AddUser(std::uint32_t &shard)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    std::uint32_t uuid = mUserIds.TakeId();
+
+    if (uuid != UniqueId::cInvalidId)
+    {
+        shard = 0U;
+        for (std::uint32_t i = 1U; i < mShards.size(); i++)
+        {
+            if (mShards[i].users < mShards[shard].users)
+            {
+                shard = i;
+            }
+        }
+        mShards[shard].users++;
+        mUserShard[uuid] = shard;
+    }
+    else
+    {
+        uuid = Protocol::INVALID_UID;
+    }
+    return uuid;
+}
+/*****************************************************************************/
+void LocalShardDirectory::MoveUser(std::uint32_t uuid, std::uint32_t shard)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    if ((uuid < mUserShard.size()) && (mUserShard[uuid] != cNoShard) && (shard < mShards.size()))
+    {
+        mShards[mUserShard[uuid]].users--;
+        mShards[shard].users++;
+        mUserShard[uuid] = shard;
+    }
+}
+/*****************************************************************************/
+void LocalShardDirectory::RemoveUser(std::uint32_t uuid)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    if ((uuid < mUserShard.size()) && (mUserShard[uuid] != cNoShard))
+    {
+        mShards[mUserShard[uuid]].users--;
+        mUserShard[uuid] = cNoShard;
+        mUserIds.ReleaseId(uuid);
+    }
+}
+/*****************************************************************************/
+bool LocalShardDirectory::GetUserShard(std::uint32_t uuid, std::uint32_t &shard)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    bool found = (uuid < mUserShard.size()) && (mUserShard[uuid] != cNoShard);
+    if (found)
+    {
+        shard = mUserShard[uuid];
+    }
+    return found;
+}
+/*****************************************************************************/
+bool LocalShardDirectory::GetTableShard(std::uint32_t tableId, std::uint32_t &shard)
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    for (const auto &s : mShards)
+    {
+        if ((s.firstTable != 0U) && (tableId >= s.firstTable) && (tableId <= s.lastTable))
+        {
+            shard = s.shard;
+            return true;
+        }
+    }
+    return false;
+}
+/*****************************************************************************/
+std::vector<IShardDirectory::Load> LocalShardDirectory::GetLoad()
+{
+    std::scoped_lock<std::mutex> lock(mMutex);
+    return mShards;
+}
+
+//=============================================================================
+// End of file ShardDirectory.cpp
+//=============================================================================
@@ -0,0 +1,99 @@
+/*=============================================================================
+ * TarotClub - ShardDirectory.h
+ *=============================================================================
+ * Location of the users and of the tables among the lobby shards
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef SHARD_DIRECTORY_H
+#define SHARD_DIRECTORY_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "UniqueId.h"
+
+/*****************************************************************************/
+/**
+ * @brief The IShardDirectory class
+ *
+ * Shared knowledge of the sharded lobby: which shard owns a table, where a
+ * user is connected. The UUIDs of the users are allocated here, so they are
+ * unique among the shards.
+ */
+class IShardDirectory
+{
+public:
+    struct Load
+    {
+        std::uint32_t shard;
+        std::uint32_t users;
+        std::uint32_t firstTable;   ///< Table IDs of the shard, 0 if not known yet
+        std::uint32_t lastTable;
+    };
+
+    virtual ~IShardDirectory() { /* Nothing to do */ }
+
+    virtual void SetShardTables(std::uint32_t shard, std::uint32_t firstTable, std::uint32_t lastTable) = 0;
+    virtual std::uint32_t AddUser(std::uint32_t &shard) = 0; // New UUID on the least loaded shard, INVALID_UID if full
+    virtual void MoveUser(std::uint32_t uuid, std::uint32_t shard) = 0;
+    virtual void RemoveUser(std::uint32_t uuid) = 0;
+    virtual bool GetUserShard(std::uint32_t uuid, std::uint32_t &shard) = 0;
+    virtual bool GetTableShard(std::uint32_t tableId, std::uint32_t &shard) = 0;
+    virtual std::vector<Load> GetLoad() = 0;
+};
+
+/*****************************************************************************/
+/**
+ * @brief The LocalShardDirectory class
+ *
+ * Directory held in the memory of the front-end: enough when all the shards
+ * are served by this front-end. Several front-ends would share one through
+ * an external store implementing the same interface.
+ */
+class LocalShardDirectory : public IShardDirectory
+{
+public:
+    LocalShardDirectory(std::uint32_t nbShards, std::uint32_t maxUsers, std::uint32_t maxTables);
+
+    // From IShardDirectory
+    void SetShardTables(std::uint32_t shard, std::uint32_t firstTable, std::uint32_t lastTable) override;
+    std::uint32_t AddUser(std::uint32_t &shard) override;
+    void MoveUser(std::uint32_t uuid, std::uint32_t shard) override;
+    void RemoveUser(std::uint32_t uuid) override;
+    bool GetUserShard(std::uint32_t uuid, std::uint32_t &shard) override;
+    bool GetTableShard(std::uint32_t tableId, std::uint32_t &shard) override;
+    std::vector<Load> GetLoad() override;
+
+private:
+    static const std::uint32_t cNoShard = 0xFFFFFFFFU;
+
+    std::mutex mMutex;
+    UniqueId mUserIds;
+    std::vector<Load> mShards;
+    std::vector<std::uint32_t> mUserShard; ///< Indexed by UUID
+};
+
+#endif // SHARD_DIRECTORY_H
+
+//=============================================================================
+// End of file ShardDirectory.h
+//=============================================================================
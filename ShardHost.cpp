@@ -0,0 +1,222 @@
+/*=============================================================================
+ * TarotClub - ShardHost.cpp
+ *=============================================================================
+ * One lobby shard: a lobby process served by the lobby front-end
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cstdio>
+#include "ShardHost.h"
+#include "Log.h"
+
+using namespace boost;
+
+/*****************************************************************************/
+/**
+ * @brief The ShardPeer class
+ *
+ * Player connected to the front-end: its messages are sent through the link,
+ * the front-end queues and ciphers them for the real connection.
+ */
+class ShardPeer : public Peer
+{
+public:
+    ShardPeer(const ShardLinkPtr &link, std::uint32_t uuid)
+        : mLink(link)
+        , mUuid(uuid)
+    {
+
+    }
+
+    void Deliver(const std::string &data, std::uint32_t key) override
+    {
+        mLink->Send(ShardLink::DELIVER, mUuid, key, data);
+    }
+
+    // The outgoing queue is in the front-end
+    Stats GetStats() const override
+    {
+        Stats stats = {};
+        stats.uuid = mUuid;
+        return stats;
+    }
+
+private:
+    ShardLinkPtr mLink;
+    std::uint32_t mUuid;
+};
+
+/*****************************************************************************/
+ShardHost::ShardHost(asio::io_context &ioc, ServerOptions &options, std::uint32_t index)
+    : mOptions(options)
+    , mIndex(index)
+    , mLobby(std::make_shared<Lobby>())
+    , mWorkers(options.worker_threads > 0U ? options.worker_threads : std::max(1U, std::thread::hardware_concurrency()))
+    , mLobbyStrand(asio::make_strand(mWorkers))
+    , mAcceptor(ioc)
+{
+    Server::SetupLobby(*mLobby, options, mWorkers);
+    mLobby->SetShard(index, std::max(options.shards, 1U));
+    mLobby->CreateTable("Local game " + std::to_string(index + 1U));
+}
+/*****************************************************************************/
+ShardHost::~ShardHost()
+{
+    Stop();
+    mWorkers.join();
+}
+/*****************************************************************************/
+std::string ShardHost::SocketPath(const ServerOptions &options, std::uint32_t index)
+{
+    return options.shard_socket + "." + std::to_string(index + 1U);
+}
+/*****************************************************************************/
+bool ShardHost::Start()
+{
+    std::string path = SocketPath(mOptions, mIndex);
+    boost::system::error_code ec;
+
+    // Socket file left by a previous process
+    std::remove(path.c_str());
+    mAcceptor.open(asio::local::stream_protocol(), ec);
+    if (!ec)
+    {
+        mAcceptor.bind(asio::local::stream_protocol::endpoint(path), ec);
+    }
+    if (!ec)
+    {
+        mAcceptor.listen(asio::socket_base::max_listen_connections, ec);
+    }
+
+    if (ec)
+    {
+        TLogError("[SHARD] Cannot listen on " + path + ": " + ec.message());
+        return false;
+    }
+
+    TLogInfo("[SHARD] Shard " + std::to_string(mIndex + 1U) + " listening on " + path);
+    Accept();
+    return true;
+}
+/*****************************************************************************/
+void ShardHost::Stop()
+{
+    boost::system::error_code ignored;
+    mAcceptor.close(ignored);
+    if (mLink)
+    {
+        mLink->Close();
+    }
+}
+/*****************************************************************************/
+void ShardHost::Accept()
+{
+    mAcceptor.async_accept([this](const boost::system::error_code &ec, asio::local::stream_protocol::socket socket)
+    {
+        if (ec)
+        {
+            return;
+        }
+
+        if (mLink)
+        {
+            TLogError("[SHARD] New front-end, the previous one is disconnected");
+            mLink->Close();
+        }
+
+        auto link = std::make_shared<ShardLink>(std::move(socket));
+        mLink = link;
+        link->Start([this, link](ShardLink::Frame &frame) { Received(link, frame); },
+                    [this, link]()
+        {
+            // The players of this front-end are gone
+            asio::post(mLobbyStrand, [this, link]()
+            {
+                for (auto it = mUsers.begin(); it != mUsers.end();)
+                {
+                    if (it->second == link)
+                    {
+                        mLobby->RemoveUser(it->first);
+                        it = mUsers.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            });
+        });
+
+        std::uint32_t first;
+        std::uint32_t last;
+        mLobby->GetTableRange(first, last);
+        link->Send(ShardLink::HELLO, first, last);
+
+        Accept();
+    });
+}
+/*****************************************************************************/
+void ShardHost::Received(const ShardLinkPtr &link, ShardLink::Frame &frame)
+{
+    // Same order as sent by the front-end
+    switch (frame.type)
+    {
+    case ShardLink::USER_ADD:
+        asio::post(mLobbyStrand, [this, link, uuid = frame.uuid]()
+        {
+            if (mLobby->AddUser(std::make_shared<ShardPeer>(link, uuid), uuid) != Protocol::INVALID_UID)
+            {
+                mUsers[uuid] = link;
+            }
+        });
+        break;
+
+    case ShardLink::USER_REMOVE:
+        asio::post(mLobbyStrand, [this, link, uuid = frame.uuid]()
+        {
+            mLobby->RemoveUser(uuid);
+            mUsers.erase(uuid);
+            link->Send(ShardLink::USER_REMOVED, uuid, 0U);
+        });
+        break;
+
+    case ShardLink::REQUEST:
+    {
+        Request req;
+        req.src_uuid = frame.uuid;
+        req.dest_uuid = frame.arg;
+        req.arg = std::move(frame.payload);
+        asio::post(mLobbyStrand, [lobby = mLobby, req = std::move(req)]()
+        {
+            lobby->Deliver(req);
+        });
+        break;
+    }
+
+    default:
+        TLogError("[SHARD] Unexpected frame type " + std::to_string(frame.type));
+        break;
+    }
+}
+
+//=============================================================================
+// End of file ShardHost.cpp
+//=============================================================================
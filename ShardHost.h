@@ -0,0 +1,79 @@
+/*=============================================================================
+ * TarotClub - ShardHost.h
+ *=============================================================================
+ * One lobby shard: a lobby process served by the lobby front-end
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef SHARD_HOST_H
+#define SHARD_HOST_H
+
+#include <memory>
+#include <unordered_map>
+#include <boost/asio.hpp>
+#include "Server.h"
+#include "ShardLink.h"
+
+/*****************************************************************************/
+/**
+ * @brief The ShardHost class
+ *
+ * Runs a lobby with its part of the tables and listens to the front-end on a
+ * Unix domain socket (ServerOptions::shard_socket + "." + index). The players
+ * are the ones the front-end adds; their requests are executed in order, as
+ * in the Server, and the messages for them go back through the link.
+ *
+ * Usage, in the process of shard i:
+ *   asio::io_context ioc;
+ *   ShardHost host(ioc, options, i);
+ *   if (host.Start()) { ioc.run(); }
+ */
+class ShardHost
+{
+public:
+    ShardHost(boost::asio::io_context &ioc, ServerOptions &options, std::uint32_t index);
+    ~ShardHost();
+
+    bool Start();
+    void Stop();
+    std::shared_ptr<Lobby> GetLobby() { return mLobby; }
+
+    static std::string SocketPath(const ServerOptions &options, std::uint32_t index);
+
+private:
+    ServerOptions &mOptions;
+    std::uint32_t mIndex;
+    std::shared_ptr<Lobby> mLobby;
+    boost::asio::thread_pool mWorkers;
+    PoolStrand mLobbyStrand;
+    boost::asio::local::stream_protocol::acceptor mAcceptor;
+    ShardLinkPtr mLink;     ///< Front-end currently connected
+    std::unordered_map<std::uint32_t, ShardLinkPtr> mUsers; ///< Players and their front-end, in the lobby strand
+
+    void Accept();
+    void Received(const ShardLinkPtr &link, ShardLink::Frame &frame);
+};
+
+#endif // SHARD_HOST_H
+
+//=============================================================================
+// End of file ShardHost.h
+//=============================================================================
@@ -0,0 +1,379 @@
+/*=============================================================================
+ * TarotClub - ShardLink.cpp
+ *=============================================================================
+ * Local connection between the lobby front-end and one lobby shard
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cstring>
+#include "ShardLink.h"
+#include "Log.h"
+
+using namespace boost;
+
+const std::uint32_t ShardLink::cHeaderSize;
+const std::uint32_t ShardLink::cMaxPayload;
+const std::uint32_t ShardLink::cRetryDelay;
+const std::uint32_t ShardLink::cMaxPending;
+
+/*****************************************************************************/
+// Both ends are on the same machine: the integers are in the host byte order
+static void PutU32(char *p, std::uint32_t value)
+{
+    std::memcpy(p, &value, sizeof(value));
+}
+/*****************************************************************************/
+static std::uint32_t GetU32(const char *p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+/*****************************************************************************/
+ShardLink::ShardLink(asio::io_context &ioc)
+    : mSocket(ioc)
+    , mStrand(asio::make_strand(mSocket.get_executor()))
+    , mRetry(ioc)
+{
+
+}
+/*****************************************************************************/
+ShardLink::ShardLink(asio::local::stream_protocol::socket socket)
+    : mSocket(std::move(socket))
+    , mStrand(asio::make_strand(mSocket.get_executor()))
+    , mRetry(mSocket.get_executor())
+{
+
+}
+/*****************************************************************************/
+void ShardLink::Connect(const std::string &path, const Handler &handler, const ClosedHandler &closed)
+{
+    mPath = path;
+    mHandler = handler;
+    mClosed = closed;
+    asio::post(mStrand, [self = shared_from_this()]() { self->DoConnect(); });
+}
+/*****************************************************************************/
+void ShardLink::Start(const Handler &handler, const ClosedHandler &closed)
+{
+    mHandler = handler;
+    mClosed = closed;
+    asio::post(mStrand, [self = shared_from_this()]() { self->Connected(); });
+}
+/*****************************************************************************/
+void ShardLink::DoConnect()
+{
+    auto self = shared_from_this();
+    mSocket.async_connect(asio::local::stream_protocol::endpoint(mPath), asio::bind_executor(mStrand,
+                          [self](const boost::system::error_code &ec)
+    {
+        if (!ec)
+        {
+            TLogInfo("[SHARD] Connected to " + self->mPath);
+            self->Connected();
+        }
+        else if (!self->mStopped)
+        {
+            // The shard is not listening yet
+            boost::system::error_code ignored;
+            self->mSocket.close(ignored);
+            self->mRetry.expires_after(std::chrono::milliseconds(cRetryDelay));
+            self->mRetry.async_wait(asio::bind_executor(self->mStrand, [self](const boost::system::error_code &ec)
+            {
+                if (!ec && !self->mStopped)
+                {
+                    self->DoConnect();
+                }
+            }));
+        }
+    }));
+}
+/*****************************************************************************/
+void ShardLink::Connected()
+{
+    mGeneration++;
+    mRxSize = 0U;
+    // Frames dropped before the connection: the owner must know it first
+    Overflowed();
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mConnected = true;
+        if (!mPending.empty() && !mWriteActive)
+        {
+            mWriteActive = true;
+            asio::post(mStrand, [self = shared_from_this()]() { self->StartWrite(); });
+        }
+    }
+    DoRead();
+}
+/*****************************************************************************/
+void ShardLink::Send(std::uint8_t type, std::uint32_t uuid, std::uint32_t arg, const std::string &payload)
+{
+    char header[cHeaderSize];
+
+    PutU32(&header[0], static_cast<std::uint32_t>(payload.size()));
+    header[4] = static_cast<char>(type);
+    PutU32(&header[5], uuid);
+    PutU32(&header[9], arg);
+
+    std::scoped_lock<std::mutex> lock(mMutex);
+    if (mStopped)
+    {
+        return;
+    }
+    if (!mConnected && (mOverflow || ((mPending.size() + cHeaderSize + payload.size()) > cMaxPending)))
+    {
+        mDropped++;
+        if (!mOverflow)
+        {
+            mOverflow = true;
+            asio::post(mStrand, [self = shared_from_this()]() { self->Overflowed(); });
+        }
+        return;
+    }
+    mPending.append(header, cHeaderSize);
+    mPending.append(payload);
+    mFramesSent++;
+
+    if (mConnected && !mWriteActive)
+    {
+        mWriteActive = true;
+        asio::post(mStrand, [self = shared_from_this()]() { self->StartWrite(); });
+    }
+}
+/*****************************************************************************/
+void ShardLink::StartWrite()
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mPending.empty() || !mConnected)
+        {
+            mWriteActive = false;
+            return;
+        }
+        // The buffers are swapped, both keep their capacity
+        mWriting.clear();
+        mWriting.swap(mPending);
+    }
+
+    mWrites++;
+    auto self = shared_from_this();
+    asio::async_write(mSocket, asio::buffer(mWriting), asio::bind_executor(mStrand,
+                      [self, gen = mGeneration](const boost::system::error_code &ec, std::size_t length)
+    {
+        if (gen != self->mGeneration)
+        {
+            // Write of a previous connection
+        }
+        else if (!ec)
+        {
+            self->mBytesSent += length;
+            self->StartWrite();
+        }
+        else
+        {
+            TLogError("[SHARD] Write error on the link: " + ec.message());
+            self->Failed();
+        }
+    }));
+}
+/*****************************************************************************/
+void ShardLink::DoRead()
+{
+    static const std::size_t cReadChunkSize = 64U * 1024U;
+
+    if (mRxBuffer.size() < (mRxSize + cReadChunkSize))
+    {
+        mRxBuffer.resize(mRxSize + cReadChunkSize);
+    }
+
+    auto self = shared_from_this();
+    mSocket.async_read_some(asio::buffer(&mRxBuffer[mRxSize], cReadChunkSize), asio::bind_executor(mStrand,
+                            [self, gen = mGeneration](const boost::system::error_code &ec, std::size_t length)
+    {
+        if (gen != self->mGeneration)
+        {
+            // Read of a previous connection
+        }
+        else if (!ec)
+        {
+            self->mRxSize += length;
+            self->mBytesReceived += length;
+            if (self->ParseFrames())
+            {
+                self->DoRead();
+            }
+            else
+            {
+                TLogError("[SHARD] Bad frame on the link");
+                self->Failed();
+            }
+        }
+        else
+        {
+            if (ec != asio::error::operation_aborted)
+            {
+                TLogNetwork("[SHARD] Link closed: " + ec.message());
+            }
+            self->Failed();
+        }
+    }));
+}
+/*****************************************************************************/
+/**
+ * @brief ShardLink::ParseFrames
+ *
+ * Gives all the complete frames to the handler, a partial frame is moved at
+ * the beginning of the buffer
+ *
+ * @return false if a frame is invalid
+ */
+bool ShardLink::ParseFrames()
+{
+    std::size_t pos = 0U;
+    Frame frame;
+
+    while ((mRxSize - pos) >= cHeaderSize)
+    {
+        const char *p = &mRxBuffer[pos];
+        std::uint32_t size = GetU32(p);
+        if (size > cMaxPayload)
+        {
+            return false;
+        }
+        if ((mRxSize - pos) < (cHeaderSize + size))
+        {
+            break;
+        }
+
+        frame.type = static_cast<std::uint8_t>(p[4]);
+        frame.uuid = GetU32(p + 5);
+        frame.arg = GetU32(p + 9);
+        frame.payload.assign(p + cHeaderSize, size);
+        pos += cHeaderSize + size;
+        mFramesReceived++;
+        mHandler(frame);
+    }
+
+    if (pos > 0U)
+    {
+        std::memmove(&mRxBuffer[0], &mRxBuffer[pos], mRxSize - pos);
+        mRxSize -= pos;
+    }
+    return true;
+}
+/*****************************************************************************/
+void ShardLink::Failed()
+{
+    bool wasConnected;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        wasConnected = mConnected;
+        if (wasConnected)
+        {
+            mConnected = false;
+            mWriteActive = false;
+            // What was not written is lost with the state of the peer process;
+            // the frames queued afterwards are for the next connection
+            mPending.clear();
+        }
+    }
+
+    if (wasConnected)
+    {
+        // The aborted handlers of this connection must not close the next one
+        mGeneration++;
+        boost::system::error_code ignored;
+        mSocket.close(ignored);
+        if (mClosed)
+        {
+            mClosed();
+        }
+
+        // Front-end side: waits for the shard to come back
+        if (!mPath.empty() && !mStopped)
+        {
+            DoConnect();
+        }
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief ShardLink::Overflowed
+ *
+ * The shard is away for too long: the frames waiting for it are dropped, and
+ * the owner is told that the state of its peers on the shard is lost
+ */
+void ShardLink::Overflowed()
+{
+    std::size_t size;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mOverflow)
+        {
+            // Already done
+            return;
+        }
+        mOverflow = false;
+        size = mPending.size();
+        mPending.clear();
+    }
+
+    TLogError("[SHARD] No connection to " + mPath + ", " + std::to_string(size / 1024U) + " KB of frames dropped");
+    if (mClosed)
+    {
+        mClosed();
+    }
+}
+/*****************************************************************************/
+void ShardLink::Close()
+{
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    asio::post(mStrand, [self = shared_from_this()]()
+    {
+        boost::system::error_code ignored;
+        self->mRetry.cancel();
+        self->mSocket.close(ignored);
+    });
+}
+/*****************************************************************************/
+ShardLink::Stats ShardLink::GetStats() const
+{
+    Stats stats;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        stats.connected = mConnected;
+    }
+    stats.framesSent = mFramesSent;
+    stats.framesReceived = mFramesReceived;
+    stats.bytesSent = mBytesSent;
+    stats.bytesReceived = mBytesReceived;
+    stats.writes = mWrites;
+    stats.dropped = mDropped;
+    return stats;
+}
+
+//=============================================================================
+// End of file ShardLink.cpp
+//=============================================================================
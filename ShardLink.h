@@ -0,0 +1,147 @@
+/*=============================================================================
+ * TarotClub - ShardLink.h
+ *=============================================================================
+ * Local connection between the lobby front-end and one lobby shard
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef SHARD_LINK_H
+#define SHARD_LINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <boost/asio.hpp>
+
+/*****************************************************************************/
+/**
+ * @brief The ShardLink class
+ *
+ * Unix domain socket between the front-end and a shard, both on the same
+ * machine. The messages are already deciphered and are not ciphered again:
+ * a frame is a fixed header (size, type, uuid, argument) and the raw JSON.
+ *
+ * Send() can be called from any thread; the frames sent during a write are
+ * grouped in the next one, so a busy link makes few system calls.
+ *
+ * The front-end side connects with Connect() and retries until the shard is
+ * listening, also after a loss of the connection; the frames sent meanwhile
+ * wait in the link, up to cMaxPending bytes. Beyond, they are dropped and the
+ * link reports a loss of the connection, as if the shard had gone again.
+ * The shard side wraps the accepted socket and calls Start().
+ */
+class ShardLink : public std::enable_shared_from_this<ShardLink>
+{
+public:
+    enum Type : std::uint8_t
+    {
+        HELLO = 1U,     ///< Shard --> front-end: table IDs of the shard (uuid: first, arg: last)
+        USER_ADD,       ///< Front-end --> shard: a peer is connected (uuid)
+        USER_REMOVE,    ///< Front-end --> shard: the peer has left or goes to another shard (uuid)
+        USER_REMOVED,   ///< Shard --> front-end: no more message for this user after this one (uuid)
+        REQUEST,        ///< Front-end --> shard: request of a peer (uuid: source, arg: destination)
+        DELIVER         ///< Shard --> front-end: message for a peer (uuid: destination, arg: Peer key)
+    };
+
+    struct Frame
+    {
+        std::uint8_t type;
+        std::uint32_t uuid;
+        std::uint32_t arg;
+        std::string payload;
+    };
+
+    struct Stats
+    {
+        bool connected;
+        std::uint64_t framesSent;
+        std::uint64_t framesReceived;
+        std::uint64_t bytesSent;
+        std::uint64_t bytesReceived;
+        std::uint64_t writes;       ///< Socket writes, each one groups several frames
+        std::uint64_t dropped;      ///< Frames dropped while the shard was away too long
+    };
+
+    typedef std::function<void (Frame &frame)> Handler;
+    typedef std::function<void ()> ClosedHandler;
+
+    static const std::uint32_t cHeaderSize = 13U;
+    static const std::uint32_t cMaxPayload = 1024U * 1024U;
+    static const std::uint32_t cRetryDelay = 100U; ///< Milliseconds between two connection attempts
+    static const std::uint32_t cMaxPending = 16U * 1024U * 1024U; ///< Bytes waiting for the connection
+
+    explicit ShardLink(boost::asio::io_context &ioc);
+    explicit ShardLink(boost::asio::local::stream_protocol::socket socket);
+
+    void Connect(const std::string &path, const Handler &handler, const ClosedHandler &closed);
+    void Start(const Handler &handler, const ClosedHandler &closed);
+    void Send(std::uint8_t type, std::uint32_t uuid, std::uint32_t arg, const std::string &payload = std::string());
+    void Close();
+    Stats GetStats() const;
+
+private:
+    boost::asio::local::stream_protocol::socket mSocket;
+    boost::asio::strand<boost::asio::local::stream_protocol::socket::executor_type> mStrand;
+    boost::asio::steady_timer mRetry;
+    std::string mPath;
+    Handler mHandler;
+    ClosedHandler mClosed;
+
+    // In the strand
+    std::uint32_t mGeneration = 0U; ///< Connection number, the handlers of a closed connection are ignored
+    std::string mRxBuffer;
+    std::size_t mRxSize = 0U;
+
+    // Emission
+    mutable std::mutex mMutex;
+    std::string mPending;       ///< Frames not yet given to the socket
+    std::string mWriting;       ///< Frames of the write in flight, in the strand
+    bool mWriteActive = false;
+    bool mConnected = false;
+    bool mOverflow = false;     ///< Too many frames while disconnected, the next ones are dropped
+    std::atomic<bool> mStopped{false}; ///< Also read in the strand without the mutex
+
+    std::atomic<std::uint64_t> mFramesSent{0U};
+    std::atomic<std::uint64_t> mFramesReceived{0U};
+    std::atomic<std::uint64_t> mBytesSent{0U};
+    std::atomic<std::uint64_t> mBytesReceived{0U};
+    std::atomic<std::uint64_t> mWrites{0U};
+    std::atomic<std::uint64_t> mDropped{0U};
+
+    void DoConnect();
+    void Connected();
+    void DoRead();
+    bool ParseFrames();
+    void StartWrite();
+    void Failed();
+    void Overflowed();
+};
+
+typedef std::shared_ptr<ShardLink> ShardLinkPtr;
+
+#endif // SHARD_LINK_H
+
+//=============================================================================
+// End of file ShardLink.h
+//=============================================================================
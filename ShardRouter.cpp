@@ -0,0 +1,349 @@
+/*=============================================================================
+ * TarotClub - ShardRouter.cpp
+ *=============================================================================
+ * Lobby front-end: routes the players to the lobby shards
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <sstream>
+#include "ShardRouter.h"
+#include "JsonReader.h"
+#include "Log.h"
+
+/*****************************************************************************/
+ShardRouter::ShardRouter(std::shared_ptr<IShardDirectory> directory)
+    : mDirectory(directory)
+    , mRoutes(Protocol::MAXIMUM_UID + 1U)
+{
+
+}
+/*****************************************************************************/
+ShardRouter::~ShardRouter()
+{
+    Stop();
+}
+/*****************************************************************************/
+void ShardRouter::AddShard(boost::asio::io_context &ioc, const std::string &path)
+{
+    std::uint32_t shard = static_cast<std::uint32_t>(mLinks.size());
+    auto link = std::make_shared<ShardLink>(ioc);
+
+    mLinks.push_back(link);
+    link->Connect(path,
+                  [this, shard](ShardLink::Frame &frame) { Received(shard, frame); },
+                  [this, shard]() { Lost(shard); });
+}
+/*****************************************************************************/
+void ShardRouter::Stop()
+{
+    for (auto &link : mLinks)
+    {
+        link->Close();
+    }
+}
+/*****************************************************************************/
+std::uint32_t ShardRouter::AddUser(PeerPtr peer)
+{
+    std::uint32_t shard;
+    std::uint32_t uuid = mDirectory->AddUser(shard);
+
+    if ((uuid != Protocol::INVALID_UID) && (shard < mLinks.size()))
+    {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            Route &route = mRoutes[uuid];
+            route.peer = peer;
+            route.shard = shard;
+            route.login.clear();
+        }
+        mLinks[shard]->Send(ShardLink::USER_ADD, uuid, 0U);
+    }
+    else
+    {
+        TLogError("[ROUTER] Cannot add user: maximum number of users reached.");
+        uuid = Protocol::INVALID_UID;
+    }
+    return uuid;
+}
+/*****************************************************************************/
+/**
+ * @brief ShardRouter::RemoveUser
+ *
+ * The UUID is freed in the directory when the shard has confirmed the removal,
+ * or immediately if the shard of the player has been lost
+ */
+void ShardRouter::RemoveUser(std::uint32_t uuid)
+{
+    std::uint32_t shard = cNoShard;
+    bool release = false;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if ((uuid >= mRoutes.size()) || !mRoutes[uuid].peer)
+        {
+            // Already removed
+            return;
+        }
+        Route &route = mRoutes[uuid];
+        route.peer.reset();
+        route.login.clear();
+        shard = route.shard;
+        release = (shard == cNoShard);
+    }
+
+    if (release)
+    {
+        mDirectory->RemoveUser(uuid);
+    }
+    else if (shard < mLinks.size())
+    {
+        mLinks[shard]->Send(ShardLink::USER_REMOVE, uuid, 0U);
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief ShardRouter::Deliver
+ *
+ * Called in the order of the requests (lobby strand). Only the messages sent
+ * to the lobby are looked at: the login is kept, the table join may move the
+ * player to another shard.
+ */
+bool ShardRouter::Deliver(const Request &req)
+{
+    std::uint32_t shard = cNoShard;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if ((req.src_uuid < mRoutes.size()) && mRoutes[req.src_uuid].peer)
+        {
+            shard = mRoutes[req.src_uuid].shard;
+        }
+    }
+
+    if (shard >= mLinks.size())
+    {
+        TLogNetwork("[ROUTER] Request of an unknown user");
+        return false;
+    }
+
+    if (req.dest_uuid == Protocol::LOBBY_UID)
+    {
+        std::string type = Protocol::MessageType(req.arg.data(), req.arg.size());
+        if (type == "ReplyLogin")
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mRoutes[req.src_uuid].login = req.arg;
+        }
+        else if (type == "RequestJoinTable")
+        {
+            JsonValue json;
+            JsonReader reader;
+            std::uint32_t target;
+
+            if (reader.ParseString(json, req.arg) &&
+                mDirectory->GetTableShard(json.FindValue("table_id").GetInteger(), target) &&
+                (target != shard) &&
+                Move(req.src_uuid, shard, target))
+            {
+                shard = target;
+            }
+        }
+    }
+
+    mRequests++;
+    mLinks[shard]->Send(ShardLink::REQUEST, req.src_uuid, req.dest_uuid, req.arg);
+    return true;
+}
+/*****************************************************************************/
+/**
+ * @brief ShardRouter::Move
+ *
+ * The player leaves its shard and logs in again in the other one; both links
+ * keep the order, so the next requests arrive after the login.
+ *
+ * @return false if the player has not logged in yet
+ */
+bool ShardRouter::Move(std::uint32_t uuid, std::uint32_t from, std::uint32_t to)
+{
+    std::string login;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        Route &route = mRoutes[uuid];
+        if (route.login.empty())
+        {
+            return false;
+        }
+        // From now on, the messages of the old shard are dropped
+        route.shard = to;
+        login = route.login;
+    }
+
+    mLinks[from]->Send(ShardLink::USER_REMOVE, uuid, 0U);
+    mDirectory->MoveUser(uuid, to);
+    mLinks[to]->Send(ShardLink::USER_ADD, uuid, 0U);
+    mLinks[to]->Send(ShardLink::REQUEST, uuid, Protocol::LOBBY_UID, login);
+    mMoves++;
+    return true;
+}
+/*****************************************************************************/
+void ShardRouter::Received(std::uint32_t shard, ShardLink::Frame &frame)
+{
+    if (frame.type == ShardLink::DELIVER)
+    {
+        PeerPtr peer;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            if (frame.uuid < mRoutes.size())
+            {
+                Route &route = mRoutes[frame.uuid];
+                if (route.shard == shard)
+                {
+                    peer = route.peer;
+                }
+            }
+        }
+
+        if (peer)
+        {
+            mDelivered++;
+            peer->Deliver(frame.payload, frame.arg);
+        }
+        else
+        {
+            mStale++;
+        }
+    }
+    else if (frame.type == ShardLink::USER_REMOVED)
+    {
+        bool release = false;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            if (frame.uuid < mRoutes.size())
+            {
+                Route &route = mRoutes[frame.uuid];
+                // Ignored if the player has only moved to another shard
+                if (!route.peer && (route.shard == shard))
+                {
+                    route.shard = cNoShard;
+                    release = true;
+                }
+            }
+        }
+
+        if (release)
+        {
+            mDirectory->RemoveUser(frame.uuid);
+        }
+    }
+    else if (frame.type == ShardLink::HELLO)
+    {
+        TLogInfo("[ROUTER] Shard " + std::to_string(shard + 1U) + " hosts the tables " +
+                 std::to_string(frame.uuid) + " to " + std::to_string(frame.arg));
+        mDirectory->SetShardTables(shard, frame.uuid, frame.arg);
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief ShardRouter::Lost
+ *
+ * The shard process has gone with the state of its players: their
+ * connections are closed, their next requests are refused. The UUID of a
+ * connected player stays taken until its session calls RemoveUser(), so
+ * that it cannot be given to a new player meanwhile. The link reconnects by
+ * itself to the new process.
+ */
+void ShardRouter::Lost(std::uint32_t shard)
+{
+    std::vector<std::uint32_t> released;
+    std::vector<PeerPtr> peers;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        for (std::uint32_t uuid = 0U; uuid < mRoutes.size(); uuid++)
+        {
+            Route &route = mRoutes[uuid];
+            if (route.shard == shard)
+            {
+                route.login.clear();
+                route.shard = cNoShard;
+                if (route.peer)
+                {
+                    peers.push_back(route.peer);
+                }
+                else
+                {
+                    // Removal not confirmed by the shard, it will never be
+                    released.push_back(uuid);
+                }
+            }
+        }
+    }
+
+    for (auto uuid : released)
+    {
+        mDirectory->RemoveUser(uuid);
+    }
+    for (auto &peer : peers)
+    {
+        peer->Disconnect();
+    }
+    TLogError("[ROUTER] Connection lost with the shard " + std::to_string(shard + 1U) + ", " +
+              std::to_string(peers.size()) + " players disconnected");
+}
+/*****************************************************************************/
+ShardRouter::Stats ShardRouter::GetStats()
+{
+    Stats stats;
+
+    stats.requests = mRequests;
+    stats.delivered = mDelivered;
+    stats.stale = mStale;
+    stats.moves = mMoves;
+    stats.load = mDirectory->GetLoad();
+    for (auto &link : mLinks)
+    {
+        stats.links.push_back(link->GetStats());
+    }
+    return stats;
+}
+/*****************************************************************************/
+std::string ShardRouter::Stats::ToString() const
+{
+    std::stringstream ss;
+
+    ss << "Router: " << requests << " requests, " << delivered << " messages delivered, "
+       << stale << " stale, " << moves << " players moved\n";
+    for (std::uint32_t i = 0U; i < load.size(); i++)
+    {
+        ss << "Shard " << (i + 1U) << ": " << load[i].users << " players, tables " << load[i].firstTable << "-" << load[i].lastTable;
+        if (i < links.size())
+        {
+            const ShardLink::Stats &l = links[i];
+            ss << (l.connected ? ", connected" : ", not connected")
+               << ", frames out/in " << l.framesSent << "/" << l.framesReceived
+               << ", KB out/in " << l.bytesSent / 1024U << "/" << l.bytesReceived / 1024U
+               << ", writes " << l.writes << ", dropped " << l.dropped;
+        }
+        ss << "\n";
+    }
+    return ss.str();
+}
+
+//=============================================================================
+// End of file ShardRouter.cpp
+//=============================================================================
@@ -0,0 +1,119 @@
+/*=============================================================================
+ * TarotClub - ShardRouter.h
+ *=============================================================================
+ * Lobby front-end: routes the players to the lobby shards
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef SHARD_ROUTER_H
+#define SHARD_ROUTER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ILobbyGateway.h"
+#include "ShardDirectory.h"
+#include "ShardLink.h"
+
+/*****************************************************************************/
+/**
+ * @brief The ShardRouter class
+ *
+ * Game side of the front-end process in the sharded mode. The front-end does
+ * the network part (connections, handshake, ciphering); each shard is a
+ * process with its own lobby and a part of the tables (see ShardHost).
+ *
+ * A player is connected to one shard at a time, chosen by the directory
+ * (least loaded). All its requests go there, and it only sees the players
+ * and the tables of that shard. When it asks to join a table of another
+ * shard, it is moved: removed from its shard, added to the other one with
+ * the same UUID and logged in again with its last login message (it receives
+ * a new AccessGranted), then the join request follows.
+ *
+ * The messages of a shard for a player who has left it are dropped. The UUID
+ * of a player is freed when its shard confirms the removal, so a new player
+ * never receives the messages of the previous owner of the UUID. If a shard
+ * is lost, its players are disconnected and their UUIDs are freed when their
+ * sessions are removed.
+ */
+class ShardRouter : public ILobbyGateway
+{
+public:
+    struct Stats
+    {
+        std::uint64_t requests;     ///< Requests of the players sent to the shards
+        std::uint64_t delivered;    ///< Messages of the shards given to the players
+        std::uint64_t stale;        ///< Messages for a player no more on this shard, dropped
+        std::uint64_t moves;        ///< Players moved to the shard of their table
+        std::vector<IShardDirectory::Load> load;
+        std::vector<ShardLink::Stats> links;
+
+        std::string ToString() const;
+    };
+
+    explicit ShardRouter(std::shared_ptr<IShardDirectory> directory);
+    ~ShardRouter();
+
+    void AddShard(boost::asio::io_context &ioc, const std::string &path); // Shard index: call order
+    void Stop();
+    Stats GetStats();
+
+    // From ILobbyGateway
+    std::uint32_t AddUser(PeerPtr peer) override;
+    void RemoveUser(std::uint32_t uuid) override;
+    bool Deliver(const Request &req) override;
+    CredentialStore &GetCredentials() override { return mAllowedClients; }
+
+private:
+    static const std::uint32_t cNoShard = 0xFFFFFFFFU;
+
+    struct Route
+    {
+        PeerPtr peer;           ///< Null once the player has left
+        std::uint32_t shard = cNoShard;
+        std::string login;      ///< Last ReplyLogin, sent again when the player changes of shard
+    };
+
+    std::shared_ptr<IShardDirectory> mDirectory;
+    std::vector<ShardLinkPtr> mLinks;
+
+    std::mutex mMutex;
+    std::vector<Route> mRoutes; ///< Indexed by UUID
+
+    CredentialStore mAllowedClients;
+
+    std::atomic<std::uint64_t> mRequests{0U};
+    std::atomic<std::uint64_t> mDelivered{0U};
+    std::atomic<std::uint64_t> mStale{0U};
+    std::atomic<std::uint64_t> mMoves{0U};
+
+    void Received(std::uint32_t shard, ShardLink::Frame &frame);
+    void Lost(std::uint32_t shard);
+    bool Move(std::uint32_t uuid, std::uint32_t from, std::uint32_t to);
+};
+
+#endif // SHARD_ROUTER_H
+
+//=============================================================================
+// End of file ShardRouter.h
+//=============================================================================
@@ -0,0 +1,153 @@
+/*=============================================================================
+ * TarotClub - TableActor.cpp
+ *=============================================================================
+ * Serialized execution of the requests of one playing table
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include "TableActor.h"
+
+/*****************************************************************************/
+TableActor::TableActor(std::unique_ptr<PlayingTable> table, const Executor &executor, const Recycler &recycler)
+    : mTable(std::move(table))
+    , mExecutor(executor)
+    , mRecycler(recycler)
+    , mId(mTable->GetId())
+    , mName(mTable->GetName())
+    , mScheduled(false)
+    , mProcessed(0U)
+    , mTotalLatencyUs(0U)
+    , mMaxLatencyUs(0U)
+{
+
+}
+/*****************************************************************************/
+TableActor::~TableActor()
+{
+    if (mRecycler)
+    {
+        mRecycler(std::move(mTable));
+    }
+}
+/*****************************************************************************/
+void TableActor::Post(const Message &msg)
+{
+    bool schedule = false;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mMailbox.push_back(Entry{msg, std::chrono::steady_clock::now()});
+        if (!mScheduled)
+        {
+            mScheduled = true;
+            schedule = true;
+        }
+    }
+
+    if (schedule)
+    {
+        Schedule();
+    }
+}
+/*****************************************************************************/
+void TableActor::Schedule()
+{
+    if (mExecutor)
+    {
+        auto self = shared_from_this();
+        mExecutor([self]() { self->Run(); });
+    }
+    else
+    {
+        Run();
+    }
+}
+/*****************************************************************************/
+/**
+ * @brief TableActor::Run
+ *
+ * Executes a batch of messages; only one Run() is active at a time for a table
+ */
+void TableActor::Run()
+{
+    for (std::uint32_t i = 0U; i < cMaxBatch; i++)
+    {
+        Entry entry;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            if (mMailbox.empty())
+            {
+                mScheduled = false;
+                return;
+            }
+            entry = std::move(mMailbox.front());
+            mMailbox.pop_front();
+        }
+
+        entry.msg(*mTable);
+
+        std::uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - entry.posted).count();
+        mProcessed++;
+        mTotalLatencyUs += us;
+        std::uint64_t max = mMaxLatencyUs.load();
+        while ((us > max) && !mMaxLatencyUs.compare_exchange_weak(max, us))
+        {
+            // max is reloaded by compare_exchange_weak
+        }
+    }
+
+    // Batch finished but there are still messages: let the other tables run, then continue
+    bool schedule = false;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mMailbox.empty())
+        {
+            mScheduled = false;
+        }
+        else
+        {
+            schedule = true;
+        }
+    }
+
+    if (schedule)
+    {
+        Schedule();
+    }
+}
+/*****************************************************************************/
+TableActor::Stats TableActor::GetStats() const
+{
+    Stats stats;
+
+    stats.id = mId;
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        stats.depth = static_cast<std::uint32_t>(mMailbox.size());
+    }
+    stats.processed = mProcessed.load();
+    stats.totalLatencyUs = mTotalLatencyUs.load();
+    stats.maxLatencyUs = mMaxLatencyUs.load();
+    return stats;
+}
+
+//=============================================================================
+// End of file TableActor.cpp
+//=============================================================================
@@ -0,0 +1,109 @@
+/*=============================================================================
+ * TarotClub - TableActor.h
+ *=============================================================================
+ * Serialized execution of the requests of one playing table
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+#ifndef TABLE_ACTOR_H
+#define TABLE_ACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "PlayingTable.h"
+
+/*****************************************************************************/
+/**
+ * @brief The TableActor class
+ *
+ * Owns a PlayingTable (and thus its Engine and Score). The table state is
+ * only accessed by the messages posted in the mailbox; they are executed
+ * one at a time, in order, on a shared executor (thread pool). Different
+ * tables progress in parallel, no global lock is involved.
+ *
+ * Without executor, the messages are executed immediately in the caller thread.
+ *
+ * When the actor is deleted (table destroyed and mailbox empty), the table is
+ * given to the recycler, if any, instead of being freed.
+ */
+class TableActor : public std::enable_shared_from_this<TableActor>
+{
+public:
+    typedef std::function<void (PlayingTable &table)> Message;
+    typedef std::function<void (std::function<void ()>)> Executor;
+    typedef std::function<void (std::unique_ptr<PlayingTable>)> Recycler;
+
+    struct Stats
+    {
+        std::uint32_t id;
+        std::uint32_t depth;            ///< Messages waiting in the mailbox
+        std::uint64_t processed;        ///< Messages executed so far
+        std::uint64_t totalLatencyUs;   ///< Cumulated time from Post() to the end of the execution
+        std::uint64_t maxLatencyUs;
+    };
+
+    static const std::uint32_t cMaxBatch = 32U; ///< Messages executed before yielding the thread to other tables
+
+    TableActor(std::unique_ptr<PlayingTable> table, const Executor &executor, const Recycler &recycler = Recycler());
+    ~TableActor();
+
+    void Post(const Message &msg);
+    Stats GetStats() const;
+
+    // Immutable properties, can be read from any thread
+    std::uint32_t GetId() const { return mId; }
+    const std::string &GetName() const { return mName; }
+
+private:
+    struct Entry
+    {
+        Message msg;
+        std::chrono::steady_clock::time_point posted;
+    };
+
+    std::unique_ptr<PlayingTable> mTable;
+    Executor mExecutor;
+    Recycler mRecycler;
+    const std::uint32_t mId;
+    const std::string mName;
+
+    mutable std::mutex mMutex; ///< Protects the mailbox only
+    std::deque<Entry> mMailbox;
+    bool mScheduled;
+
+    std::atomic<std::uint64_t> mProcessed;
+    std::atomic<std::uint64_t> mTotalLatencyUs;
+    std::atomic<std::uint64_t> mMaxLatencyUs;
+
+    void Schedule();
+    void Run();
+};
+
+typedef std::shared_ptr<TableActor> TableActorPtr;
+
+#endif // TABLE_ACTOR_H
+
+//=============================================================================
+// End of file TableActor.h
+//=============================================================================
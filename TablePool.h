@@ -0,0 +1,175 @@
+/*=============================================================================
+ * TarotClub - TablePool.h
+ *=============================================================================
+ * Recycling of the playing tables
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef TABLE_POOL_H
+#define TABLE_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "PlayingTable.h"
+
+/*****************************************************************************/
+/**
+ * @brief The TablePool class
+ *
+ * Keeps the tables of the destroyed tables (engine, decks, score, event log)
+ * for the next ones. A table given back is Reset() in place, its containers
+ * keep their memory; a table taken from the pool is like a new one.
+ *
+ * At most 'capacity' tables are kept, extra ones are freed. Reserve() creates
+ * tables in advance, for the bursts of table creations (matchmaking).
+ *
+ * Thread safe: tables are taken by the lobby and given back by the thread
+ * that releases the last reference to their actor (often a worker).
+ */
+class TablePool
+{
+public:
+    struct Stats
+    {
+        std::uint32_t size;         ///< Tables ready in the pool
+        std::uint32_t capacity;     ///< Maximum number of tables kept
+        std::uint64_t hits;         ///< Tables taken from the pool
+        std::uint64_t misses;       ///< Tables allocated because the pool was empty
+        std::uint64_t recycled;     ///< Tables given back and kept
+        std::uint64_t discarded;    ///< Tables given back and freed (pool full)
+    };
+
+    static const std::uint32_t cDefaultCapacity = 16U;
+
+    TablePool()
+        : mCapacity(cDefaultCapacity)
+    {
+
+    }
+
+    // Keeps up to capacity tables and creates them now up to 'warm'
+    void Reserve(std::uint32_t capacity, std::uint32_t warm)
+    {
+        warm = std::min(warm, capacity);
+        std::vector<std::unique_ptr<PlayingTable>> extra;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCapacity = capacity;
+            mFree.reserve(capacity);
+            while (mFree.size() > capacity)
+            {
+                extra.push_back(std::move(mFree.back()));
+                mFree.pop_back();
+            }
+            warm = (warm > mFree.size()) ? (warm - static_cast<std::uint32_t>(mFree.size())) : 0U;
+        }
+
+        // Built outside of the lock
+        std::vector<std::unique_ptr<PlayingTable>> tables;
+        for (std::uint32_t i = 0U; i < warm; i++)
+        {
+            tables.push_back(std::make_unique<PlayingTable>());
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto &t : tables)
+        {
+            if (mFree.size() < mCapacity)
+            {
+                mFree.push_back(std::move(t));
+            }
+        }
+    }
+
+    std::unique_ptr<PlayingTable> Take()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mFree.empty())
+            {
+                std::unique_ptr<PlayingTable> table = std::move(mFree.back());
+                mFree.pop_back();
+                mHits++;
+                return table;
+            }
+        }
+        mMisses++;
+        return std::make_unique<PlayingTable>();
+    }
+
+    void Recycle(std::unique_ptr<PlayingTable> table)
+    {
+        if (!table)
+        {
+            return;
+        }
+
+        // Cleared before taking the lock, the pool is never blocked by a reset
+        table->Reset();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFree.size() < mCapacity)
+        {
+            mFree.push_back(std::move(table));
+            mRecycled++;
+        }
+        else
+        {
+            mDiscarded++;
+        }
+    }
+
+    Stats GetStats()
+    {
+        Stats s;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            s.size = static_cast<std::uint32_t>(mFree.size());
+            s.capacity = mCapacity;
+        }
+        s.hits = mHits;
+        s.misses = mMisses;
+        s.recycled = mRecycled;
+        s.discarded = mDiscarded;
+        return s;
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<PlayingTable>> mFree;
+    std::uint32_t mCapacity;
+    std::atomic<std::uint64_t> mHits{0U};
+    std::atomic<std::uint64_t> mMisses{0U};
+    std::atomic<std::uint64_t> mRecycled{0U};
+    std::atomic<std::uint64_t> mDiscarded{0U};
+};
+
+typedef std::shared_ptr<TablePool> TablePoolPtr;
+
+#endif // TABLE_POOL_H
+
+//=============================================================================
+// End of file TablePool.h
+//=============================================================================
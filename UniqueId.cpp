@@ -3,10 +3,13 @@
  * Copyright (c) 2019 Anthony Rabine
  */
 
-#include <algorithm>
 #include <iostream>
 #include "UniqueId.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 /*****************************************************************************/
 /**
  * @brief UniqueId::UniqueId
@@ -37,46 +40,97 @@ UniqueId::UniqueId(std::uint32_t min, std::uint32_t max)
     {
         mMax = max;
     }
+
+    Clear();
+}
+/*****************************************************************************/
+void UniqueId::Clear()
+{
+    std::uint64_t nbIds = static_cast<std::uint64_t>(mMax - mMin) + 1U;
+    std::size_t nbWords = static_cast<std::size_t>((nbIds + 63U) / 64U);
+    std::size_t nbSummary = (nbWords + 63U) / 64U;
+
+    mCount = 0U;
+    mUsed.assign(nbWords, 0U);
+    mFull.assign(nbSummary, 0U);
+
+    // The bits after mMax are seen as taken, so the last word can be full
+    std::uint32_t tail = static_cast<std::uint32_t>(nbIds % 64U);
+    if (tail != 0U)
+    {
+        mUsed.back() = ~((1ULL << tail) - 1U);
+    }
+    // Same for the summary: the words after the last one are full
+    tail = static_cast<std::uint32_t>(nbWords % 64U);
+    if (tail != 0U)
+    {
+        mFull.back() = ~((1ULL << tail) - 1U);
+    }
+}
+/*****************************************************************************/
+std::uint32_t UniqueId::LowestZero(std::uint64_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, ~word);
+    return static_cast<std::uint32_t>(index);
+#else
+    return static_cast<std::uint32_t>(__builtin_ctzll(~word));
+#endif
+}
+/*****************************************************************************/
+void UniqueId::Set(std::uint32_t index)
+{
+    std::uint32_t w = index / 64U;
+
+    mUsed[w] |= (1ULL << (index % 64U));
+    if (mUsed[w] == ~0ULL)
+    {
+        mFull[w / 64U] |= (1ULL << (w % 64U));
+    }
+    mCount++;
 }
 /*****************************************************************************/
 std::uint32_t UniqueId::TakeId()
 {
-    std::uint32_t id = cInvalidId;
+    std::uint32_t id = FindId();
 
-    for (std::uint32_t i = mMin; i <= mMax; i++)
+    if (id != cInvalidId)
     {
-        if (std::find(mUsedIds.begin(), mUsedIds.end(), i) == mUsedIds.end())
-        {
-            // Id not used
-            id = i;
-            mUsedIds.push_back(id);
-            break;
-        }
+        Set(id - mMin);
     }
     return id;
 }
 /*****************************************************************************/
+/**
+ * @brief UniqueId::FindId
+ *
+ * Lowest free ID, without taking it
+ *
+ * @return the ID, or cInvalidId if they are all taken
+ */
 uint32_t UniqueId::FindId()
 {
-    std::uint32_t id = 0U;
+    std::uint32_t id = cInvalidId;
 
-    for (std::uint32_t i = mMin; i <= mMax; i++)
+    for (std::size_t s = 0U; s < mFull.size(); s++)
     {
-        if (std::find(mUsedIds.begin(), mUsedIds.end(), i) == mUsedIds.end())
+        if (mFull[s] != ~0ULL)
         {
-            // Id not used
-            id = i;
+            std::size_t w = (s * 64U) + LowestZero(mFull[s]);
+            id = mMin + static_cast<std::uint32_t>((w * 64U) + LowestZero(mUsed[w]));
             break;
         }
     }
     return id;
 }
 /*****************************************************************************/
+// Out of range IDs are ignored
 void UniqueId::AddId(uint32_t id)
 {
-    if (!IsTaken(id))
+    if ((id >= mMin) && (id <= mMax) && !IsTaken(id))
     {
-        mUsedIds.push_back(id);
+        Set(id - mMin);
     }
 }
 /*****************************************************************************/
@@ -85,24 +139,39 @@ bool UniqueId::ReleaseId(std::uint32_t id)
 {
     bool ret = false;
 
-    if (std::find(mUsedIds.begin(), mUsedIds.end(), id) != mUsedIds.end())
+    if (IsTaken(id))
     {
-        mUsedIds.erase(std::find(mUsedIds.begin(), mUsedIds.end(), id));
-        ret = (std::find(mUsedIds.begin(), mUsedIds.end(), id) == mUsedIds.end());
+        std::uint32_t index = id - mMin;
+        std::uint32_t w = index / 64U;
+
+        mUsed[w] &= ~(1ULL << (index % 64U));
+        mFull[w / 64U] &= ~(1ULL << (w % 64U));
+        mCount--;
+        ret = true;
     }
     return ret;
 }
 /*****************************************************************************/
-bool UniqueId::IsTaken(std::uint32_t id)
+bool UniqueId::IsTaken(std::uint32_t id) const
 {
-    return (std::find(mUsedIds.begin(), mUsedIds.end(), id) != mUsedIds.end());
+    bool taken = false;
+
+    if ((id >= mMin) && (id <= mMax))
+    {
+        std::uint32_t index = id - mMin;
+        taken = ((mUsed[index / 64U] >> (index % 64U)) & 1U) != 0U;
+    }
+    return taken;
 }
 /*****************************************************************************/
 void UniqueId::Dump()
 {
-    for (auto id: mUsedIds)
+    for (std::uint64_t id = mMin; id <= mMax; id++)
     {
-        std::cout << id <<", ";
+        if (IsTaken(static_cast<std::uint32_t>(id)))
+        {
+            std::cout << id <<", ";
+        }
     }
     std::cout << std::endl;
 }
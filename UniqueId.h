@@ -7,8 +7,7 @@
 #define UNIQUE_ID_H
 
 #include <cstdint>
-#include <list>
-#include <mutex>
+#include <vector>
 
 /*****************************************************************************/
 /**
@@ -17,6 +16,10 @@
  * Manage a unique list of IDs.
  * Start at 1, 0 is considered as invalid
  *
+ * The IDs in [min, max] are stored in a bitmap (one bit per ID); a second
+ * bitmap marks the full words, so the first free ID is found by scanning
+ * 4096 IDs per summary word. Take, release and query do not depend on the
+ * number of IDs in use.
  */
 class UniqueId
 {
@@ -29,16 +32,22 @@ public:
     std::uint32_t FindId();
     void AddId(std::uint32_t id);
     bool ReleaseId(std::uint32_t id);
-    bool IsTaken(std::uint32_t id);
-    std::uint32_t GetMin() { return mMin; }
-    std::uint32_t GetMax() { return mMax; }
-    void Clear() { mUsedIds.clear(); }
+    bool IsTaken(std::uint32_t id) const;
+    std::uint32_t GetMin() const { return mMin; }
+    std::uint32_t GetMax() const { return mMax; }
+    std::uint32_t Count() const { return mCount; } ///< Number of IDs in use
+    void Clear();
     void Dump();
 
 private:
     std::uint32_t mMin;
     std::uint32_t mMax;
-    std::list<std::uint32_t> mUsedIds;
+    std::uint32_t mCount;
+    std::vector<std::uint64_t> mUsed;   ///< Bit set: ID taken (and bits after mMax)
+    std::vector<std::uint64_t> mFull;   ///< Bit set: word of mUsed is full
+
+    void Set(std::uint32_t index);
+    static std::uint32_t LowestZero(std::uint64_t word);
 };
 
 #endif // UNIQUE_ID_H
@@ -23,6 +23,7 @@
  *=============================================================================
  */
 
+#include <algorithm>
 #include <sstream>
 #include "Users.h"
 
@@ -39,37 +40,37 @@ Users::Users()
  * @param uuid
  * @return
  */
-std::uint32_t Users::GetPlayerTable(std::uint32_t uuid)
+std::uint32_t Users::GetPlayerTable(std::uint32_t uuid) const
 {
    std::uint32_t tableId = Protocol::LOBBY_UID;
 
-   for (std::uint32_t i = 0; i < mUsers.size(); i++)
+   const Entry *entry = Find(uuid);
+   if (entry != nullptr)
    {
-       if (mUsers[i].player.uuid == uuid)
-       {
-            tableId = mUsers[i].player.tableId;
-            break;
-       }
+       tableId = entry->player.tableId;
    }
    return tableId;
 }
 /*****************************************************************************/
-bool Users::GetEntry(std::uint32_t uuid, Entry &entry)
+const Users::Entry *Users::Find(std::uint32_t uuid) const
+{
+    auto it = mIndex.find(uuid);
+    return (it != mIndex.end()) ? &mUsers[it->second] : nullptr;
+}
+/*****************************************************************************/
+bool Users::GetEntry(std::uint32_t uuid, Entry &entry) const
 {
     bool ret = false;
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
+    const Entry *found = Find(uuid);
+    if (found != nullptr)
     {
-        if (mUsers[i].player.uuid == uuid)
-        {
-             entry = mUsers[i];
-             ret = true;
-             break;
-        }
+        entry = *found;
+        ret = true;
     }
     return ret;
 }
 /*****************************************************************************/
-bool Users::GetEntryByIndex(uint32_t index, Users::Entry &entry)
+bool Users::GetEntryByIndex(uint32_t index, Users::Entry &entry) const
 {
     bool success = false;
 
@@ -85,121 +86,143 @@ bool Users::GetEntryByIndex(uint32_t index, Users::Entry &entry)
 void Users::Clear()
 {
     mUsers.clear();
+    mUuids.clear();
+    mTableSlots.clear();
+    mIndex.clear();
+    mTables.clear();
+    mNickNames.clear();
 }
 /*****************************************************************************/
 void Users::SetPlayingTable(std::uint32_t uuid, std::uint32_t tableId, Place place)
 {
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
-    {
-        if (mUsers[i].player.uuid == uuid)
-        {
-             mUsers[i].player.tableId = tableId;
-             mUsers[i].player.place = place;
-             break;
-        }
-    }
+    (void) UpdateLocation(uuid, tableId, place);
 }
 /*****************************************************************************/
-std::vector<std::uint32_t> Users::GetTablePlayerIds(std::uint32_t tableId)
+const std::vector<std::uint32_t> &Users::GetTablePlayerIds(std::uint32_t tableId) const
 {
-    std::vector<std::uint32_t> theList;
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
-    {
-        if (mUsers[i].player.tableId == tableId)
-        {
-            theList.push_back(mUsers[i].player.uuid);
-        }
-    }
-    return theList;
+    static const std::vector<std::uint32_t> cEmpty;
+
+    auto it = mTables.find(tableId);
+    return (it != mTables.end()) ? it->second : cEmpty;
 }
 /*****************************************************************************/
-std::vector<Users::Entry> Users::GetTableUsers(uint32_t tableId)
+std::vector<Users::Entry> Users::GetTableUsers(uint32_t tableId) const
 {
     std::vector<Users::Entry> theList;
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
+    for (auto uuid : GetTablePlayerIds(tableId))
     {
-        if (mUsers[i].player.tableId == tableId)
-        {
-            theList.push_back(mUsers[i]);
-        }
+        theList.push_back(mUsers[mIndex.at(uuid)]);
     }
     return theList;
 }
 /*****************************************************************************/
-std::vector<uint32_t> Users::GetAll()
+std::vector<Users::Entry> Users::Get(std::uint32_t filterId) const
 {
-    std::vector<std::uint32_t> theList;
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
+    if (filterId != Protocol::LOBBY_UID)
     {
-        theList.push_back(mUsers[i].player.uuid);
+        return GetTableUsers(filterId);
     }
-    return theList;
+    return mUsers;
 }
 /*****************************************************************************/
-std::vector<Users::Entry> Users::Get(std::uint32_t filterId)
+/**
+ * @brief Users::Select
+ *
+ * One page of the users sorted by nickname
+ *
+ * @param prefix Beginning of the nickname, empty for all the users
+ * @param tableId Only the users at this table (LOBBY_UID: not at a table), INVALID_UID for all the users
+ * @param offset Number of matching users to skip
+ * @param count Maximum size of the page
+ * @param page Uuid of the users of the page
+ * @return The total number of matching users
+ */
+std::uint32_t Users::Select(const std::string &prefix, std::uint32_t tableId, std::uint32_t offset, std::uint32_t count, std::vector<std::uint32_t> &page) const
 {
-    std::vector<Entry> theList;
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
+    std::uint32_t total = 0U;
+
+    page.clear();
+    if (prefix.empty() && (tableId == Protocol::INVALID_UID))
     {
-        if ((mUsers[i].player.tableId == filterId) ||
-            (filterId == Protocol::LOBBY_UID))
+        // Nothing to check, only the page is walked
+        total = Size();
+        auto it = mNickNames.begin();
+        std::advance(it, std::min(offset, total));
+        for (; (it != mNickNames.end()) && (page.size() < count); ++it)
         {
-            theList.push_back(mUsers[i]);
+            page.push_back(it->second);
         }
     }
-    return theList;
-}
-/*****************************************************************************/
-uint32_t Users::Size()
-{
-    return static_cast<std::uint32_t>(mUsers.size());
-}
-/*****************************************************************************/
-bool Users::IsHere(std::uint32_t uuid)
-{
-    bool isHere = false;
-    for (std::uint32_t i = 0; i < mUsers.size(); i++)
+    else if (tableId == Protocol::INVALID_UID)
     {
-        if (mUsers[i].player.uuid == uuid)
+        for (auto it = mNickNames.lower_bound(prefix); it != mNickNames.end(); ++it)
         {
-             isHere = true;
-             break;
+            if (it->first.compare(0U, prefix.size(), prefix) != 0)
+            {
+                break;
+            }
+            if ((total >= offset) && (page.size() < count))
+            {
+                page.push_back(it->second);
+            }
+            total++;
         }
     }
-    return isHere;
-}
-/*****************************************************************************/
-bool Users::CheckNickName(std::uint32_t uuid, const std::string &nickname)
-{
-    // Check if not already used
-    bool already_used = false;
-    for (std::uint32_t i = 0U; i < mUsers.size(); i++)
+    else
     {
-        if (mUsers[i].player.uuid != uuid)
+        // Only the users of the table are walked, then sorted up to the end of the page
+        std::vector<const Entry *> matching;
+        for (auto uuid : GetTablePlayerIds(tableId))
         {
-            if (mUsers[i].identity.username == nickname)
+            const Entry &entry = mUsers[mIndex.at(uuid)];
+            if (entry.identity.username.compare(0U, prefix.size(), prefix) == 0)
             {
-                already_used = true;
-                break;
+                matching.push_back(&entry);
             }
         }
-    }
 
-    return already_used;
+        total = static_cast<std::uint32_t>(matching.size());
+        if (offset < total)
+        {
+            std::uint32_t end = (count < (total - offset)) ? (offset + count) : total;
+            std::partial_sort(matching.begin(), matching.begin() + end, matching.end(),
+                              [](const Entry *a, const Entry *b) { return a->identity.username < b->identity.username; });
+            for (std::uint32_t i = offset; i < end; i++)
+            {
+                page.push_back(matching[i]->player.uuid);
+            }
+        }
+    }
+    return total;
+}
+/*****************************************************************************/
+bool Users::IsHere(std::uint32_t uuid) const
+{
+    return mIndex.count(uuid) > 0U;
+}
+/*****************************************************************************/
+bool Users::CheckNickName(std::uint32_t uuid, const std::string &nickname) const
+{
+    // Check if not already used
+    auto it = mNickNames.find(nickname);
+    return (it != mNickNames.end()) && (it->second != uuid);
 }
 /*****************************************************************************/
 bool Users::UpdateLocation(std::uint32_t uuid, uint32_t tableId, Place p)
 {
     bool ret = false;
-    for (std::uint32_t i = 0U; i < mUsers.size(); i++)
+    auto it = mIndex.find(uuid);
+    if (it != mIndex.end())
     {
-        if (mUsers[i].player.uuid == uuid)
+        std::uint32_t slot = it->second;
+        if (mUsers[slot].player.tableId != tableId)
         {
-             mUsers[i].player.tableId = tableId;
-             mUsers[i].player.place = p;
-             ret = true;
-             break;
+            RemoveFromTable(slot);
+            mUsers[slot].player.tableId = tableId;
+            AddToTable(slot);
         }
+        mUsers[slot].player.place = p;
+        ret = true;
     }
     return ret;
 }
@@ -211,14 +234,14 @@ bool Users::ChangeNickName(uint32_t uuid, const std::string &nickname)
     // Check if not already used before changing it
     if (!CheckNickName(uuid, nickname))
     {
-        for (std::uint32_t i = 0U; i < mUsers.size(); i++)
+        auto it = mIndex.find(uuid);
+        if (it != mIndex.end())
         {
-            if (mUsers[i].player.uuid == uuid)
-            {
-                 mUsers[i].identity.username = nickname;
-                 ret = true;
-                 break;
-            }
+            std::string &current = mUsers[it->second].identity.username;
+            mNickNames.erase(current);
+            current = nickname;
+            mNickNames[nickname] = uuid;
+            ret = true;
         }
     }
     return ret;
@@ -239,7 +262,13 @@ bool Users::AddEntry(const Entry &entry)
     {
         if (!CheckNickName(entry.player.uuid, entry.identity.username))
         {
+            std::uint32_t slot = static_cast<std::uint32_t>(mUsers.size());
             mUsers.push_back(entry);
+            mUuids.push_back(entry.player.uuid);
+            mTableSlots.push_back(0U);
+            mIndex[entry.player.uuid] = slot;
+            mNickNames[entry.identity.username] = entry.player.uuid;
+            AddToTable(slot);
             valid = true;
         }
     }
@@ -248,12 +277,56 @@ bool Users::AddEntry(const Entry &entry)
 /*****************************************************************************/
 void Users::Remove(std::uint32_t uuid)
 {
-    for (std::uint32_t i = 0U; i < mUsers.size(); i++)
+    auto it = mIndex.find(uuid);
+    if (it != mIndex.end())
     {
-        if (mUsers[i].player.uuid == uuid)
+        std::uint32_t slot = it->second;
+        std::uint32_t last = static_cast<std::uint32_t>(mUsers.size()) - 1U;
+
+        RemoveFromTable(slot);
+        mNickNames.erase(mUsers[slot].identity.username);
+        mIndex.erase(it);
+
+        // The last entry takes the free slot
+        if (slot != last)
+        {
+            mUsers[slot] = std::move(mUsers[last]);
+            mUuids[slot] = mUuids[last];
+            mTableSlots[slot] = mTableSlots[last];
+            mIndex[mUuids[slot]] = slot;
+        }
+        mUsers.pop_back();
+        mUuids.pop_back();
+        mTableSlots.pop_back();
+    }
+}
+/*****************************************************************************/
+void Users::AddToTable(std::uint32_t slot)
+{
+    std::vector<std::uint32_t> &players = mTables[mUsers[slot].player.tableId];
+    mTableSlots[slot] = static_cast<std::uint32_t>(players.size());
+    players.push_back(mUuids[slot]);
+}
+/*****************************************************************************/
+void Users::RemoveFromTable(std::uint32_t slot)
+{
+    auto it = mTables.find(mUsers[slot].player.tableId);
+    if (it != mTables.end())
+    {
+        std::vector<std::uint32_t> &players = it->second;
+        std::uint32_t pos = mTableSlots[slot];
+
+        // Same packing as the main list
+        players[pos] = players.back();
+        players.pop_back();
+        if (pos < players.size())
+        {
+            mTableSlots[mIndex[players[pos]]] = pos;
+        }
+
+        if (players.empty())
         {
-            mUsers.erase(mUsers.begin() + i);
-            break;
+            mTables.erase(it);
         }
     }
 }
@@ -32,6 +32,8 @@
 #include "Protocol.h"
 #include <vector>
 #include <map>
+#include <string>
+#include <unordered_map>
 
 /*****************************************************************************/
 class Users
@@ -75,19 +77,21 @@ public:
     Users();
 
     // Accessors
-    bool IsHere(std::uint32_t uuid);
-    std::uint32_t GetPlayerTable(std::uint32_t uuid);
-    bool GetEntry(std::uint32_t uuid, Entry &entry);
-    bool GetEntryByIndex(std::uint32_t index, Entry &entry);
+    bool IsHere(std::uint32_t uuid) const;
+    std::uint32_t GetPlayerTable(std::uint32_t uuid) const;
+    const Entry *Find(std::uint32_t uuid) const; ///< nullptr if not found, valid until the next mutation
+    bool GetEntry(std::uint32_t uuid, Entry &entry) const;
+    bool GetEntryByIndex(std::uint32_t index, Entry &entry) const;
     void Clear();
-    bool CheckNickName(std::uint32_t uuid, const std::string &nickname);
+    bool CheckNickName(std::uint32_t uuid, const std::string &nickname) const;
     bool UpdateLocation(uint32_t uuid, std::uint32_t tableId, Place p);
-    std::vector<uint32_t> GetTablePlayerIds(std::uint32_t tableId);
-    std::vector<Users::Entry> GetTableUsers(std::uint32_t tableId);
+    const std::vector<uint32_t> &GetTablePlayerIds(std::uint32_t tableId) const;
+    std::vector<Users::Entry> GetTableUsers(std::uint32_t tableId) const;
 
-    std::vector<uint32_t> GetAll();
-    std::vector<Entry> Get(uint32_t filterId);
-    std::uint32_t Size();
+    const std::vector<uint32_t> &GetAll() const { return mUuids; }
+    std::vector<Entry> Get(uint32_t filterId) const;
+    std::uint32_t Size() const { return static_cast<std::uint32_t>(mUsers.size()); }
+    std::uint32_t Select(const std::string &prefix, std::uint32_t tableId, std::uint32_t offset, std::uint32_t count, std::vector<std::uint32_t> &page) const;
 
     // Mutators
     bool ChangeNickName(std::uint32_t uuid, const std::string &nickname);
@@ -96,7 +100,16 @@ public:
     void SetPlayingTable(std::uint32_t uuid, std::uint32_t tableId, Place place);
 
 private:
-    std::vector<Entry> mUsers;  // connected players
+    // Entries are packed (a removal moves the last one in the hole), the maps give their slot
+    std::vector<Entry> mUsers;                  // connected players
+    std::vector<std::uint32_t> mUuids;          // uuid of each slot
+    std::vector<std::uint32_t> mTableSlots;     // position of each slot in its table list
+    std::unordered_map<std::uint32_t, std::uint32_t> mIndex;                // uuid --> slot
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> mTables;  // table --> uuids
+    std::map<std::string, std::uint32_t> mNickNames;                        // nickname --> uuid, sorted for the pages
+
+    void AddToTable(std::uint32_t slot);
+    void RemoveFromTable(std::uint32_t slot);
 };
 
 #endif // USERS_H
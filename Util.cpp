@@ -85,6 +85,15 @@ static const HANDLE WIN_INVALID_HND_VALUE = reinterpret_cast<HANDLE>(-1);
 #include <random>
 #include <memory>
 #include <filesystem>
+
+// Vectorized hex codecs: SSE2 is always there on x86-64, AVX2 is detected at runtime
+#if defined(__x86_64__) || defined(_M_X64)
+#define UTIL_HEX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 //#include "date.h"
 //#include "tz.h"
 #include "Util.h"
@@ -645,16 +654,299 @@ std::string Util::Match(const std::string &msg, const std::string &patternString
     return subMatch; // empty string if not found
 }
 /*****************************************************************************/
-void Util::HexStringToUint8(const std::string_view &input, uint8_t *output)
+bool Util::HexStringToUint8(const std::string_view &input, uint8_t *output)
+{
+    return DecodeHex(input.data(), input.size(), output);
+}
+/*****************************************************************************/
+namespace {
+
+static const char cHexDigits[] = "0123456789ABCDEF";
+
+// 0xFF for invalid characters
+struct HexDecodeTable
+{
+    uint8_t value[256];
+
+    HexDecodeTable()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            value[i] = 0xFF;
+        }
+        for (int i = 0; i < 10; i++)
+        {
+            value['0' + i] = i;
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            value['A' + i] = 10 + i;
+            value['a' + i] = 10 + i;
+        }
+    }
+};
+
+static const HexDecodeTable cHexTable;
+
+void EncodeHexScalar(const uint8_t *input, size_t size, char *output)
+{
+    for (size_t i = 0U; i < size; i++)
+    {
+        output[2*i] = cHexDigits[input[i] >> 4];
+        output[2*i + 1] = cHexDigits[input[i] & 0x0F];
+    }
+}
+
+bool DecodeHexScalar(const char *input, size_t size, uint8_t *output)
+{
+    uint8_t invalid = 0U;
+    for (size_t i = 0U; i < size / 2; i++)
+    {
+        uint8_t hi = cHexTable.value[static_cast<uint8_t>(input[2*i])];
+        uint8_t lo = cHexTable.value[static_cast<uint8_t>(input[2*i + 1])];
+        invalid |= (hi | lo) & 0xF0;
+        output[i] = static_cast<uint8_t>((hi << 4) | (lo & 0x0F));
+    }
+    return invalid == 0U;
+}
+
+#ifdef UTIL_HEX_X86
+
+// 16 bytes --> 32 characters
+inline void EncodeHex16Sse2(const uint8_t *input, char *output)
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i ascii0 = _mm_set1_epi8('0');
+    const __m128i letterOffset = _mm_set1_epi8('A' - '0' - 10);
+
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input));
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask);
+    __m128i lo = _mm_and_si128(in, mask);
+
+    hi = _mm_add_epi8(_mm_add_epi8(hi, ascii0), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letterOffset));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, ascii0), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letterOffset));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+// 16 characters --> 8 nibble pairs in 16-bit lanes; 'valid' is cleared on bad characters
+inline __m128i DecodeNibblesSse2(__m128i c, __m128i &valid)
+{
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, five), letter);
+
+    valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isLetter));
+
+    __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, digit),
+                                   _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+
+    // Each 16-bit lane holds (high nibble, low nibble): merge them into one byte value
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4), _mm_srli_epi16(nibbles, 8));
+}
+
+void EncodeHexSse2(const uint8_t *input, size_t size, char *output)
+{
+    size_t i = 0U;
+    for (; i + 16U <= size; i += 16U)
+    {
+        EncodeHex16Sse2(input + i, output + 2*i);
+    }
+    EncodeHexScalar(input + i, size - i, output + 2*i);
+}
+
+bool DecodeHexSse2(const char *input, size_t size, uint8_t *output)
+{
+    __m128i valid = _mm_set1_epi8(-1);
+    size_t i = 0U;
+
+    for (; i + 32U <= size; i += 32U)
+    {
+        __m128i a = DecodeNibblesSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i)), valid);
+        __m128i b = DecodeNibblesSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + 16)), valid);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i/2), _mm_packus_epi16(a, b));
+    }
+
+    bool ok = (_mm_movemask_epi8(valid) == 0xFFFF);
+    return DecodeHexScalar(input + i, size - i, output + i/2) && ok;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define UTIL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UTIL_TARGET_AVX2
+#endif
+
+UTIL_TARGET_AVX2 void EncodeHexAvx2(const uint8_t *input, size_t size, char *output)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+                                            '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    size_t i = 0U;
+
+    for (; i + 32U <= size; i += 32U)
+    {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(in, mask));
+
+        // unpack works inside each 128-bit lane: put the lanes back in order
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + 2*i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + 2*i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    EncodeHexSse2(input + i, size - i, output + 2*i);
+}
+
+UTIL_TARGET_AVX2 inline __m256i DecodeNibblesAvx2(__m256i c, __m256i &valid)
+{
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i five = _mm256_set1_epi8(5);
+
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, nine), digit);
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, five), letter);
+
+    valid = _mm256_and_si256(valid, _mm256_or_si256(isDigit, isLetter));
+
+    __m256i nibbles = _mm256_or_si256(_mm256_and_si256(isDigit, digit),
+                                      _mm256_and_si256(isLetter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+
+    return _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4), _mm256_srli_epi16(nibbles, 8));
+}
+
+UTIL_TARGET_AVX2 bool DecodeHexAvx2(const char *input, size_t size, uint8_t *output)
+{
+    __m256i valid = _mm256_set1_epi8(-1);
+    size_t i = 0U;
+
+    for (; i + 64U <= size; i += 64U)
+    {
+        __m256i a = DecodeNibblesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i)), valid);
+        __m256i b = DecodeNibblesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i + 32)), valid);
+        // packus works inside each 128-bit lane: reorder the 64-bit quarters
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i/2), packed);
+    }
+
+    bool ok = (_mm256_movemask_epi8(valid) == -1);
+    return DecodeHexSse2(input + i, size - i, output + i/2) && ok;
+}
+
+bool HasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || ((_xgetbv(0) & 0x6) != 0x6))
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // UTIL_HEX_X86
+
+struct HexCodec
+{
+    void (*encode)(const uint8_t *, size_t, char *);
+    bool (*decode)(const char *, size_t, uint8_t *);
+    const char *name;
+};
+
+HexCodec &GetHexCodec()
+{
+#ifdef UTIL_HEX_X86
+    static HexCodec codec = HasAvx2() ? HexCodec{ EncodeHexAvx2, DecodeHexAvx2, "avx2" } : HexCodec{ EncodeHexSse2, DecodeHexSse2, "sse2" };
+#else
+    static HexCodec codec{ EncodeHexScalar, DecodeHexScalar, "scalar" };
+#endif
+    return codec;
+}
+
+} // namespace
+/*****************************************************************************/
+/**
+ * @brief Util::EncodeHex
+ *
+ * Uppercase hexadecimal encoding; output must hold 2 * size characters
+ */
+void Util::EncodeHex(const uint8_t *input, size_t size, char *output)
 {
-    for(size_t i = 0; i < input.length(); i += 2)
+    GetHexCodec().encode(input, size, output);
+}
+/*****************************************************************************/
+/**
+ * @brief Util::DecodeHex
+ *
+ * Accepts upper and lower case digits; output must hold size / 2 bytes.
+ * Returns false if the size is odd or if a character is not an hex digit,
+ * the output content is then undefined.
+ */
+bool Util::DecodeHex(const char *input, size_t size, uint8_t *output)
+{
+    if ((size % 2U) != 0U)
     {
-        std::stringstream converter;
-        converter << std::hex << input.substr(i,2);
-        int byte;
-        converter >> byte;
-        output[i/2] = byte & 0xFF;
+        return false;
     }
+    return GetHexCodec().decode(input, size, output);
+}
+/*****************************************************************************/
+const char *Util::HexCodecName()
+{
+    return GetHexCodec().name;
+}
+/*****************************************************************************/
+/**
+ * @brief Util::SelectHexCodec
+ *
+ * Forces an implementation of the hex codecs: "avx2", "sse2" or "scalar".
+ * For the tests and the benchmarks, before any other thread uses the codecs.
+ *
+ * @return false if the implementation is not available on this CPU
+ */
+bool Util::SelectHexCodec(const std::string &name)
+{
+    bool ok = true;
+
+    if (name == "scalar")
+    {
+        GetHexCodec() = HexCodec{ EncodeHexScalar, DecodeHexScalar, "scalar" };
+    }
+#ifdef UTIL_HEX_X86
+    else if (name == "sse2")
+    {
+        GetHexCodec() = HexCodec{ EncodeHexSse2, DecodeHexSse2, "sse2" };
+    }
+    else if ((name == "avx2") && HasAvx2())
+    {
+        GetHexCodec() = HexCodec{ EncodeHexAvx2, DecodeHexAvx2, "avx2" };
+    }
+#endif
+    else
+    {
+        ok = false;
+    }
+    return ok;
 }
 /*****************************************************************************/
 /**
@@ -1003,17 +1295,8 @@ void Util::ByteToHex(const char byte, char *out)
 
 std::string Util::ToHex(const char *buf, size_t size)
 {
-    char out[2];
-    std::string hexstr;
-
-    for (size_t i = 0U; i < size; i++)
-    {
-        ByteToHex(buf[i], &out[0]);
-
-        hexstr += out[0];
-        hexstr += out[1];
-    }
-
+    std::string hexstr(2U * size, '\0');
+    EncodeHex(reinterpret_cast<const uint8_t *>(buf), size, &hexstr[0]);
     return hexstr;
 }
 
@@ -100,7 +100,12 @@ public:
         return ret;
     }
 
-    static void HexStringToUint8(const std::string_view &input, uint8_t *output);
+    static bool HexStringToUint8(const std::string_view &input, uint8_t *output);
+    // Hex codecs on preallocated buffers, vectorized (SSE2/AVX2) when the CPU allows it
+    static void EncodeHex(const uint8_t *input, size_t size, char *output);
+    static bool DecodeHex(const char *input, size_t size, uint8_t *output);
+    static const char *HexCodecName();
+    static bool SelectHexCodec(const std::string &name); // Tests and benchmarks only
     static std::string GenerateRandomString(uint32_t length);
     static void ByteToHex(const char byte, char *out);
     static std::string ToHex(const char *buf, size_t size);
@@ -0,0 +1,179 @@
+/*=============================================================================
+ * TarotClub - WebSocketSession.cpp
+ *=============================================================================
+ * Game protocol over WebSocket, for the browser clients
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include "WebSocketSession.h"
+#include "Log.h"
+
+namespace websocket = boost::beast::websocket;
+
+WebSocketSession::WebSocketSession(asio::ip::tcp::socket socket, std::shared_ptr<ILobbyGateway> lobby, asio::thread_pool &workers, const PoolStrand &lobbyStrand)
+    : ProtocolPeer(lobby, workers, lobbyStrand)
+    , mWs(std::move(socket))
+{
+}
+
+void WebSocketSession::Start()
+{
+    // Everything runs in the strand of the socket
+    asio::dispatch(mWs.get_executor(), [self = Self()]()
+    {
+        self->mWs.set_option(websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+        self->mWs.set_option(websocket::stream_base::decorator([](websocket::response_type &res)
+        {
+            res.set(boost::beast::http::field::server, "TarotClub");
+        }));
+
+        websocket::permessage_deflate pmd;
+        pmd.server_enable = true;
+        self->mWs.set_option(pmd);
+        self->mWs.read_message_max(cMaxMessageSize);
+
+        self->mWs.async_accept(boost::beast::bind_front_handler(&WebSocketSession::OnAccept, self));
+    });
+}
+
+void WebSocketSession::OnAccept(boost::beast::error_code ec)
+{
+    if (ec)
+    {
+        TLogNetwork("[WEBSOCKET] Handshake failed: " + ec.message());
+    }
+    else
+    {
+        TLogInfo("[WEBSOCKET] New peer");
+        if (Register())
+        {
+            DoRead();
+        }
+        else
+        {
+            Close(true);
+        }
+    }
+}
+
+void WebSocketSession::DoRead()
+{
+    mWs.async_read(mBuffer, boost::beast::bind_front_handler(&WebSocketSession::OnRead, Self()));
+}
+
+void WebSocketSession::OnRead(boost::beast::error_code ec, std::size_t length)
+{
+    if (ec)
+    {
+        if (ec == websocket::error::closed)
+        {
+            TLogNetwork("[WEBSOCKET] Peer disconnected");
+        }
+        Close(false);
+    }
+    else
+    {
+        // The frames may span several messages, exactly like the TCP stream
+        std::uint32_t size = static_cast<std::uint32_t>(length);
+        asio::buffer_copy(asio::buffer(mRxParser.Prepare(size), size), mBuffer.data());
+        mRxParser.Commit(size);
+        mBuffer.consume(mBuffer.size());
+        mBinary = mWs.got_binary();
+
+        if (ParseFrames())
+        {
+            DoRead();
+        }
+        else
+        {
+            Close(true);
+        }
+    }
+}
+
+void WebSocketSession::Close(bool graceful)
+{
+    if (!mClosed)
+    {
+        mClosed = true;
+        if (graceful)
+        {
+            mWs.async_close(websocket::close_code::policy_error, [self = Self()](boost::beast::error_code) {});
+        }
+        else
+        {
+            boost::beast::error_code ec;
+            boost::beast::get_lowest_layer(mWs).socket().shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+        }
+        Unregister();
+    }
+}
+
+void WebSocketSession::WriteFrame(std::string &&frame)
+{
+    asio::post(mWs.get_executor(), [self = Self(), frame = std::move(frame)]() mutable
+    {
+        self->DoWrite(std::move(frame));
+    });
+}
+
+void WebSocketSession::DoWrite(std::string &&frame)
+{
+    // The amount of frames given by the protocol layer is bounded (ProtocolPeer::cTxBudget)
+    if (!mClosed && mWriteQueue.Push(std::move(frame)))
+    {
+        // Only one write in flight; frames queued meanwhile are sent together in the next message
+        StartWrite();
+    }
+}
+
+void WebSocketSession::Abort()
+{
+    // A write may be blocked by the peer: no closing handshake
+    asio::post(mWs.get_executor(), [self = Self()]() { self->Close(false); });
+}
+
+void WebSocketSession::StartWrite()
+{
+    mWs.binary(mBinary);
+    mWs.async_write(mWriteQueue.Prepare(), [self = Self()](boost::beast::error_code ec, std::size_t /*length*/)
+    {
+        if (!ec)
+        {
+            std::uint64_t pending = self->mWriteQueue.BytesPending();
+            bool more = self->mWriteQueue.Complete();
+            self->FramesSent(pending - self->mWriteQueue.BytesPending());
+            if (more)
+            {
+                self->StartWrite();
+            }
+        }
+        else
+        {
+            TLogNetwork("[WEBSOCKET] Write error, dropping outgoing frames");
+            self->mWriteQueue.Clear();
+        }
+    });
+}
+
+//=============================================================================
+// End of file WebSocketSession.cpp
+//=============================================================================
@@ -0,0 +1,75 @@
+/*=============================================================================
+ * TarotClub - WebSocketSession.h
+ *=============================================================================
+ * Game protocol over WebSocket, for the browser clients
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#ifndef WEBSOCKET_SESSION_H
+#define WEBSOCKET_SESSION_H
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include "Server.h"
+
+/*****************************************************************************/
+/**
+ * @brief The WebSocketSession class
+ *
+ * Same frames as the raw TCP protocol (PeerSession), carried in WebSocket
+ * messages. A message may contain several frames: each frame has its own
+ * length in its header. Replies use the message type (binary or text) of
+ * the last message received, binary by default.
+ *
+ * permessage-deflate is accepted when the client proposes it. The socket
+ * must have been accepted on a strand: all the handlers run on it.
+ */
+class WebSocketSession : public ProtocolPeer
+{
+public:
+    WebSocketSession(boost::asio::ip::tcp::socket socket, std::shared_ptr<ILobbyGateway> lobby, boost::asio::thread_pool &workers, const PoolStrand &lobbyStrand);
+
+    void Start();
+
+    static const std::uint32_t cMaxMessageSize  = 64U * 1024U;      ///< Incoming, a few frames at most
+
+private:
+    boost::beast::websocket::stream<boost::beast::tcp_stream> mWs;
+    boost::beast::flat_buffer mBuffer;
+    bool mBinary = true;
+    bool mClosed = false;
+
+    std::shared_ptr<WebSocketSession> Self() { return std::static_pointer_cast<WebSocketSession>(shared_from_this()); }
+    void OnAccept(boost::beast::error_code ec);
+    void DoRead();
+    void OnRead(boost::beast::error_code ec, std::size_t length);
+    void Close(bool graceful);
+    virtual void WriteFrame(std::string &&frame) override;
+    virtual void Abort() override;
+    void DoWrite(std::string &&frame);
+    void StartWrite();
+};
+
+#endif // WEBSOCKET_SESSION_H
+
+//=============================================================================
+// End of file WebSocketSession.h
+//=============================================================================
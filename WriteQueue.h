@@ -0,0 +1,126 @@
+/**
+ * MIT License
+ * Copyright (c) 2019 Anthony Rabine
+ */
+
+#ifndef WRITE_QUEUE_H
+#define WRITE_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include "FramePool.h"
+
+/*****************************************************************************/
+/**
+ * @brief The WriteQueue class
+ *
+ * Outgoing frames of one connection. Only one write is in flight at a time
+ * (Asio does not allow concurrent writes on a socket); frames queued during
+ * that write are sent all together in the next gather write.
+ * The queue owns the frames until the write completes, then gives them back
+ * to the FramePool.
+ *
+ * Not thread safe: must be used from the socket strand. Only the statistics
+ * (depth and bytes pending) can be read from any thread.
+ *
+ * Usage:
+ *   if (queue.Push(frame)) { async_write(socket, queue.Prepare(), handler); }
+ *   handler: if (queue.Complete()) { async_write(socket, queue.Prepare(), handler); }
+ */
+class WriteQueue
+{
+public:
+    WriteQueue()
+        : mWriting(false)
+        , mDepth(0U)
+        , mBytesPending(0U)
+    {
+
+    }
+
+    /**
+     * @brief Queue a frame
+     * @return true if no write is in flight: the caller must start one
+     */
+    bool Push(std::string &&frame)
+    {
+        mBytesPending += frame.size();
+        mDepth++;
+        mPending.push_back(std::move(frame));
+        return !mWriting;
+    }
+
+    /**
+     * @brief Move all the pending frames into the in-flight list
+     * @return the buffer sequence to give to the write operation
+     */
+    const std::vector<boost::asio::const_buffer> &Prepare()
+    {
+        mWriting = true;
+        mInFlight.swap(mPending);
+        mPending.clear();
+
+        mBuffers.clear();
+        for (const auto &f : mInFlight)
+        {
+            mBuffers.push_back(boost::asio::buffer(f));
+        }
+        return mBuffers;
+    }
+
+    /**
+     * @brief Release the frames sent by the last write
+     * @return true if other frames have been queued meanwhile: the caller must start a new write
+     */
+    bool Complete()
+    {
+        for (auto &f : mInFlight)
+        {
+            mBytesPending -= f.size();
+            FramePool::Instance().Release(std::move(f));
+        }
+        mDepth -= static_cast<std::uint32_t>(mInFlight.size());
+        mInFlight.clear();
+        mWriting = !mPending.empty();
+        return mWriting;
+    }
+
+    void Clear()
+    {
+        for (auto &f : mPending)
+        {
+            FramePool::Instance().Release(std::move(f));
+        }
+        for (auto &f : mInFlight)
+        {
+            FramePool::Instance().Release(std::move(f));
+        }
+        mPending.clear();
+        mInFlight.clear();
+        mBuffers.clear();
+        mWriting = false;
+        mDepth = 0U;
+        mBytesPending = 0U;
+    }
+
+    bool IsWriting() const { return mWriting; }
+    std::uint32_t Depth() const { return mDepth; }                  ///< Number of frames queued or in flight
+    std::uint64_t BytesPending() const { return mBytesPending; }    ///< Number of bytes queued or in flight
+
+private:
+    std::vector<std::string> mPending;
+    std::vector<std::string> mInFlight;
+    std::vector<boost::asio::const_buffer> mBuffers;
+    bool mWriting;
+    std::atomic<std::uint32_t> mDepth;
+    std::atomic<std::uint64_t> mBytesPending;
+};
+
+#endif // WRITE_QUEUE_H
+
+//=============================================================================
+// End of file WriteQueue.h
+//=============================================================================
@@ -0,0 +1,211 @@
+/*=============================================================================
+ * TarotClub - FrameParserFuzz.cpp
+ *=============================================================================
+ * Fuzz test of the stream frame parser: random chunk boundaries and hostile headers
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "FrameParser.h"
+#include "Protocol.h"
+
+/**
+ * Build and run it with the core library, preferably with -fsanitize=address:
+ *   FrameParserFuzz [iterations] [seed]
+ * Returns 0 if all the checks pass.
+ */
+
+static int gFailures = 0;
+
+#define CHECK(cond, msg) do { if (!(cond)) { gFailures++; std::printf("FAILED: %s (%s:%d)\n", msg, __FILE__, __LINE__); } } while (0)
+
+static const std::string cKey = "0123456789abcdef";
+
+/*****************************************************************************/
+/**
+ * @brief Feed
+ *
+ * Pushes the stream into the parser in random chunks, extracting the frames
+ * after each read as the server does. Stops at the first error.
+ *
+ * @return false if the parser reported an error
+ */
+static bool Feed(std::mt19937 &rng, const std::string &stream, Protocol &rx, std::vector<std::string> &messages)
+{
+    FrameParser parser;
+    std::size_t offset = 0U;
+
+    while (offset < stream.size())
+    {
+        std::uint32_t chunk = 1U + (rng() % 3000U);
+        if (rng() % 4U == 0U)
+        {
+            chunk = 1U + (rng() % 8U); // Tiny reads, splitting the header
+        }
+        chunk = static_cast<std::uint32_t>(std::min<std::size_t>(chunk, stream.size() - offset));
+
+        std::memcpy(parser.Prepare(chunk), &stream[offset], chunk);
+        parser.Commit(chunk);
+        offset += chunk;
+
+        Protocol::Header h;
+        FrameParser::Status status;
+        while ((status = parser.Next(rx, h)) != FrameParser::FRAME_INCOMPLETE)
+        {
+            if (status == FrameParser::FRAME_ERROR)
+            {
+                return false;
+            }
+
+            CHECK(h.BodyLength() < PROTO_MAX_BODY_SIZE, "body length out of bounds");
+            CHECK(parser.Size() >= (PROTO_HEADER_SIZE + h.BodyLength()), "frame not fully buffered");
+
+            std::string message;
+            if (rx.DecryptPayload(message, h, parser.Frame()))
+            {
+                messages.push_back(message);
+            }
+            parser.Consume(h);
+        }
+    }
+    return true;
+}
+/*****************************************************************************/
+static std::string RandomMessage(std::mt19937 &rng)
+{
+    std::string message = "{\"cmd\":\"Chat\",\"text\":\"";
+    std::uint32_t size = rng() % 3000U;
+    for (std::uint32_t i = 0U; i < size; i++)
+    {
+        message.push_back(static_cast<char>('a' + (rng() % 26U)));
+    }
+    return message + "\"}";
+}
+/*****************************************************************************/
+// Valid frames, pipelined and split at random places
+static void TestChunkBoundaries(std::mt19937 &rng, std::uint32_t iterations)
+{
+    for (std::uint32_t i = 0U; i < iterations; i++)
+    {
+        Protocol tx;
+        Protocol rx;
+        tx.SetSecurity(cKey);
+        rx.SetSecurity(cKey);
+
+        std::vector<std::string> sent;
+        std::string stream;
+        std::uint32_t frames = 1U + (rng() % 20U);
+        for (std::uint32_t f = 0U; f < frames; f++)
+        {
+            sent.push_back(RandomMessage(rng));
+            stream += tx.Build(10U, 1U, sent.back(), (rng() % 2U) ? "web_id" : "");
+        }
+
+        std::vector<std::string> received;
+        CHECK(Feed(rng, stream, rx, received), "valid stream rejected");
+        CHECK(received == sent, "messages lost or corrupted");
+    }
+}
+/*****************************************************************************/
+// Headers with signed, blank, prefixed or wrapping fields must be rejected
+static void TestHostileHeaders(std::mt19937 &rng)
+{
+    static const char *cHeaders[] = {
+        "01:000a:0001:-002:0000:0001:X:",   // Negative payload size: 0xFFFFFFFE
+        "01:000a:0001:0064:0000:-001:X:",   // Negative prefix size
+        "01:000a:0001:+064:0000:0001:X:",
+        "01:000a:0001: 064:0000:0001:X:",
+        "01:000a:0001:0x64:0000:0001:X:",
+        "01:000a:0001:fffe:0000:0001:X:",   // payload + prefix + 1 wraps a 16-bit sum
+        "01:000a:0001:0001:0000:ffff:X:",
+        "01:000a:0001:2800:0000:0000::",    // Exactly PROTO_MAX_BODY_SIZE
+        "-1:000a:0001:0010:0000:0000::",
+        "01:-00a:0001:0010:0000:0000::",
+        "01:000a:0001:0010:-000:0000::",
+        "01;000a:0001:0010:0000:0000::",
+    };
+
+    for (const char *header : cHeaders)
+    {
+        Protocol proto;
+        Protocol::Header h;
+        CHECK(!proto.ParseHeader(h, header), header);
+
+        Protocol rx;
+        rx.SetSecurity(cKey);
+        std::string stream = std::string(header) + std::string(64U, '0');
+        std::vector<std::string> received;
+        CHECK(!Feed(rng, stream, rx, received), header);
+        CHECK(received.empty(), header);
+    }
+
+    // Upper case digits are valid hex
+    Protocol proto;
+    Protocol::Header h;
+    CHECK(proto.ParseHeader(h, "01:000A:0001:00FF:0000:0000::") && (h.src_uid == 10U) && (h.payload_size == 255U), "upper case hex");
+}
+/*****************************************************************************/
+// Random bytes and mutated frames: whatever happens, no read out of the buffer
+static void TestGarbage(std::mt19937 &rng, std::uint32_t iterations)
+{
+    static const char cAlphabet[] = "0123456789abcdefABCDEF:-+x ";
+
+    for (std::uint32_t i = 0U; i < iterations; i++)
+    {
+        Protocol tx;
+        Protocol rx;
+        tx.SetSecurity(cKey);
+        rx.SetSecurity(cKey);
+
+        std::string stream = tx.Build(10U, 1U, RandomMessage(rng));
+        std::uint32_t mutations = 1U + (rng() % 4U);
+        for (std::uint32_t m = 0U; m < mutations; m++)
+        {
+            std::size_t pos = rng() % ((rng() % 2U) ? PROTO_HEADER_SIZE : stream.size());
+            stream[pos] = cAlphabet[rng() % (sizeof(cAlphabet) - 1U)];
+        }
+
+        std::vector<std::string> received;
+        (void) Feed(rng, stream, rx, received);
+    }
+}
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+    std::uint32_t iterations = (argc > 1) ? static_cast<std::uint32_t>(std::atoi(argv[1])) : 2000U;
+    std::uint32_t seed = (argc > 2) ? static_cast<std::uint32_t>(std::atoi(argv[2])) : 1234U;
+    std::mt19937 rng(seed);
+
+    TestChunkBoundaries(rng, iterations);
+    TestHostileHeaders(rng);
+    TestGarbage(rng, iterations * 10U);
+
+    std::printf("FrameParserFuzz: %d failure(s)\n", gFailures);
+    return (gFailures == 0) ? 0 : 1;
+}
+
+//=============================================================================
+// End of file FrameParserFuzz.cpp
+//=============================================================================
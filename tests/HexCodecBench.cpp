@@ -0,0 +1,260 @@
+/*=============================================================================
+ * TarotClub - HexCodecBench.cpp
+ *=============================================================================
+ * Hex codecs of Util: checked against the previous functions, then benchmarked
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Util.h"
+
+/**
+ * Build it with the core library, with the optimization flags of the server:
+ *   HexCodecBench [bench milliseconds] [seed]
+ * Each implementation available on this CPU (scalar, sse2, avx2) is checked
+ * against the functions used before the vectorized codecs, then its speed is
+ * compared to them. A duration of 0 only runs the checks.
+ * Returns 0 if all the checks pass.
+ */
+
+static int gFailures = 0;
+
+#define CHECK(cond, msg) do { if (!(cond)) { gFailures++; std::printf("FAILED: %s (%s:%d)\n", msg, __FILE__, __LINE__); } } while (0)
+
+static const char *cCodecs[] = { "scalar", "sse2", "avx2" };
+
+/*****************************************************************************/
+// Reference: Util::ToHex() before the vectorized codecs
+static std::string OldToHex(const char *buf, size_t size)
+{
+    static const char binHex[] = "0123456789ABCDEF";
+    std::string hexstr;
+
+    for (size_t i = 0U; i < size; i++)
+    {
+        char out[2];
+        out[0] = binHex[(buf[i] >> 4) & 0x0F];
+        out[1] = binHex[buf[i] & 0x0F];
+        hexstr += out[0];
+        hexstr += out[1];
+    }
+    return hexstr;
+}
+/*****************************************************************************/
+// Reference: Util::HexStringToUint8() before the vectorized codecs, valid input only
+static void OldHexStringToUint8(const std::string_view &input, uint8_t *output)
+{
+    for (size_t i = 0; i < input.length(); i += 2)
+    {
+        std::stringstream converter;
+        converter << std::hex << input.substr(i, 2);
+        int byte;
+        converter >> byte;
+        output[i/2] = byte & 0xFF;
+    }
+}
+/*****************************************************************************/
+static bool IsHexDigit(char c)
+{
+    return ((c >= '0') && (c <= '9')) || ((c >= 'A') && (c <= 'F')) || ((c >= 'a') && (c <= 'f'));
+}
+/*****************************************************************************/
+static std::string Encode(const std::vector<uint8_t> &data)
+{
+    std::string hex(2U * data.size(), '\0');
+    Util::EncodeHex(data.data(), data.size(), &hex[0]);
+    return hex;
+}
+/*****************************************************************************/
+// Random buffers of 0 to 600 bytes: every tail length of the vector loops
+static void TestRandomBuffers(std::mt19937 &rng)
+{
+    for (std::uint32_t i = 0U; i < 3000U; i++)
+    {
+        std::vector<uint8_t> data(rng() % 601U);
+        for (auto &b : data)
+        {
+            b = static_cast<uint8_t>(rng());
+        }
+
+        std::string hex = Encode(data);
+        CHECK(hex == OldToHex(reinterpret_cast<const char *>(data.data()), data.size()), "encoding differs from the old one");
+
+        std::vector<uint8_t> decoded(data.size());
+        std::vector<uint8_t> expected(data.size());
+        CHECK(Util::DecodeHex(hex.data(), hex.size(), decoded.data()), "valid input rejected");
+        OldHexStringToUint8(hex, expected.data());
+        CHECK(decoded == expected, "decoding differs from the old one");
+        CHECK(decoded == data, "round trip failed");
+    }
+}
+/*****************************************************************************/
+// Every byte value, upper and lower case
+static void TestAllBytes()
+{
+    std::vector<uint8_t> data(256U);
+    for (std::uint32_t i = 0U; i < 256U; i++)
+    {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    std::string hex = Encode(data);
+    CHECK(hex == OldToHex(reinterpret_cast<const char *>(data.data()), data.size()), "encoding of the 256 byte values differs");
+
+    std::string lower = hex;
+    for (auto &c : lower)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    std::vector<uint8_t> decoded(data.size());
+    CHECK(Util::DecodeHex(hex.data(), hex.size(), decoded.data()) && (decoded == data), "upper case decoding of the 256 byte values");
+    CHECK(Util::DecodeHex(lower.data(), lower.size(), decoded.data()) && (decoded == data), "lower case decoding of the 256 byte values");
+}
+/*****************************************************************************/
+// One mutated character, at any lane of the vector loops: only a hex digit is accepted
+static void TestMutatedInput(std::mt19937 &rng)
+{
+    for (std::uint32_t i = 0U; i < 2000U; i++)
+    {
+        std::vector<uint8_t> data(1U + (rng() % 200U));
+        for (auto &b : data)
+        {
+            b = static_cast<uint8_t>(rng());
+        }
+        std::string hex = Encode(data);
+        std::size_t pos = rng() % hex.size();
+        char c = static_cast<char>(rng() % 256U);
+        hex[pos] = c;
+
+        std::vector<uint8_t> decoded(data.size());
+        bool ok = Util::DecodeHex(hex.data(), hex.size(), decoded.data());
+        CHECK(ok == IsHexDigit(c), "mutated character not detected");
+        if (ok)
+        {
+            std::vector<uint8_t> expected(data.size());
+            OldHexStringToUint8(hex, expected.data());
+            CHECK(decoded == expected, "decoding of a mutated digit differs from the old one");
+        }
+    }
+
+    // All the characters, at each position of a 64 character block
+    std::string block(64U, '0');
+    uint8_t out[32];
+    for (std::size_t pos = 0U; pos < block.size(); pos++)
+    {
+        for (std::uint32_t c = 0U; c < 256U; c++)
+        {
+            std::string s = block;
+            s[pos] = static_cast<char>(c);
+            CHECK(Util::DecodeHex(s.data(), s.size(), out) == IsHexDigit(s[pos]), "invalid character accepted, or valid one refused");
+        }
+    }
+
+    CHECK(!Util::DecodeHex("ABC", 3U, out), "odd length accepted");
+}
+/*****************************************************************************/
+// MB/s of binary data
+template<typename F>
+static double Rate(std::size_t size, std::uint32_t durationMs, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t bytes = 0U;
+    double elapsed = 0.0;
+
+    do
+    {
+        for (std::uint32_t i = 0U; i < 16U; i++)
+        {
+            f();
+            bytes += size;
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    while (elapsed < (durationMs / 1000.0));
+
+    return (bytes / elapsed) / 1e6;
+}
+/*****************************************************************************/
+static void Benchmark(std::mt19937 &rng, std::uint32_t durationMs)
+{
+    static const std::size_t cSizes[] = { 64U, 1024U, 4096U, 10240U };
+
+    std::printf("   size    encode old -> new (MB/s)    decode old -> new (MB/s)\n");
+    for (auto size : cSizes)
+    {
+        std::vector<uint8_t> data(size);
+        for (auto &b : data)
+        {
+            b = static_cast<uint8_t>(rng());
+        }
+        std::string hex = Encode(data);
+        std::vector<uint8_t> decoded(size);
+        volatile std::size_t sink = 0U;
+
+        double encOld = Rate(size, durationMs, [&]() { sink = sink + OldToHex(reinterpret_cast<const char *>(data.data()), size).size(); });
+        double encNew = Rate(size, durationMs, [&]() { Util::EncodeHex(data.data(), size, &hex[0]); sink = sink + static_cast<uint8_t>(hex[0]); });
+        double decOld = Rate(size, durationMs, [&]() { OldHexStringToUint8(hex, decoded.data()); sink = sink + decoded[0]; });
+        double decNew = Rate(size, durationMs, [&]() { sink = sink + Util::DecodeHex(hex.data(), hex.size(), decoded.data()); });
+
+        std::printf("  %5zu    %8.0f -> %8.0f (x%.0f)    %8.1f -> %8.0f (x%.0f)\n", size,
+                    encOld, encNew, encNew / encOld, decOld, decNew, decNew / decOld);
+    }
+}
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+    std::uint32_t durationMs = (argc > 1) ? static_cast<std::uint32_t>(std::atoi(argv[1])) : 200U;
+    std::uint32_t seed = (argc > 2) ? static_cast<std::uint32_t>(std::atoi(argv[2])) : 1234U;
+
+    for (auto codec : cCodecs)
+    {
+        if (!Util::SelectHexCodec(codec))
+        {
+            std::printf("%s: not available on this CPU\n", codec);
+            continue;
+        }
+        std::printf("%s\n", Util::HexCodecName());
+
+        std::mt19937 rng(seed);
+        TestRandomBuffers(rng);
+        TestAllBytes();
+        TestMutatedInput(rng);
+        if (durationMs > 0U)
+        {
+            Benchmark(rng, durationMs);
+        }
+    }
+
+    std::printf("HexCodecBench: %d failure(s)\n", gFailures);
+    return (gFailures == 0) ? 0 : 1;
+}
+
+//=============================================================================
+// End of file HexCodecBench.cpp
+//=============================================================================
@@ -0,0 +1,926 @@
+/*=============================================================================
+ * TarotClub - JsonReaderBench.cpp
+ *=============================================================================
+ * JSON reader: compared with the previous parser, then benchmarked
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "JsonReader.h"
+#include "DealGenerator.h"
+
+/**
+ * Build it with the core library, with the optimization flags of the server:
+ *   JsonReaderBench [documents] [bench milliseconds] [seed]
+ * Random and mutated documents are parsed by the reader and by a copy of the
+ * parser it replaced: both must accept the same documents and build the same
+ * values. The intended differences (number conversion) are checked apart.
+ * Then both parsers are timed on protocol messages and deal files; a duration
+ * of 0 only runs the checks.
+ * Returns 0 if all the checks pass.
+ */
+
+static int gFailures = 0;
+
+#define CHECK(cond, msg) do { if (!(cond)) { gFailures++; std::printf("FAILED: %s (%s:%d)\n", msg, __FILE__, __LINE__); } } while (0)
+
+/*****************************************************************************/
+/**
+ * @brief The OldJsonReader class
+ *
+ * Reference: JsonReader before the single-pass parser, on a copy of the input
+ * with a std::map of the open nodes. Do not give it an exponent of ten digits
+ * or more, it never returns.
+ */
+class OldJsonReader
+{
+public:
+    static bool ParseString(JsonValue &json, const std::string &data)
+    {
+        // It read one byte past the end of an unterminated document ending by a space
+        char *endptr;
+        std::vector<char> source(data.c_str(), data.c_str() + std::strlen(data.c_str()));
+        source.resize(source.size() + 2U, '\0');
+        return Parse(source.data(), &endptr, json) == JsonReader::JSON_PARSE_OK;
+    }
+
+private:
+    static inline bool IsDelim(char c)
+    {
+        return isspace(c) || c == ',' || c == ':' || c == ']' || c == '}' || c == '\0';
+    }
+
+    static inline int CharToInt(char c)
+    {
+        if (c >= 'a')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A')
+        {
+            return c - 'A' + 10;
+        }
+        return c - '0';
+    }
+
+    static JsonReader::ParseStatus Parse(char *s, char **endptr, JsonValue &json);
+    static JsonValue StringToNumber(char *s, char **endptr);
+};
+/*****************************************************************************/
+JsonReader::ParseStatus OldJsonReader::Parse(char *s, char **endptr, JsonValue &json)
+{
+    int pos = -1;
+    int prev = -1;
+    std::map<int, JsonValue::Tag> tags;
+    std::map<int, std::string> keys;
+    std::map<int, JsonValue> nodes;
+
+    bool separator = true;
+    *endptr = s;
+
+    while (*s)
+    {
+        JsonValue o;
+        while (*s && isspace(*s))
+        {
+            ++s;
+        }
+
+        *endptr = s++;
+        switch (**endptr)
+        {
+            case '\0':
+                continue;
+            case '-':
+                if (!isdigit(*s) && *s != '.')
+                {
+                    *endptr = s;
+                    return JsonReader::JSON_PARSE_BAD_NUMBER;
+                }
+                /* fallthrough */
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                o = JsonValue(StringToNumber(*endptr, &s));
+                if (!IsDelim(*s))
+                {
+                    *endptr = s;
+                    return JsonReader::JSON_PARSE_BAD_NUMBER;
+                }
+                break;
+            case '"':
+            {
+                std::string temp;
+                while (*s)
+                {
+                    int c = *s;
+                    if (c == '\\')
+                    {
+                        c = *++s;
+                        switch (c)
+                        {
+                            case '\\':
+                            case '"':
+                            case '/':
+                                temp.push_back(c);
+                                break;
+                            case 'b':
+                                temp.push_back('\b');
+                                break;
+                            case 'f':
+                                temp.push_back('\f');
+                                break;
+                            case 'n':
+                                temp.push_back('\n');
+                                break;
+                            case 'r':
+                                temp.push_back('\r');
+                                break;
+                            case 't':
+                                temp.push_back('\t');
+                                break;
+                            case 'u':
+                                c = 0;
+                                for (int i = 0; i < 4; ++i)
+                                {
+                                    if (!isxdigit(*++s))
+                                    {
+                                        *endptr = s;
+                                        return JsonReader::JSON_PARSE_BAD_STRING;
+                                    }
+                                    c = c * 16 + CharToInt(*s);
+                                }
+                                if (c < 0x80)
+                                {
+                                    temp.push_back(c);
+                                }
+                                else if (c < 0x800)
+                                {
+                                    temp.push_back(0xC0 | (c >> 6));
+                                    temp.push_back(0x80 | (c & 0x3F));
+                                }
+                                else
+                                {
+                                    temp.push_back(0xE0 | (c >> 12));
+                                    temp.push_back(0x80 | ((c >> 6) & 0x3F));
+                                    temp.push_back(0x80 | (c & 0x3F));
+                                }
+                                break;
+                            default:
+                                *endptr = s;
+                                return JsonReader::JSON_PARSE_BAD_STRING;
+                        }
+                    }
+                    else if (iscntrl(c))
+                    {
+                        *endptr = s;
+                        return JsonReader::JSON_PARSE_BAD_STRING;
+                    }
+                    else if (c == '"')
+                    {
+                        ++s;
+                        break;
+                    }
+                    else
+                    {
+                        temp.push_back(c);
+                    }
+                    s++;
+                }
+
+                o = JsonValue(temp);
+                if (!IsDelim(*s))
+                {
+                    *endptr = s;
+                    return JsonReader::JSON_PARSE_BAD_STRING;
+                }
+                break;
+            }
+            case 't':
+                for (const char *it = "rue"; *it; ++it, ++s)
+                {
+                    if (*it != *s)
+                    {
+                        return JsonReader::JSON_PARSE_BAD_IDENTIFIER;
+                    }
+                }
+                if (!IsDelim(*s))
+                {
+                    return JsonReader::JSON_PARSE_BAD_IDENTIFIER;
+                }
+                o = JsonValue(true);
+                break;
+            case 'f':
+                for (const char *it = "alse"; *it; ++it, ++s)
+                {
+                    if (*it != *s)
+                    {
+                        return JsonReader::JSON_PARSE_BAD_IDENTIFIER;
+                    }
+                }
+                if (!IsDelim(*s))
+                {
+                    return JsonReader::JSON_PARSE_BAD_IDENTIFIER;
+                }
+                o = JsonValue(false);
+                break;
+            case 'n':
+                for (const char *it = "ull"; *it; ++it, ++s)
+                {
+                    if (*it != *s)
+                    {
+                        return JsonReader::JSON_PARSE_BAD_IDENTIFIER;
+                    }
+                }
+                if (!IsDelim(*s))
+                {
+                    return JsonReader::JSON_PARSE_BAD_IDENTIFIER;
+                }
+                o.SetNull();
+                break;
+            case ']':
+            case '}':
+                if (pos == -1)
+                {
+                    return JsonReader::JSON_PARSE_STACK_UNDERFLOW;
+                }
+                if (tags[pos] != ((**endptr == ']') ? JsonValue::ARRAY : JsonValue::OBJECT))
+                {
+                    return JsonReader::JSON_PARSE_MISMATCH_BRACKET;
+                }
+                if ((**endptr == '}') && (keys[pos] != ""))
+                {
+                    return JsonReader::JSON_PARSE_UNEXPECTED_CHARACTER;
+                }
+
+                if (pos > 0)
+                {
+                    prev = pos - 1;
+                    if (tags[prev] == JsonValue::OBJECT)
+                    {
+                        nodes[prev].GetObj().AddValue(keys[prev], nodes[pos]);
+                    }
+                    else
+                    {
+                        nodes[prev].GetArray().AddValue(nodes[pos]);
+                    }
+
+                    nodes.erase(pos);
+                    pos--;
+                    keys[pos] = "";
+                    separator = false;
+                }
+                else
+                {
+                    json = nodes[0];
+                    *endptr = s;
+                    return JsonReader::JSON_PARSE_OK;
+                }
+                continue;
+            case '[':
+                ++pos;
+                nodes[pos] = JsonValue(JsonArray());
+                tags[pos] = JsonValue::ARRAY;
+                keys[pos] = "";
+                separator = true;
+                continue;
+            case '{':
+                ++pos;
+                nodes[pos] = JsonValue(JsonObject());
+                tags[pos] = JsonValue::OBJECT;
+                keys[pos] = "";
+                separator = true;
+                continue;
+            case ':':
+                if (separator || keys[pos] == "")
+                {
+                    return JsonReader::JSON_PARSE_UNEXPECTED_CHARACTER;
+                }
+                separator = true;
+                continue;
+            case ',':
+                if (separator || keys[pos] != "")
+                {
+                    return JsonReader::JSON_PARSE_UNEXPECTED_CHARACTER;
+                }
+                separator = true;
+                continue;
+            default:
+                return JsonReader::JSON_PARSE_UNEXPECTED_CHARACTER;
+        }
+        separator = false;
+
+        if (tags[pos] == JsonValue::OBJECT)
+        {
+            if (keys[pos] == "")
+            {
+                if (o.GetTag() != JsonValue::STRING)
+                {
+                    return JsonReader::JSON_PARSE_UNQUOTED_KEY;
+                }
+                keys[pos] = o.GetString();
+                continue;
+            }
+
+            if (nodes[pos].IsObject())
+            {
+                nodes[pos].GetObj().AddValue(keys[pos], o);
+                keys[pos] = "";
+            }
+            else
+            {
+                return JsonReader::JSON_PARSE_ALLOC_ERROR;
+            }
+        }
+        else
+        {
+            if (nodes[pos].IsArray())
+            {
+                nodes[pos].GetArray().AddValue(o);
+                keys[pos] = "";
+            }
+            else
+            {
+                return JsonReader::JSON_PARSE_ALLOC_ERROR;
+            }
+        }
+    }
+    return JsonReader::JSON_PARSE_BREAKING_BAD;
+}
+/*****************************************************************************/
+JsonValue OldJsonReader::StringToNumber(char *s, char **endptr)
+{
+    char ch = *s;
+    if (ch == '+' || ch == '-')
+    {
+        ++s;
+    }
+
+    double result = 0;
+    bool doubleValue = false;
+    JsonValue retVal;
+
+    while (isdigit(*s))
+    {
+        result = (result * 10) + (*s++ - '0');
+    }
+
+    if (*s == '.')
+    {
+        ++s;
+        doubleValue = true;
+
+        double fraction = 1;
+        while (isdigit(*s))
+        {
+            fraction *= 0.1;
+            result += (*s++ - '0') * fraction;
+        }
+    }
+
+    if (*s == 'e' || *s == 'E')
+    {
+        ++s;
+        doubleValue = true;
+
+        double base = 10;
+        if (*s == '+')
+        {
+            ++s;
+        }
+        else if (*s == '-')
+        {
+            ++s;
+            base = 0.1;
+        }
+
+        int exponent = 0;
+        while (isdigit(*s))
+        {
+            exponent = (exponent * 10) + (*s++ - '0');
+        }
+
+        double power = 1;
+        for (; exponent; exponent >>= 1, base *= base)
+        {
+            if (exponent & 1)
+            {
+                power *= base;
+            }
+        }
+
+        result *= power;
+    }
+
+    *endptr = s;
+
+    result = (ch == '-') ? -result : result;
+
+    if (doubleValue)
+    {
+        retVal = result;
+    }
+    else
+    {
+        retVal = static_cast<std::int64_t>(result);
+    }
+
+    return retVal;
+}
+
+/*****************************************************************************/
+// Differences allowed: the old parser accumulated the digits in a double
+struct Differences
+{
+    std::uint64_t roundedDoubles = 0U;
+    std::uint64_t largeIntegers = 0U;
+};
+/*****************************************************************************/
+static bool SameValue(const JsonValue &a, const JsonValue &b, Differences &diff)
+{
+    if (a.GetTag() != b.GetTag())
+    {
+        return false;
+    }
+
+    switch (a.GetTag())
+    {
+        case JsonValue::INTEGER:
+            if (a.GetInteger64() != b.GetInteger64())
+            {
+                // Only beyond 2^53, where a double cannot hold every integer
+                double x = static_cast<double>(a.GetInteger64());
+                double y = static_cast<double>(b.GetInteger64());
+                if ((std::fabs(x) < 9007199254740992.0) || (std::fabs(x - y) > std::fabs(x) * 1e-12))
+                {
+                    return false;
+                }
+                diff.largeIntegers++;
+            }
+            return true;
+        case JsonValue::DOUBLE:
+        {
+            double x = a.GetDouble();
+            double y = b.GetDouble();
+            if (x != y)
+            {
+                // Subnormals have less precision: the old parser lost most of it
+                bool subnormal = (std::fabs(x) < std::numeric_limits<double>::min()) &&
+                                 (std::fabs(y) < std::numeric_limits<double>::min());
+                if (std::isinf(x) || std::isinf(y) || (!subnormal && (std::fabs(x - y) > std::fabs(x) * 1e-12)))
+                {
+                    return false;
+                }
+                diff.roundedDoubles++;
+            }
+            return true;
+        }
+        case JsonValue::BOOLEAN:
+            return a.GetBool() == b.GetBool();
+        case JsonValue::STRING:
+            return a.GetString() == b.GetString();
+        case JsonValue::ARRAY:
+        {
+            JsonArray x = const_cast<JsonValue &>(a).GetArray();
+            JsonArray y = const_cast<JsonValue &>(b).GetArray();
+            if (x.Size() != y.Size())
+            {
+                return false;
+            }
+            for (std::uint32_t i = 0U; i < x.Size(); i++)
+            {
+                if (!SameValue(x.GetEntry(i), y.GetEntry(i), diff))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case JsonValue::OBJECT:
+        {
+            JsonObject &x = const_cast<JsonValue &>(a).GetObj();
+            JsonObject &y = const_cast<JsonValue &>(b).GetObj();
+            std::vector<std::string> keys = x.GetKeys();
+            if (keys != y.GetKeys())
+            {
+                return false;
+            }
+            for (const auto &k : keys)
+            {
+                // The generated keys have no ':', the separator of the key paths
+                if (!SameValue(x.GetValue(k), y.GetValue(k), diff))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+/*****************************************************************************/
+static std::string Spaces(std::mt19937 &rng)
+{
+    static const char cSpaces[] = " \t\r\n";
+    std::string s;
+    while ((rng() % 4U) == 0U)
+    {
+        s.push_back(cSpaces[rng() % 4U]);
+    }
+    return s;
+}
+/*****************************************************************************/
+static std::string RandomNumber(std::mt19937 &rng)
+{
+    std::string n = ((rng() % 4U) == 0U) ? "-" : "";
+    std::uint32_t kind = rng() % 4U;
+
+    if (kind == 0U)
+    {
+        n += std::to_string(rng() % 100U);
+    }
+    else if (kind == 1U)
+    {
+        // Up to 2^53: the old parser was exact there
+        std::uint64_t v = ((static_cast<std::uint64_t>(rng()) << 32) | rng()) % 9007199254740992ULL;
+        n += std::to_string(v);
+    }
+    else
+    {
+        n += std::to_string(rng() % 100000U);
+        if ((kind == 2U) || ((rng() % 2U) == 0U))
+        {
+            n += "." + std::to_string(rng() % 1000000U);
+        }
+        if (kind == 3U)
+        {
+            static const char *cSigns[] = { "e", "E", "e+", "e-", "E-" };
+            n += cSigns[rng() % 5U] + std::to_string(rng() % 300U);
+        }
+    }
+    return n;
+}
+/*****************************************************************************/
+static std::string RandomString(std::mt19937 &rng, bool key)
+{
+    static const char *cEscapes[] = { "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t", "\\u00e9", "\\u20AC", "\\u0041" };
+    std::string s = "\"";
+    std::uint32_t size = rng() % 24U;
+
+    for (std::uint32_t i = 0U; i < size; i++)
+    {
+        if (!key && ((rng() % 8U) == 0U))
+        {
+            s += cEscapes[rng() % 11U];
+        }
+        else
+        {
+            char c = static_cast<char>(' ' + (rng() % 95U));
+            if ((c == '"') || (c == '\\') || (c == ':'))
+            {
+                c = 'x';
+            }
+            s.push_back(c);
+        }
+    }
+    return s + "\"";
+}
+/*****************************************************************************/
+static std::string RandomValue(std::mt19937 &rng, std::uint32_t depth)
+{
+    // The document itself is an array or an object
+    std::uint32_t kind = (depth == 0U) ? (6U + (rng() % 2U)) : (rng() % ((depth < 4U) ? 8U : 6U));
+    std::string s;
+
+    switch (kind)
+    {
+        case 0U:
+        case 1U:
+            s = RandomNumber(rng);
+            break;
+        case 2U:
+        case 3U:
+            s = RandomString(rng, false);
+            break;
+        case 4U:
+        {
+            static const char *cWords[] = { "true", "false", "null" };
+            s = cWords[rng() % 3U];
+            break;
+        }
+        case 5U:
+            s = "[]";
+            break;
+        case 6U:
+        {
+            std::uint32_t n = rng() % 6U;
+            s = "[";
+            for (std::uint32_t i = 0U; i < n; i++)
+            {
+                s += ((i > 0U) ? "," : "") + Spaces(rng) + RandomValue(rng, depth + 1U) + Spaces(rng);
+            }
+            s += "]";
+            break;
+        }
+        default:
+        {
+            std::uint32_t n = rng() % 6U;
+            s = "{";
+            for (std::uint32_t i = 0U; i < n; i++)
+            {
+                s += ((i > 0U) ? "," : "") + Spaces(rng) + RandomString(rng, true) + Spaces(rng) + ":" +
+                     Spaces(rng) + RandomValue(rng, depth + 1U) + Spaces(rng);
+            }
+            s += "}";
+            break;
+        }
+    }
+    return s;
+}
+/*****************************************************************************/
+static std::string Mutate(std::mt19937 &rng, std::string doc)
+{
+    static const char cChars[] = "{}[]:,\"\\-+.0123456789eEtfnulrsa \t\n";
+    std::uint32_t count = 1U + (rng() % 3U);
+
+    for (std::uint32_t i = 0U; (i < count) && !doc.empty(); i++)
+    {
+        std::size_t pos = rng() % doc.size();
+        char c = cChars[rng() % (sizeof(cChars) - 1U)];
+        switch (rng() % 5U)
+        {
+            case 0U:
+                doc.erase(pos, 1U);
+                break;
+            case 1U:
+                doc.insert(doc.begin() + pos, c);
+                break;
+            case 2U:
+                doc[pos] = c;
+                break;
+            case 3U:
+                doc.resize(pos);
+                break;
+            default:
+                doc.insert(pos, doc.substr(rng() % doc.size(), rng() % 8U));
+                break;
+        }
+    }
+    return doc;
+}
+/*****************************************************************************/
+// The old parser never returns on an exponent of ten digits or more
+static bool HasLongExponent(const std::string &doc)
+{
+    for (std::size_t i = 0U; i < doc.size(); i++)
+    {
+        if ((doc[i] == 'e') || (doc[i] == 'E'))
+        {
+            std::size_t j = i + 1U;
+            if ((j < doc.size()) && ((doc[j] == '+') || (doc[j] == '-')))
+            {
+                j++;
+            }
+            std::size_t digits = 0U;
+            while ((j < doc.size()) && std::isdigit(static_cast<unsigned char>(doc[j])))
+            {
+                j++;
+                digits++;
+            }
+            if (digits >= 10U)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+/*****************************************************************************/
+// Same accept/reject result and same values as the old parser
+static void TestDifferential(std::mt19937 &rng, std::uint32_t documents)
+{
+    Differences diff;
+    std::uint32_t accepted = 0U;
+    std::uint32_t compared = 0U;
+
+    for (std::uint32_t i = 0U; i < documents; i++)
+    {
+        std::string doc = Spaces(rng) + RandomValue(rng, 0U) + Spaces(rng);
+        if ((rng() % 2U) == 0U)
+        {
+            doc = Mutate(rng, doc);
+        }
+        if (HasLongExponent(doc))
+        {
+            continue;
+        }
+
+        JsonValue oldValue;
+        JsonValue newValue;
+        bool oldOk = OldJsonReader::ParseString(oldValue, doc);
+        bool newOk = JsonReader::ParseString(newValue, doc);
+        compared++;
+
+        CHECK(oldOk == newOk, "the parsers do not accept the same documents");
+        if (oldOk && newOk)
+        {
+            accepted++;
+            bool same = SameValue(newValue, oldValue, diff);
+            CHECK(same, "the parsers do not build the same value");
+            if (!same)
+            {
+                std::printf("  document: %s\n", doc.c_str());
+            }
+        }
+        else if (oldOk != newOk)
+        {
+            std::printf("  document: %s\n", doc.c_str());
+        }
+    }
+
+    std::printf("%u documents compared, %u accepted; %llu doubles and %llu integers above 2^53 rounded differently\n",
+                compared, accepted, static_cast<unsigned long long>(diff.roundedDoubles),
+                static_cast<unsigned long long>(diff.largeIntegers));
+}
+/*****************************************************************************/
+static JsonValue First(const std::string &doc, bool &ok)
+{
+    JsonValue json;
+    ok = JsonReader::ParseString(json, doc) && json.IsArray() && (json.GetArray().Size() > 0U);
+    return ok ? json.GetArray().GetEntry(0U) : JsonValue();
+}
+/*****************************************************************************/
+// The number conversions that differ from the old parser, on purpose
+static void TestNumbers()
+{
+    bool ok;
+
+    // Doubles are correctly rounded (the old parser gave 0.30000000000000004)
+    static const char *cDoubles[] = { "0.3", "0.1", "2.5e-3", "1.7976931348623157e308", "-123456.789e-12", "4.9e-324" };
+    for (auto d : cDoubles)
+    {
+        JsonValue v = First(std::string("[") + d + "]", ok);
+        CHECK(ok && v.IsDouble() && (v.GetDouble() == std::strtod(d, nullptr)), "double not correctly rounded");
+    }
+
+    // Integers are exact over the whole int64 range
+    JsonValue v = First("[9007199254740993]", ok);
+    CHECK(ok && v.IsInteger() && (v.GetInteger64() == 9007199254740993LL), "integer above 2^53 not exact");
+    v = First("[-9223372036854775808]", ok);
+    CHECK(ok && v.IsInteger() && (v.GetInteger64() == std::numeric_limits<std::int64_t>::min()), "minimum int64 not exact");
+    v = First("[9223372036854775807]", ok);
+    CHECK(ok && v.IsInteger() && (v.GetInteger64() == std::numeric_limits<std::int64_t>::max()), "maximum int64 not exact");
+
+    // Out of the int64 range: the minimum, as the conversion of the old parser on x86
+    v = First("[9223372036854775808]", ok);
+    CHECK(ok && v.IsInteger() && (v.GetInteger64() == std::numeric_limits<std::int64_t>::min()), "integer out of range");
+
+    // Huge exponents end (the old parser looped forever on ten digits)
+    v = First("[1e1234567890]", ok);
+    CHECK(ok && v.IsDouble() && std::isinf(v.GetDouble()) && (v.GetDouble() > 0.0), "huge exponent is not inf");
+    v = First("[-1e400]", ok);
+    CHECK(ok && v.IsDouble() && std::isinf(v.GetDouble()) && (v.GetDouble() < 0.0), "huge negative number is not -inf");
+    v = First("[1e-1234567890]", ok);
+    CHECK(ok && v.IsDouble() && (v.GetDouble() == 0.0), "tiny exponent is not 0");
+
+    // The old grammar is kept
+    v = First("[-.5]", ok);
+    CHECK(ok && v.IsDouble() && (v.GetDouble() == -0.5), "-.5");
+    v = First("[1.]", ok);
+    CHECK(ok && v.IsDouble() && (v.GetDouble() == 1.0), "1.");
+    v = First("[00012]", ok);
+    CHECK(ok && v.IsInteger() && (v.GetInteger64() == 12), "leading zeros");
+    First("[1x]", ok);
+    CHECK(!ok, "number followed by a letter");
+    First("[-x]", ok);
+    CHECK(!ok, "lone minus sign");
+}
+/*****************************************************************************/
+template<typename F>
+static double NsPerOp(std::uint32_t durationMs, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t ops = 0U;
+    double elapsed = 0.0;
+
+    do
+    {
+        f();
+        ops++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    while (elapsed < (durationMs / 1000.0));
+
+    return (elapsed * 1e9) / ops;
+}
+/*****************************************************************************/
+static std::string PlayerList(std::uint32_t players)
+{
+    std::string list = "{\"cmd\":\"PlayerList\",\"page\":0,\"total\":" + std::to_string(players) + ",\"players\":[";
+    for (std::uint32_t i = 0U; i < players; i++)
+    {
+        list += ((i > 0U) ? "," : "");
+        list += "{\"uuid\":" + std::to_string(10U + i) + ",\"table\":" + std::to_string(i % 7U) +
+                ",\"place\":\"South\",\"nickname\":\"Player" + std::to_string(i) +
+                "\",\"avatar\":\"http://www.tarotclub.fr/avatars/a12.png\",\"gender\":\"Male\"}";
+    }
+    return list + "]}";
+}
+/*****************************************************************************/
+static std::string DealFile(std::uint32_t deals)
+{
+    std::string file = "[";
+    for (std::uint32_t i = 0U; i < deals; i++)
+    {
+        DealGenerator deal;
+        deal.CreateRandomDeal(4U, 1000U + i);
+        file += ((i > 0U) ? ",\n" : "") + deal.ToString();
+    }
+    return file + "]";
+}
+/*****************************************************************************/
+static void Benchmark(std::uint32_t durationMs)
+{
+    struct Sample
+    {
+        const char *name;
+        std::string doc;
+    };
+
+    std::vector<Sample> samples = {
+        { "ReplyBid", "{\"cmd\":\"ReplyBid\",\"contract\":\"Guard\",\"slam\":false}" },
+        { "Login reply", "{\"cmd\":\"ReplyLogin\",\"nickname\":\"Belegar\",\"avatar\":\"http://www.tarotclub.fr/avatars/a12.png\","
+                         "\"gender\":\"Male\",\"username\":\"belegar\",\"uuid\":12}" },
+        { "NewDeal", "{\"cmd\":\"NewDeal\",\"deck\":\"01-T;05-T;13-T;21-T;00-T;14-S;12-S;03-S;09-H;10-H;11-H;"
+                     "02-D;07-D;13-D;14-C;06-C;04-C;08-C\"}" },
+        { "PlayerList x500", PlayerList(500U) },
+        { "Deal file x2000", DealFile(2000U) }
+    };
+
+    std::printf("  %-18s %10s  %12s  %12s\n", "document", "size", "old ns/op", "new ns/op");
+    for (const auto &s : samples)
+    {
+        double oldNs = NsPerOp(durationMs, [&]() { JsonValue json; OldJsonReader::ParseString(json, s.doc); });
+        double newNs = NsPerOp(durationMs, [&]() { JsonValue json; JsonReader::ParseString(json, s.doc); });
+        std::printf("  %-18s %10zu  %12.0f  %12.0f  (x%.1f)\n", s.name, s.doc.size(), oldNs, newNs, oldNs / newNs);
+    }
+}
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+    std::uint32_t documents = (argc > 1) ? static_cast<std::uint32_t>(std::atoi(argv[1])) : 20000U;
+    std::uint32_t durationMs = (argc > 2) ? static_cast<std::uint32_t>(std::atoi(argv[2])) : 500U;
+    std::uint32_t seed = (argc > 3) ? static_cast<std::uint32_t>(std::atoi(argv[3])) : 1234U;
+    std::mt19937 rng(seed);
+
+    TestDifferential(rng, documents);
+    TestNumbers();
+    if (durationMs > 0U)
+    {
+        Benchmark(durationMs);
+    }
+
+    std::printf("JsonReaderBench: %d failure(s)\n", gFailures);
+    return (gFailures == 0) ? 0 : 1;
+}
+
+//=============================================================================
+// End of file JsonReaderBench.cpp
+//=============================================================================
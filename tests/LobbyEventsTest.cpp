@@ -0,0 +1,152 @@
+/*=============================================================================
+ * TarotClub - LobbyEventsTest.cpp
+ *=============================================================================
+ * Merged lobby events, from the event bus of the server to the client list
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "LobbyEvents.h"
+#include "PlayerContext.h"
+
+/**
+ * Build and run it with the core library:
+ *   LobbyEventsTest
+ * Returns 0 if all the checks pass.
+ */
+
+static int gFailures = 0;
+
+#define CHECK(cond, msg) do { if (!(cond)) { gFailures++; std::printf("FAILED: %s (%s:%d)\n", msg, __FILE__, __LINE__); } } while (0)
+
+static const std::uint32_t cPlayer = Protocol::USERS_UID + 3U;
+static const std::uint32_t cWatcher = Protocol::USERS_UID + 4U; ///< In the lobby, receives the events
+static const std::uint32_t cTable = Protocol::TABLES_UID;
+
+/*****************************************************************************/
+// Same message as Lobby::SendPlayerEvent(): the current status of the player
+static JsonObject Event(const std::string &type, const std::string &nickname, std::uint32_t tableId, Place place)
+{
+    static std::uint32_t counter = 0U;
+    JsonObject player;
+    Identity ident;
+
+    ident.username = nickname;
+    player.AddValue("uuid", cPlayer);
+    player.AddValue("table", tableId);
+    player.AddValue("place", place.ToString());
+    ToJson(ident, player);
+
+    JsonObject obj;
+    obj.AddValue("cmd", "LobbyEvent");
+    obj.AddValue("type", type);
+    obj.AddValue("counter", ++counter);
+    obj.AddValue("player", player);
+    return obj;
+}
+/*****************************************************************************/
+// Flushes the bus and gives the messages of the watcher to its client
+static std::uint32_t Deliver(LobbyEventBus &bus, const Users &users, PlayerContext &client)
+{
+    std::vector<Reply> out;
+    std::uint32_t messages = 0U;
+
+    bus.Flush(users, std::vector<std::uint32_t>(), out);
+    for (const auto &reply : out)
+    {
+        JsonValue json(reply.data);
+        std::string cmd = json.FindValue("cmd").GetString();
+
+        messages++;
+        if (cmd == "LobbyEvent")
+        {
+            client.DecodeLobbyEvent(json);
+        }
+        else if (cmd == "LobbyEvents")
+        {
+            client.DecodeLobbyEvents(json);
+        }
+    }
+    return messages;
+}
+/*****************************************************************************/
+static bool GetPlayer(PlayerContext &client, Users::Entry &entry)
+{
+    return client.mUsers.GetEntry(cPlayer, entry);
+}
+/*****************************************************************************/
+int main()
+{
+    Users users;
+    Users::Entry watcher;
+    watcher.player.uuid = cWatcher;
+    watcher.player.tableId = Protocol::LOBBY_UID;
+    watcher.identity.username = "Watcher";
+    users.AddEntry(watcher);
+
+    LobbyEventBus bus;
+    PlayerContext client;
+    Users::Entry entry;
+
+    // The client learns the player
+    bus.Post(Event("New", "Alice", Protocol::LOBBY_UID, Place()), Protocol::LOBBY_UID, users.Size());
+    CHECK(Deliver(bus, users, client) == 1U, "New sent");
+    CHECK(GetPlayer(client, entry) && (entry.identity.username == "Alice"), "New applied");
+
+    // JoinTable then Nick in the same window: only "Nick" is sent, the location must follow
+    bus.Post(Event("JoinTable", "Alice", cTable, Place(Place::SOUTH)), cTable, users.Size());
+    bus.Post(Event("Nick", "Bob", cTable, Place(Place::SOUTH)), cTable, users.Size());
+    CHECK(Deliver(bus, users, client) == 1U, "JoinTable + Nick merged");
+    CHECK(GetPlayer(client, entry), "player known");
+    CHECK(entry.identity.username == "Bob", "JoinTable + Nick: nickname");
+    CHECK(entry.player.tableId == cTable, "JoinTable + Nick: table");
+    CHECK(entry.player.place == Place(Place::SOUTH), "JoinTable + Nick: place");
+
+    // Nick then LeaveTable: only "LeaveTable" is sent, the nickname must follow
+    bus.Post(Event("Nick", "Carol", cTable, Place(Place::SOUTH)), cTable, users.Size());
+    bus.Post(Event("LeaveTable", "Carol", Protocol::LOBBY_UID, Place()), cTable, users.Size());
+    CHECK(Deliver(bus, users, client) == 1U, "Nick + LeaveTable merged");
+    CHECK(GetPlayer(client, entry), "player known");
+    CHECK(entry.identity.username == "Carol", "Nick + LeaveTable: nickname");
+    CHECK(entry.player.tableId == Protocol::LOBBY_UID, "Nick + LeaveTable: table");
+
+    // Nick then JoinTable
+    bus.Post(Event("Nick", "Dave", Protocol::LOBBY_UID, Place()), Protocol::LOBBY_UID, users.Size());
+    bus.Post(Event("JoinTable", "Dave", cTable, Place(Place::EAST)), cTable, users.Size());
+    CHECK(Deliver(bus, users, client) == 1U, "Nick + JoinTable merged");
+    CHECK(GetPlayer(client, entry), "player known");
+    CHECK(entry.identity.username == "Dave", "Nick + JoinTable: nickname");
+    CHECK((entry.player.tableId == cTable) && (entry.player.place == Place(Place::EAST)), "Nick + JoinTable: location");
+
+    // Quit removes the player
+    bus.Post(Event("Quit", "Dave", Protocol::LOBBY_UID, Place()), Protocol::LOBBY_UID, users.Size());
+    CHECK(Deliver(bus, users, client) == 1U, "Quit sent");
+    CHECK(!GetPlayer(client, entry), "Quit applied");
+
+    std::printf("LobbyEventsTest: %d failure(s)\n", gFailures);
+    return (gFailures == 0) ? 0 : 1;
+}
+
+//=============================================================================
+// End of file LobbyEventsTest.cpp
+//=============================================================================
@@ -0,0 +1,395 @@
+/*=============================================================================
+ * TarotClub - ShardCapacityBench.cpp
+ *=============================================================================
+ * Tables sustained by the server versus the number of lobby shards
+ *=============================================================================
+ * TarotClub ( http://www.tarotclub.fr ) - This file is part of TarotClub
+ * Copyright (C) 2003-2999 - Anthony Rabine
+ * anthony@tarotclub.fr
+ *
+ * TarotClub is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TarotClub is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TarotClub.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *=============================================================================
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Server.h"
+#include "ServerConfig.h"
+#include "ShardHost.h"
+#include "LoadGenerator.h"
+
+/**
+ * Build it with the core library, with the optimization flags of the server:
+ *   ShardCapacityBench [max shards] [table step] [seconds] [think ms]
+ *
+ * For 0 (single lobby, in the front-end process), 1, 2, 4 ... max shards, the
+ * number of tables is raised by 'table step' until the server does not sustain
+ * it. Each step is a new process: it starts a front-end, forks the shard
+ * processes (this program, run again with "shard" as first argument), creates
+ * the tables in the shards and fills them with a LoadGenerator
+ * (Options::tables), four bots per table.
+ *
+ * The bots wait 'think ms' before each answer, so on an idle server a table
+ * sends a known number of requests per second; it is measured with one table
+ * for each shard count. The request rate is used rather than the deals, that
+ * last several seconds each. A number of tables is sustained when all the
+ * clients are seated without error and each table still sends at least 80% of
+ * that rate during 'seconds'.
+ *
+ * The result is the maximum number of tables sustained per shard count. The
+ * shards only add capacity when each one gets its own core.
+ */
+
+static const double cMinRatio = 0.8;            ///< Request rate per table, relative to the idle server
+static const std::uint32_t cConnectRate = 400U; ///< New connections per second
+static const std::uint32_t cSeatTimeout = 60U;  ///< Seconds to seat all the clients
+static const std::uint16_t cPort = 4369U;
+
+/*****************************************************************************/
+static ServerOptions Options(std::uint32_t shards, std::uint32_t maxTables)
+{
+    ServerOptions options = ServerConfig::GetDefault();
+    options.game_tcp_port = cPort;
+    options.websocket_tcp_port = 0U;
+    options.lobby_max_conn = static_cast<std::int32_t>(4U * maxTables + 100U);
+    options.lobby_max_tables = maxTables + 8U * std::max(shards, 1U);
+    options.shards = shards;
+    options.shard_socket = "/tmp/tarotclub-capacity-" + std::to_string(getpid());
+    return options;
+}
+/*****************************************************************************/
+/**
+ * Shard process: creates its tables, writes their IDs on the pipe then serves
+ * the front-end until it is killed.
+ *   ShardCapacityBench shard <index> <shards> <max tables> <tables> <socket> <fd>
+ */
+static int RunShard(char **argv)
+{
+    std::uint32_t index = static_cast<std::uint32_t>(std::atoi(argv[2]));
+    std::uint32_t shards = static_cast<std::uint32_t>(std::atoi(argv[3]));
+    std::uint32_t maxTables = static_cast<std::uint32_t>(std::atoi(argv[4]));
+    std::uint32_t tables = static_cast<std::uint32_t>(std::atoi(argv[5]));
+    int fd = std::atoi(argv[7]);
+
+    ServerOptions options = Options(shards, maxTables);
+    options.shard_socket = argv[6];
+
+    boost::asio::io_context ioc;
+    ShardHost host(ioc, options, index);
+    std::string ids;
+    for (std::uint32_t t = 0U; t < tables; t++)
+    {
+        std::uint32_t id = host.GetLobby()->CreateTable("Capacity " + std::to_string(t + 1U));
+        if (id != Protocol::INVALID_UID)
+        {
+            ids += std::to_string(id) + " ";
+        }
+    }
+
+    bool started = host.Start();
+    ids += "\n";
+    if (write(fd, ids.data(), ids.size()) < 0)
+    {
+        started = false;
+    }
+    close(fd);
+
+    if (started)
+    {
+        ioc.run();
+    }
+    return started ? 0 : 1;
+}
+
+/*****************************************************************************/
+struct Step
+{
+    bool sustained;
+    std::uint32_t seated;
+    double requestRate;         ///< Per table and per second
+    double dealRate;            ///< All the tables, per second
+    std::uint64_t errors;
+    std::uint64_t moves;
+};
+/*****************************************************************************/
+// Forks the shard processes; the IDs of their tables are read from their pipe
+static bool StartShards(const char *self, std::uint32_t shards, std::uint32_t maxTables, std::uint32_t tables,
+                        const std::string &socket, std::vector<pid_t> &pids, std::vector<std::uint32_t> &tableIds)
+{
+    bool ok = true;
+
+    for (std::uint32_t i = 0U; i < shards; i++)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+        {
+            return false;
+        }
+
+        // Same number of tables in each shard
+        std::uint32_t count = (tables / shards) + ((i < (tables % shards)) ? 1U : 0U);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // Not left behind if the step ends abnormally
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            close(fds[0]);
+            std::vector<std::string> args = { self, "shard", std::to_string(i), std::to_string(shards), std::to_string(maxTables),
+                                              std::to_string(count), socket, std::to_string(fds[1]) };
+            std::vector<char *> argv;
+            for (auto &a : args)
+            {
+                argv.push_back(&a[0]);
+            }
+            argv.push_back(nullptr);
+            execv(self, argv.data());
+            _exit(127);
+        }
+        close(fds[1]);
+        if (pid < 0)
+        {
+            close(fds[0]);
+            return false;
+        }
+        pids.push_back(pid);
+
+        std::string line;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        {
+            line.append(buf, static_cast<std::size_t>(n));
+        }
+        close(fds[0]);
+
+        std::stringstream ss(line);
+        std::uint32_t id;
+        std::uint32_t created = 0U;
+        while (ss >> id)
+        {
+            tableIds.push_back(id);
+            created++;
+        }
+        ok = ok && (created == count);
+    }
+    return ok;
+}
+/*****************************************************************************/
+static void StopShards(const ServerOptions &options, std::vector<pid_t> &pids)
+{
+    for (auto pid : pids)
+    {
+        kill(pid, SIGTERM);
+    }
+    for (std::uint32_t i = 0U; i < pids.size(); i++)
+    {
+        waitpid(pids[i], nullptr, 0);
+        std::remove(ShardHost::SocketPath(options, i).c_str());
+    }
+    pids.clear();
+}
+/*****************************************************************************/
+static bool WaitShards(Server &server, std::uint32_t shards)
+{
+    for (std::uint32_t i = 0U; i < 100U; i++)
+    {
+        ShardRouter::Stats stats;
+        std::uint32_t connected = 0U;
+        if (server.GetRouterStats(stats))
+        {
+            for (const auto &l : stats.links)
+            {
+                connected += l.connected ? 1U : 0U;
+            }
+        }
+        if (connected == shards)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+/*****************************************************************************/
+static Step RunStep(const char *self, std::uint32_t shards, std::uint32_t tables, std::uint32_t maxTables,
+                    std::uint32_t seconds, std::uint32_t thinkTime)
+{
+    Step step = {};
+    ServerOptions options = Options(shards, maxTables);
+    std::vector<pid_t> pids;
+    std::vector<std::uint32_t> tableIds;
+
+    if ((shards > 0U) && !StartShards(self, shards, maxTables, tables, options.shard_socket, pids, tableIds))
+    {
+        std::printf("Cannot start the shards\n");
+        StopShards(options, pids);
+        return step;
+    }
+
+    boost::asio::io_context ioc;
+    auto work = boost::asio::make_work_guard(ioc);
+    std::thread ioThread([&ioc]() { ioc.run(); });
+    {
+        auto server = std::make_shared<Server>(ioc, options);
+        auto swarm = std::make_shared<LoadGenerator>();
+        server->AddService(swarm);
+
+        LoadGenerator::Options load;
+        load.port = cPort;
+        load.clients = 4U * tables;
+        load.threads = 2U;
+        load.connectRate = cConnectRate;
+        load.thinkTime = thinkTime;
+        load.tables = tableIds;
+
+        if (((shards == 0U) || WaitShards(*server, shards)) && swarm->Start(load))
+        {
+            // Seating of all the clients
+            LoadGenerator::Report start = swarm->GetReport();
+            while ((start.joined < load.clients) && (start.elapsed < cSeatTimeout))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                start = swarm->GetReport();
+            }
+
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            LoadGenerator::Report end = swarm->GetReport();
+
+            step.seated = start.joined;
+            double elapsed = end.elapsed - start.elapsed;
+            step.requestRate = (end.framesSent - start.framesSent) / (elapsed * tables);
+            step.dealRate = (end.deals - start.deals) / elapsed;
+            step.errors = end.connectErrors + end.disconnections + end.protocolErrors;
+
+            ShardRouter::Stats stats;
+            if (server->GetRouterStats(stats))
+            {
+                step.moves = stats.moves;
+            }
+            swarm->Stop();
+        }
+    }
+    work.reset();
+    ioc.stop();
+    ioThread.join();
+    StopShards(options, pids);
+    return step;
+}
+/*****************************************************************************/
+// The Server and its services keep each other alive: each step has its own process
+static Step Run(const char *self, std::uint32_t shards, std::uint32_t tables, std::uint32_t maxTables,
+                std::uint32_t seconds, std::uint32_t thinkTime)
+{
+    Step step = {};
+    int fds[2];
+
+    std::fflush(stdout);
+    if (pipe(fds) != 0)
+    {
+        return step;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        step = RunStep(self, shards, tables, maxTables, seconds, thinkTime);
+        ssize_t written = write(fds[1], &step, sizeof(step));
+        std::fflush(stdout);
+        _exit((written == sizeof(step)) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if ((pid > 0) && (read(fds[0], &step, sizeof(step)) != sizeof(step)))
+    {
+        step = Step();
+    }
+    close(fds[0]);
+    if (pid > 0)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+    return step;
+}
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+    if ((argc > 7) && (std::string(argv[1]) == "shard"))
+    {
+        return RunShard(argv);
+    }
+
+    std::uint32_t maxShards = (argc > 1) ? static_cast<std::uint32_t>(std::atoi(argv[1])) : 4U;
+    std::uint32_t tableStep = (argc > 2) ? static_cast<std::uint32_t>(std::atoi(argv[2])) : 10U;
+    std::uint32_t seconds = (argc > 3) ? static_cast<std::uint32_t>(std::atoi(argv[3])) : 10U;
+    std::uint32_t thinkTime = (argc > 4) ? static_cast<std::uint32_t>(std::atoi(argv[4])) : 20U;
+    const std::uint32_t maxTables = 4000U;
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::printf("%u core(s), +%u tables per step, %u s per step, think time %u ms\n",
+                std::thread::hardware_concurrency(), tableStep, seconds, thinkTime);
+
+    std::vector<std::uint32_t> shardCounts = { 0U };
+    for (std::uint32_t s = 1U; s <= maxShards; s *= 2U)
+    {
+        shardCounts.push_back(s);
+    }
+
+    std::vector<std::uint32_t> capacity;
+    for (auto shards : shardCounts)
+    {
+        // Request rate of an idle server, one table
+        Step idle = Run(argv[0], shards, 1U, maxTables, seconds, thinkTime);
+        std::printf("%u shard(s): idle rate %.1f requests/s per table\n", shards, idle.requestRate);
+        std::fflush(stdout);
+
+        std::uint32_t sustained = 0U;
+        for (std::uint32_t tables = tableStep; (idle.requestRate > 0.0) && (tables <= maxTables); tables += tableStep)
+        {
+            Step step = Run(argv[0], shards, tables, maxTables, seconds, thinkTime);
+            step.sustained = (step.seated == 4U * tables) && (step.errors == 0U) && (step.requestRate >= cMinRatio * idle.requestRate);
+            std::printf("  %5u tables: seated %5u, %.1f requests/s per table (%3.0f%%), %.1f deals/s, %llu errors, %llu moves%s\n",
+                        tables, step.seated, step.requestRate, 100.0 * step.requestRate / idle.requestRate, step.dealRate,
+                        static_cast<unsigned long long>(step.errors), static_cast<unsigned long long>(step.moves),
+                        step.sustained ? "" : "  <- not sustained");
+            std::fflush(stdout);
+            if (!step.sustained)
+            {
+                break;
+            }
+            sustained = tables;
+        }
+        capacity.push_back(sustained);
+    }
+
+    std::printf("\n  shards    max tables sustained\n");
+    for (std::size_t i = 0U; i < shardCounts.size(); i++)
+    {
+        std::printf("  %6s    %u\n", (shardCounts[i] == 0U) ? "single" : std::to_string(shardCounts[i]).c_str(), capacity[i]);
+    }
+    return 0;
+}
+
+//=============================================================================
+// End of file ShardCapacityBench.cpp
+//=============================================================================
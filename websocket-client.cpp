@@ -19,44 +19,63 @@
 #include <sstream>
 #include "openssl/ssl3.h"
 
-WebSocketClient::session::session(boost::asio::io_context &ioc, boost::asio::ssl::context &ctx, IReadHandler &handler)
-    : mReadHandler(handler)
-    , resolver_(boost::asio::make_strand(ioc))
-    , ws_(boost::asio::make_strand(ioc), ctx)
+template <class Stream>
+static Stream MakeStream(boost::asio::io_context &ioc, boost::asio::ssl::context &ctx)
+{
+    if constexpr (std::is_same<Stream, boost::beast::websocket::stream<boost::beast::tcp_stream>>::value)
+    {
+        (void) ctx;
+        return Stream(boost::asio::make_strand(ioc));
+    }
+    else
+    {
+        return Stream(boost::asio::make_strand(ioc), ctx);
+    }
+}
+
+template <class Stream>
+WebSocketClient::session<Stream>::session(boost::asio::io_context &ioc, boost::asio::ssl::context &ctx, IReadHandler &handler)
+    : resolver_(boost::asio::make_strand(ioc))
+    , ws_(MakeStream<Stream>(ioc, ctx))
+    , mReadHandler(handler)
 {
 }
 
-void WebSocketClient::session::Run(const std::string &host, const std::string &port)
+template <class Stream>
+void WebSocketClient::session<Stream>::Run(const std::string &host, const std::string &port)
 {
     // Save these for later
     host_ = host;
     port_ = port;
 
     // Look up the domain name
-    resolver_.async_resolve(host, port, boost::beast::bind_front_handler(&session::on_resolve, shared_from_this()));
+    resolver_.async_resolve(host, port, boost::beast::bind_front_handler(&session::on_resolve, this->shared_from_this()));
 }
 
-void WebSocketClient::session::Close()
+template <class Stream>
+void WebSocketClient::session<Stream>::Close()
 {
     // Close the WebSocket connection
     ws_.async_close(boost::beast::websocket::close_code::normal,
                     boost::beast::bind_front_handler(
                         &session::on_close,
-                        shared_from_this()));
+                        this->shared_from_this()));
     mConnected = true;
 }
 
-void WebSocketClient::session::Send(const std::string &message)
+template <class Stream>
+void WebSocketClient::session<Stream>::Send(const std::string &message)
 {
     // Send the message
     ws_.async_write(
                 boost::asio::buffer(message),
                 boost::beast::bind_front_handler(
                     &session::on_write,
-                    shared_from_this()));
+                    this->shared_from_this()));
 }
 
-void WebSocketClient::session::on_resolve(boost::beast::error_code ec, boost::asio::ip::tcp::resolver::results_type results)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_resolve(boost::beast::error_code ec, boost::asio::ip::tcp::resolver::results_type results)
 {
     if(ec)
     {
@@ -71,10 +90,11 @@ void WebSocketClient::session::on_resolve(boost::beast::error_code ec, boost::as
                 results,
                 boost::beast::bind_front_handler(
                     &session::on_connect,
-                    shared_from_this()));
+                    this->shared_from_this()));
 }
 
-void WebSocketClient::session::on_connect(boost::beast::error_code ec, boost::asio::ip::tcp::resolver::results_type::endpoint_type ep)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_connect(boost::beast::error_code ec, boost::asio::ip::tcp::resolver::results_type::endpoint_type ep)
 {
     if(ec)
     {
@@ -84,26 +104,36 @@ void WebSocketClient::session::on_connect(boost::beast::error_code ec, boost::as
     // Set a timeout on the operation
     boost::beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(5));
 
-    // Set SNI Hostname (many hosts need this to handshake successfully)
-    if(! SSL_set_tlsext_host_name(
-                ws_.next_layer().native_handle(),
-                host_.c_str()))
-    {
-        ec = boost::beast::error_code(static_cast<int>(::ERR_get_error()),
-                                      boost::asio::error::get_ssl_category());
-        return on_failure(ec, STATE_CONNECT);
-    }
-
     // Update the host_ string. This will provide the value of the
     // Host HTTP header during the WebSocket handshake.
     // See https://tools.ietf.org/html/rfc7230#section-5.4
+    std::string host = host_;
     host_ += ':' + std::to_string(ep.port());
 
-    // Perform the SSL handshake
-    ws_.next_layer().async_handshake(boost::asio::ssl::stream_base::client, boost::beast::bind_front_handler(&session::on_ssl_handshake, shared_from_this()));
+    if constexpr (std::is_same<Stream, PlainStream>::value)
+    {
+        // No TLS layer, go on with the WebSocket handshake
+        on_ssl_handshake(ec);
+    }
+    else
+    {
+        // Set SNI Hostname (many hosts need this to handshake successfully)
+        if(! SSL_set_tlsext_host_name(
+                    ws_.next_layer().native_handle(),
+                    host.c_str()))
+        {
+            ec = boost::beast::error_code(static_cast<int>(::ERR_get_error()),
+                                          boost::asio::error::get_ssl_category());
+            return on_failure(ec, STATE_CONNECT);
+        }
+
+        // Perform the SSL handshake
+        ws_.next_layer().async_handshake(boost::asio::ssl::stream_base::client, boost::beast::bind_front_handler(&session::on_ssl_handshake, this->shared_from_this()));
+    }
 }
 
-void WebSocketClient::session::on_ssl_handshake(boost::beast::error_code ec)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_ssl_handshake(boost::beast::error_code ec)
 {
     if(ec)
     {
@@ -128,11 +158,17 @@ void WebSocketClient::session::on_ssl_handshake(boost::beast::error_code ec)
                        " websocket-client-async-ssl");
                    }));
 
+    // Propose the compression of the messages, the server may refuse
+    boost::beast::websocket::permessage_deflate pmd;
+    pmd.client_enable = true;
+    ws_.set_option(pmd);
+
     // Perform the websocket handshake
-    ws_.async_handshake(host_, "/", boost::beast::bind_front_handler(&session::on_handshake, shared_from_this()));
+    ws_.async_handshake(host_, "/", boost::beast::bind_front_handler(&session::on_handshake, this->shared_from_this()));
 }
 
-void WebSocketClient::session::on_handshake(boost::beast::error_code ec)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_handshake(boost::beast::error_code ec)
 {
     if(ec)
     {
@@ -142,10 +178,11 @@ void WebSocketClient::session::on_handshake(boost::beast::error_code ec)
     still_connected();
 
     // Read a message into our buffer
-    ws_.async_read(buffer_, boost::beast::bind_front_handler(&session::on_read, shared_from_this()));
+    ws_.async_read(buffer_, boost::beast::bind_front_handler(&session::on_read, this->shared_from_this()));
 }
 
-void WebSocketClient::session::on_write(boost::beast::error_code ec, std::size_t bytes_transferred)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_write(boost::beast::error_code ec, std::size_t bytes_transferred)
 {
     boost::ignore_unused(bytes_transferred);
 
@@ -156,7 +193,8 @@ void WebSocketClient::session::on_write(boost::beast::error_code ec, std::size_t
     still_connected();
 }
 
-void WebSocketClient::session::on_read(boost::beast::error_code ec, std::size_t bytes_transferred)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_read(boost::beast::error_code ec, std::size_t bytes_transferred)
 {
     if(ec)
     {
@@ -175,10 +213,11 @@ void WebSocketClient::session::on_read(boost::beast::error_code ec, std::size_t
     mReadHandler.OnWsData(ss.str());
     buffer_.clear();
 
-    ws_.async_read(buffer_, boost::beast::bind_front_handler(&session::on_read, shared_from_this()));
+    ws_.async_read(buffer_, boost::beast::bind_front_handler(&session::on_read, this->shared_from_this()));
 }
 
-void WebSocketClient::session::on_close(boost::beast::error_code ec)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_close(boost::beast::error_code ec)
 {
     if(ec)
     {
@@ -186,21 +225,24 @@ void WebSocketClient::session::on_close(boost::beast::error_code ec)
     }
 }
 
-void WebSocketClient::session::on_failure(boost::beast::error_code ec, State error)
+template <class Stream>
+void WebSocketClient::session<Stream>::on_failure(boost::beast::error_code ec, State error)
 {
     std::cout << "[WS] FAILURE" << std::endl;
     mConnected = false;
     mState = error;
 }
 
-void WebSocketClient::session::still_connected()
+template <class Stream>
+void WebSocketClient::session<Stream>::still_connected()
 {
     mState = STATE_NO_ERROR;
     mConnected = true;
 }
 
-WebSocketClient::WebSocketClient(IReadHandler &handler)
+WebSocketClient::WebSocketClient(IReadHandler &handler, bool useTls)
     : mReadHandler(handler)
+    , mUseTls(useTls)
 {
 
 }
@@ -220,7 +262,14 @@ std::string WebSocketClient::Run(const std::string &host, const std::string &por
         // Launch the asynchronous operation
         // The session is constructed with a strand to
         // ensure that handlers do not execute concurrently.
-        mSession = std::make_shared<session>(ioc, ctx, mReadHandler);
+        if (mUseTls)
+        {
+            mSession = std::make_shared<session<TlsStream>>(ioc, ctx, mReadHandler);
+        }
+        else
+        {
+            mSession = std::make_shared<session<PlainStream>>(ioc, ctx, mReadHandler);
+        }
 
         mSession->Run(host, port);
 
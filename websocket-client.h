@@ -43,7 +43,8 @@ public:
         STATE_UNKNOWN,
     };
 
-    WebSocketClient(IReadHandler &handler);
+    // Without TLS (ws://), for local connections only
+    WebSocketClient(IReadHandler &handler, bool useTls = true);
 
     std::string Run(const std::string &host, const std::string &port);
     void Send(const std::string &message);
@@ -52,15 +53,31 @@ public:
     State GetState();
 private:
     IReadHandler &mReadHandler;
+    bool mUseTls;
 
     // The io_context is required for all I/O
     boost::asio::io_context ioc;
 
+    typedef boost::beast::websocket::stream<boost::beast::ssl_stream<boost::beast::tcp_stream>> TlsStream;
+    typedef boost::beast::websocket::stream<boost::beast::tcp_stream> PlainStream;
+
+    class ISession
+    {
+    public:
+        virtual ~ISession() {}
+        virtual void Run(const std::string &host, const std::string &port) = 0;
+        virtual void Close() = 0;
+        virtual void Send(const std::string &message) = 0;
+        virtual bool IsConnected() const = 0;
+        virtual State GetState() = 0;
+    };
+
     // Sends a WebSocket message and prints the response
-    class session : public std::enable_shared_from_this<session>
+    template <class Stream>
+    class session : public ISession, public std::enable_shared_from_this<session<Stream>>
     {
         boost::asio::ip::tcp::resolver resolver_;
-        boost::beast::websocket::stream<boost::beast::ssl_stream<boost::beast::tcp_stream>> ws_;
+        Stream ws_;
         boost::beast::flat_buffer buffer_;
         std::string host_;
         std::string port_;
@@ -69,11 +86,11 @@ private:
         // Resolver and socket require an io_context
         explicit session(boost::asio::io_context& ioc, boost::asio::ssl::context& ctx, IReadHandler &handler);
         // Start the asynchronous operation
-        void Run(const std::string &host, const std::string &port);
-        void Close();
-        void Send(const std::string &message);
-        bool IsConnected() const { return mConnected; }
-        State GetState() { return mState; }
+        void Run(const std::string &host, const std::string &port) override;
+        void Close() override;
+        void Send(const std::string &message) override;
+        bool IsConnected() const override { return mConnected; }
+        State GetState() override { return mState; }
 
     private:
         IReadHandler &mReadHandler;
@@ -92,7 +109,7 @@ private:
 
     };
 
-    std::shared_ptr<session> mSession;
+    std::shared_ptr<ISession> mSession;
 
 };
 